@@ -0,0 +1,232 @@
+#include "spotflow_log_template.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Length modifiers of printf conversion specifications */
+enum template_value_length {
+	TEMPLATE_VALUE_LENGTH_NONE,
+	TEMPLATE_VALUE_LENGTH_HH,
+	TEMPLATE_VALUE_LENGTH_H,
+	TEMPLATE_VALUE_LENGTH_L,
+	TEMPLATE_VALUE_LENGTH_LL,
+	TEMPLATE_VALUE_LENGTH_J,
+	TEMPLATE_VALUE_LENGTH_Z,
+	TEMPLATE_VALUE_LENGTH_T,
+	TEMPLATE_VALUE_LENGTH_UPPER_L,
+};
+
+static const char* skip_conversion_options(const char* spec, va_list* args);
+static const char* parse_length_modifier(const char* spec, enum template_value_length* length);
+static int64_t get_signed_value(enum template_value_length length, va_list* args);
+static uint64_t get_unsigned_value(enum template_value_length length, va_list* args);
+static int read_template_value(struct spotflow_template_value* value, char conversion,
+			       enum template_value_length length, va_list* args);
+
+int spotflow_log_template_walk_values(const char* log_template, va_list args,
+				      spotflow_template_value_cb cb, void* ctx)
+{
+	int rc = 0;
+	va_list values;
+	va_copy(values, args);
+
+	const char* spec = log_template;
+	while (*spec != '\0') {
+		if (*spec++ != '%') {
+			continue;
+		}
+		if (*spec == '%') {
+			spec++;
+			continue;
+		}
+
+		enum template_value_length length;
+		spec = skip_conversion_options(spec, &values);
+		spec = parse_length_modifier(spec, &length);
+		if (*spec == '\0') {
+			break;
+		}
+
+		struct spotflow_template_value value;
+		rc = read_template_value(&value, *spec++, length, &values);
+		if (rc < 0) {
+			break;
+		}
+		if (rc > 0) {
+			/* argument consumed without a value */
+			rc = 0;
+			continue;
+		}
+
+		rc = cb(&value, ctx);
+		if (rc < 0) {
+			break;
+		}
+	}
+
+	va_end(values);
+	return rc;
+}
+
+/* Skips flags, field width and precision, star arguments are consumed */
+static const char* skip_conversion_options(const char* spec, va_list* args)
+{
+	while (*spec != '\0' && strchr("-+ #0'", *spec) != NULL) {
+		spec++;
+	}
+
+	if (*spec == '*') {
+		(void)va_arg(*args, int);
+		spec++;
+	}
+	while (*spec >= '0' && *spec <= '9') {
+		spec++;
+	}
+
+	if (*spec == '.') {
+		spec++;
+		if (*spec == '*') {
+			(void)va_arg(*args, int);
+			spec++;
+		}
+		while (*spec >= '0' && *spec <= '9') {
+			spec++;
+		}
+	}
+
+	return spec;
+}
+
+static const char* parse_length_modifier(const char* spec, enum template_value_length* length)
+{
+	switch (*spec) {
+	case 'h':
+		if (spec[1] == 'h') {
+			*length = TEMPLATE_VALUE_LENGTH_HH;
+			return spec + 2;
+		}
+		*length = TEMPLATE_VALUE_LENGTH_H;
+		return spec + 1;
+	case 'l':
+		if (spec[1] == 'l') {
+			*length = TEMPLATE_VALUE_LENGTH_LL;
+			return spec + 2;
+		}
+		*length = TEMPLATE_VALUE_LENGTH_L;
+		return spec + 1;
+	case 'j':
+		*length = TEMPLATE_VALUE_LENGTH_J;
+		return spec + 1;
+	case 'z':
+		*length = TEMPLATE_VALUE_LENGTH_Z;
+		return spec + 1;
+	case 't':
+		*length = TEMPLATE_VALUE_LENGTH_T;
+		return spec + 1;
+	case 'L':
+		*length = TEMPLATE_VALUE_LENGTH_UPPER_L;
+		return spec + 1;
+	default:
+		*length = TEMPLATE_VALUE_LENGTH_NONE;
+		return spec;
+	}
+}
+
+static int64_t get_signed_value(enum template_value_length length, va_list* args)
+{
+	switch (length) {
+	case TEMPLATE_VALUE_LENGTH_HH:
+		return (signed char)va_arg(*args, int);
+	case TEMPLATE_VALUE_LENGTH_H:
+		return (short)va_arg(*args, int);
+	case TEMPLATE_VALUE_LENGTH_L:
+		return va_arg(*args, long);
+	case TEMPLATE_VALUE_LENGTH_LL:
+		return va_arg(*args, long long);
+	case TEMPLATE_VALUE_LENGTH_J:
+		return va_arg(*args, intmax_t);
+	case TEMPLATE_VALUE_LENGTH_Z:
+	case TEMPLATE_VALUE_LENGTH_T:
+		return va_arg(*args, ptrdiff_t);
+	default:
+		return va_arg(*args, int);
+	}
+}
+
+static uint64_t get_unsigned_value(enum template_value_length length, va_list* args)
+{
+	switch (length) {
+	case TEMPLATE_VALUE_LENGTH_HH:
+		return (unsigned char)va_arg(*args, unsigned int);
+	case TEMPLATE_VALUE_LENGTH_H:
+		return (unsigned short)va_arg(*args, unsigned int);
+	case TEMPLATE_VALUE_LENGTH_L:
+		return va_arg(*args, unsigned long);
+	case TEMPLATE_VALUE_LENGTH_LL:
+		return va_arg(*args, unsigned long long);
+	case TEMPLATE_VALUE_LENGTH_J:
+		return va_arg(*args, uintmax_t);
+	case TEMPLATE_VALUE_LENGTH_Z:
+	case TEMPLATE_VALUE_LENGTH_T:
+		return va_arg(*args, size_t);
+	default:
+		return va_arg(*args, unsigned int);
+	}
+}
+
+/* Returns 1 if the argument was consumed without producing a value */
+static int read_template_value(struct spotflow_template_value* value, char conversion,
+			       enum template_value_length length, va_list* args)
+{
+	switch (conversion) {
+	case 'd':
+	case 'i':
+		value->type = SPOTFLOW_TEMPLATE_VALUE_INT;
+		value->int_value = get_signed_value(length, args);
+		return 0;
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		value->type = SPOTFLOW_TEMPLATE_VALUE_UINT;
+		value->uint_value = get_unsigned_value(length, args);
+		return 0;
+	case 'c':
+		value->type = SPOTFLOW_TEMPLATE_VALUE_CHAR;
+		value->char_value = (char)va_arg(*args, int);
+		return 0;
+	case 's': {
+		const char* str = va_arg(*args, const char*);
+		value->type = SPOTFLOW_TEMPLATE_VALUE_STRING;
+		value->string_value = str != NULL ? str : "(null)";
+		return 0;
+	}
+	case 'p':
+		value->type = SPOTFLOW_TEMPLATE_VALUE_UINT;
+		value->uint_value = (uintptr_t)va_arg(*args, void*);
+		return 0;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		value->type = SPOTFLOW_TEMPLATE_VALUE_DOUBLE;
+		if (length == TEMPLATE_VALUE_LENGTH_UPPER_L) {
+			value->double_value = (double)va_arg(*args, long double);
+		} else {
+			value->double_value = va_arg(*args, double);
+		}
+		return 0;
+	case 'n':
+		/* nothing is printed, only the pointer argument is consumed */
+		(void)va_arg(*args, void*);
+		return 1;
+	default:
+		/* size of the argument is unknown, the remaining arguments cannot be read */
+		return -ENOTSUP;
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef SPOTFLOW_LOG_TEMPLATE_H
+#define SPOTFLOW_LOG_TEMPLATE_H
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Types of the values read from the arguments of printf conversion specifications */
+enum spotflow_template_value_type {
+	SPOTFLOW_TEMPLATE_VALUE_INT,
+	SPOTFLOW_TEMPLATE_VALUE_UINT,
+	SPOTFLOW_TEMPLATE_VALUE_DOUBLE,
+	SPOTFLOW_TEMPLATE_VALUE_CHAR,
+	SPOTFLOW_TEMPLATE_VALUE_STRING,
+};
+
+struct spotflow_template_value {
+	enum spotflow_template_value_type type;
+	union {
+		int64_t int_value;
+		uint64_t uint_value;
+		double double_value;
+		char char_value;
+		/* Null-terminated, "(null)" for a NULL argument */
+		const char* string_value;
+	};
+};
+
+/**
+ * @brief Callback receiving the value of a conversion specification
+ *
+ * @param value Value read from the arguments
+ * @param ctx User context
+ * @return 0 to continue, negative error code to stop the walk
+ */
+typedef int (*spotflow_template_value_cb)(const struct spotflow_template_value* value, void* ctx);
+
+/**
+ * @brief Walk the template and read the argument of each conversion specification
+ *
+ * Shared by the platforms, so that the template values are read the same way regardless of the
+ * CBOR library encoding them. Arguments of the field width and precision are consumed but not
+ * reported, neither is the argument of %n.
+ *
+ * @param log_template Format string of the log
+ * @param args Arguments of the format string, the caller's list is not consumed
+ * @param cb Callback called for every value, in the order of the conversion specifications
+ * @param ctx User context passed to the callback
+ * @return 0 on success, -ENOTSUP on an unsupported conversion specification (the size of its
+ *         argument is unknown, so the remaining arguments cannot be read) or the negative value
+ *         returned by the callback
+ */
+int spotflow_log_template_walk_values(const char* log_template, va_list args,
+				      spotflow_template_value_cb cb, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPOTFLOW_LOG_TEMPLATE_H */
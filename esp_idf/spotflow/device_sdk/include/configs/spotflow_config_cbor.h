@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "sdkconfig.h"
+
 #define SPOTFLOW_CONFIG_RESPONSE_MAX_LENGTH 32
 
 #ifdef __cplusplus
@@ -13,6 +15,7 @@ extern "C" {
 
 typedef enum {
     SPOTFLOW_DESIRED_FLAG_MINIMAL_LOG_SEVERITY = (1u << 0),
+    SPOTFLOW_DESIRED_FLAG_TAG_MINIMAL_LOG_SEVERITIES = (1u << 1),
 } spotflow_config_desired_flags_t;
 
 typedef enum {
@@ -21,10 +24,17 @@ typedef enum {
     SPOTFLOW_REPORTED_FLAG_ACKED_DESIRED_CONFIG_VERSION = (1u << 2),
 } spotflow_config_reported_flags_t;
 
+struct spotflow_config_tag_severity {
+	char tag[CONFIG_SPOTFLOW_TAG_LOG_LEVELS_TAG_MAX_LEN + 1];
+	uint32_t severity;
+};
+
 struct spotflow_config_desired_msg {
 	spotflow_config_desired_flags_t flags;
 	uint32_t minimal_log_severity;
 	uint64_t desired_config_version;
+	size_t tag_severity_count;
+	struct spotflow_config_tag_severity tag_severities[CONFIG_SPOTFLOW_TAG_LOG_LEVELS_MAX_COUNT];
 };
 
 struct spotflow_config_reported_msg {
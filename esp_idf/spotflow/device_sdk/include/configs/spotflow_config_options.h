@@ -1,16 +1,28 @@
 #ifndef SPOTFLOW_CONFIG_OPTIONS_H
 #define SPOTFLOW_CONFIG_OPTIONS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "sdkconfig.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Sent log level overriding the global one for a single log tag */
+struct spotflow_config_tag_log_level {
+	char tag[CONFIG_SPOTFLOW_TAG_LOG_LEVELS_TAG_MAX_LEN + 1];
+	uint8_t level;
+};
+
 uint8_t spotflow_config_get_sent_log_level();
 void spotflow_config_init_sent_log_level_default();
 void spotflow_config_init_sent_log_level(uint8_t level);
 void spotflow_config_set_sent_log_level(uint8_t level);
+uint8_t spotflow_config_get_sent_log_level_for_tag(const char* tag);
+void spotflow_config_set_tag_log_levels(const struct spotflow_config_tag_log_level* levels,
+					size_t count);
 
 #ifdef __cplusplus
 }
@@ -5,6 +5,8 @@
 #include <stddef.h>
 #include <stdio.h>
 
+#include "sdkconfig.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,8 +18,12 @@ struct message_metadata {
 	const char* source;
 };
 
+void spotflow_log_backend_init(void);
+#if CONFIG_LOG_VERSION_1
 int spotflow_log_backend(const char* fmt, va_list args);
+#endif /* CONFIG_LOG_VERSION_1 */
 void spotflow_log_backend_try_set_runtime_filter(uint8_t level);
+void spotflow_log_backend_try_set_tag_runtime_filter(const char* tag, uint8_t level);
 
 #ifdef __cplusplus
 }
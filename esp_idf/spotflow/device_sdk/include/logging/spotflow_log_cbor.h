@@ -1,14 +1,18 @@
 #ifndef SPOTFLOW_LOG_CBOR_H
 #define SPOTFLOW_LOG_CBOR_H
 
+#include <stdarg.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-uint8_t* spotflow_log_cbor(const char* log_template, char* body, size_t* out_len,
-			   const struct message_metadata* metadata);
-void spotflow_log_cbor_send(const char* log_template, char* buffer,
-			    const struct message_metadata* metadata);
+int spotflow_log_cbor(const char* log_template, const char* body, size_t body_len,
+		      const struct message_metadata* metadata, uint8_t* buf, size_t buf_size,
+		      size_t* out_len);
+int spotflow_log_cbor_template_values(const char* log_template, va_list args,
+				      const struct message_metadata* metadata, uint8_t* buf,
+				      size_t buf_size, size_t* out_len);
 
 uint32_t spotflow_cbor_convert_log_level_to_severity(uint8_t lvl);
 uint8_t spotflow_cbor_convert_severity_to_log_level(uint32_t severity);
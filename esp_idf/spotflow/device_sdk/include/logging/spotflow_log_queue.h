@@ -8,11 +8,13 @@ extern "C" {
 typedef struct {
 	uint8_t* ptr;
 	size_t len;
+	uint8_t level; /* esp_log_level_t of log messages, unused by other queues */
 } queue_msg_t;
 
-void spotflow_queue_push(uint8_t* msg, size_t len);
+void spotflow_queue_push(uint8_t* msg, size_t len, uint8_t level);
 bool spotflow_queue_read(queue_msg_t* out);
 void spotflow_queue_free(queue_msg_t* msg);
+size_t spotflow_queue_get_dropped_count(uint8_t level);
 void spotflow_queue_init(void);
 
 #ifdef __cplusplus
@@ -103,6 +103,83 @@ int spotflow_report_event(struct spotflow_metric_int* metric);
 int spotflow_report_event_with_labels(struct spotflow_metric_int* metric,
 				      const struct spotflow_label* labels, uint8_t label_count);
 
+/**
+ * @brief Bind a label set of a labeled integer metric
+ *
+ * Resolves the labels to their time series once, so reporting through the bound handle does no
+ * label validation, hashing or string comparison. The bound time series is never evicted when
+ * the time series pool is full, so the handle stays valid. Bind only label sets that are
+ * reported repeatedly, each of them permanently occupies one of max_timeseries slots.
+ * Binding the same label set again returns a handle of the same time series.
+ *
+ * @param metric Metric handle from registration (must be labeled)
+ * @param labels Array of label key-value pairs
+ * @param label_count Number of labels
+ * @param bound_out Output parameter for the bound metric handle
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Invalid parameters
+ *         -ENOSPC: Time series pool full (max_timeseries limit reached)
+ */
+int spotflow_metric_bind_labels_int(struct spotflow_metric_int* metric,
+				    const struct spotflow_label* labels, uint8_t label_count,
+				    struct spotflow_bound_metric_int* bound_out);
+
+/**
+ * @brief Bind a label set of a labeled float metric
+ *
+ * See spotflow_metric_bind_labels_int().
+ *
+ * @param metric Metric handle from registration (must be labeled)
+ * @param labels Array of label key-value pairs
+ * @param label_count Number of labels
+ * @param bound_out Output parameter for the bound metric handle
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Invalid parameters
+ *         -ENOSPC: Time series pool full (max_timeseries limit reached)
+ */
+int spotflow_metric_bind_labels_float(struct spotflow_metric_float* metric,
+				      const struct spotflow_label* labels, uint8_t label_count,
+				      struct spotflow_bound_metric_float* bound_out);
+
+/**
+ * @brief Report an integer metric value with the bound labels
+ *
+ * @param bound Bound metric handle from spotflow_metric_bind_labels_int()
+ * @param value Integer value to report
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Handle was not bound
+ *         -ENOBUFS: Metric queue full (non-aggregated metrics)
+ */
+int spotflow_report_bound_int(struct spotflow_bound_metric_int* bound, int64_t value);
+
+/**
+ * @brief Report a float metric value with the bound labels
+ *
+ * @param bound Bound metric handle from spotflow_metric_bind_labels_float()
+ * @param value Float value to report
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Handle was not bound
+ *         -ENOBUFS: Metric queue full (non-aggregated metrics)
+ */
+int spotflow_report_bound_float(struct spotflow_bound_metric_float* bound, float value);
+
+/**
+ * @brief Report an event with the bound labels
+ *
+ * Equivalent to calling spotflow_report_bound_int(bound, 1).
+ *
+ * @param bound Bound metric handle from spotflow_metric_bind_labels_int()
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Handle was not bound
+ *         -ENOBUFS: Metric queue full
+ */
+int spotflow_report_bound_event(struct spotflow_bound_metric_int* bound);
+
 #ifdef __cplusplus
 }
 #endif
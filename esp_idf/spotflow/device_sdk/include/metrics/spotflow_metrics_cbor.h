@@ -20,6 +20,7 @@ extern "C" {
  *
  * @param metric Metric base handle
  * @param ts Time series state to encode
+ * @param labels Label set of the time series, NULL for label-less metrics
  * @param timestamp_ms Device uptime in milliseconds when aggregation window closed
  * @param sequence_number Sequence number for this message
  * @param cbor_data Output: allocated CBOR buffer
@@ -31,6 +32,7 @@ extern "C" {
  */
 int spotflow_metrics_cbor_encode_aggregated(struct spotflow_metric_base* metric,
 					    struct metric_timeseries_state* ts,
+					    const struct metric_timeseries_labels* labels,
 					    int64_t timestamp_ms, uint64_t sequence_number,
 					    uint8_t** cbor_data, size_t* cbor_len);
 
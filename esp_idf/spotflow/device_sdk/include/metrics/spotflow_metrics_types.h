@@ -53,13 +53,11 @@ struct metric_label_storage {
 /**
  * @brief Time series state (internal use)
  *
- * Tracks aggregation state for one unique label combination.
+ * Tracks aggregation state for one unique label combination. Only the fields touched by reports
+ * and window closing are kept here, the label set is in struct metric_timeseries_labels of the
+ * same slot, so scanning and updating the time series does not pull label strings into the cache.
  */
 struct metric_timeseries_state {
-	/* Label identification */
-	uint8_t label_count; /* Number of labels (0 for label-less) */
-	struct metric_label_storage labels[CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC];
-
 	/* Aggregation state */
 	union {
 		int64_t sum_int;
@@ -77,6 +75,18 @@ struct metric_timeseries_state {
 	bool sum_truncated; /* Sum overflow flag */
 
 	bool active; /* Slot in use */
+	bool bound; /* Referenced by a bound label set handle, never evicted */
+	uint32_t labels_hash; /* Hash of the label set, key of the time series index */
+};
+
+/**
+ * @brief Label set of a time series (internal use)
+ *
+ * Read only to compare the label sets with equal hashes and to encode the time series.
+ */
+struct metric_timeseries_labels {
+	uint8_t label_count; /* Number of labels */
+	struct metric_label_storage labels[CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC];
 };
 
 /**
@@ -122,6 +132,26 @@ struct spotflow_metric_float {
 	struct spotflow_metric_base base;
 };
 
+/**
+ * @brief Integer metric with a bound label set
+ *
+ * Filled by spotflow_metric_bind_labels_int(), fields are internal.
+ */
+struct spotflow_bound_metric_int {
+	struct spotflow_metric_base* metric;
+	struct metric_timeseries_state* timeseries;
+};
+
+/**
+ * @brief Float metric with a bound label set
+ *
+ * Filled by spotflow_metric_bind_labels_float(), fields are internal.
+ */
+struct spotflow_bound_metric_float {
+	struct spotflow_metric_base* metric;
+	struct metric_timeseries_state* timeseries;
+};
+
 /**
  * @brief Aggregator context per metric (internal use)
  */
@@ -131,11 +161,22 @@ struct metric_aggregator_context {
 	uint16_t timeseries_count; /* Current number of active time series */
 	uint16_t timeseries_capacity; /* Max (from metric->max_timeseries) */
 
-	/* Timer scope: ONE timer per metric (not per time series) */
-	/* All time series of this metric share the same aggregation window */
-	/* When timer expires, all active time series generate messages with their counts */
-	esp_timer_handle_t aggregation_timer;
-	bool timer_started; /* Flag to prevent timer restart race */
+	/* Label set per time series slot (NULL for label-less metrics) */
+	struct metric_timeseries_labels* labels;
+
+	/* Open addressing hash index of time series by their label set hash (NULL for
+	 * label-less metrics). Entries are time series slot numbers + 1, 0 marks an empty entry.
+	 * Linear probing, the capacity is a power of two at least twice the time series capacity.
+	 */
+	uint16_t* index;
+	uint16_t index_mask; /* Index capacity - 1 */
+
+	/* All time series of this metric share the same aggregation window. Windows of all metrics
+	 * are closed by one timer, metrics wait for it in a list sorted by their window end.
+	 */
+	struct metric_aggregator_context* next_scheduled; /* Next metric in the scheduler list */
+	int64_t window_end_ms; /* Uptime when the current window closes */
+	bool timer_started; /* Scheduled since the first report, flag to prevent restart race */
 };
 
 /**
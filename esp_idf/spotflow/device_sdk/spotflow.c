@@ -55,8 +55,11 @@ void spotflow_init(void)
 {
 	spotflow_mqtt_event_group_init(); //Initialize the MQTT event group
 #ifdef CONFIG_SPOTFLOW_LOG_BACKEND
-	original_vprintf = esp_log_set_vprintf(spotflow_log_backend);
+	spotflow_log_backend_init();
 	spotflow_queue_init(); //Initilize the queue
+#if CONFIG_LOG_VERSION_1
+	original_vprintf = esp_log_set_vprintf(spotflow_log_backend);
+#endif /* CONFIG_LOG_VERSION_1, Log V2 calls are wrapped by the linker */
 	spotflow_config_init();
 #endif
 
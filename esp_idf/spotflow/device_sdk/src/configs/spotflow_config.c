@@ -1,5 +1,8 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+
+#include "esp_log_level.h"
 
 #include "spotflow.h"
 #include "logging/spotflow_log_backend.h"
@@ -11,6 +14,7 @@
 #include "configs/spotflow_config_options.h"
 
 static void add_log_severity_to_reported_msg(struct spotflow_config_reported_msg* reported_msg);
+static void update_tag_log_levels(const struct spotflow_config_desired_msg* desired_msg);
 
 /**
  * @brief Initilize the cloud configurable log level.
@@ -97,6 +101,10 @@ void spotflow_config_handle_desired_message(const uint8_t* payload, int len)
 		}
 	}
 
+	if (desired_msg.flags & SPOTFLOW_DESIRED_FLAG_TAG_MINIMAL_LOG_SEVERITIES) {
+		update_tag_log_levels(&desired_msg);
+	}
+
 	SPOTFLOW_LOG("Reported log severity %lu, desired config version %lu \n\n",
 		     reported_msg.minimal_log_severity, desired_msg.minimal_log_severity);
 	rc = spotflow_config_prepare_pending_message(&reported_msg);
@@ -106,6 +114,29 @@ void spotflow_config_handle_desired_message(const uint8_t* payload, int len)
 	}
 }
 
+/**
+ * @brief Replace the sent log levels of individual tags by the received ones.
+ *
+ * @param desired_msg
+ */
+static void update_tag_log_levels(const struct spotflow_config_desired_msg* desired_msg)
+{
+	struct spotflow_config_tag_log_level levels[CONFIG_SPOTFLOW_TAG_LOG_LEVELS_MAX_COUNT];
+
+	for (size_t i = 0; i < desired_msg->tag_severity_count; i++) {
+		const struct spotflow_config_tag_severity* tag_severity =
+		    &desired_msg->tag_severities[i];
+
+		strcpy(levels[i].tag, tag_severity->tag);
+		/* Severity 0 silences the tag completely */
+		levels[i].level = tag_severity->severity == 0
+				      ? ESP_LOG_NONE
+				      : spotflow_cbor_convert_severity_to_log_level(tag_severity->severity);
+	}
+
+	spotflow_config_set_tag_log_levels(levels, desired_msg->tag_severity_count);
+}
+
 /**
  * @brief Add current compiled maximum log level and the current log severity.
  *
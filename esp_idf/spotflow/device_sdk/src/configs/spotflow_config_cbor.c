@@ -13,10 +13,13 @@
 #define KEY_COMPILED_MINIMAL_SEVERITY 0x11
 #define KEY_DESIRED_CONFIGURATION_VERSION 0x12
 #define KEY_ACKNOWLEDGED_DESIRED_CONFIGURATION_VERSION 0x13
+#define KEY_TAG_MINIMAL_SEVERITIES 0x14
 
 #define UPDATE_DESIRED_CONFIGURATION_MESSAGE_TYPE 0x03
 #define UPDATE_REPORTED_CONFIGURATION_MESSAGE_TYPE 0x04
 
+static int decode_tag_severities(CborValue* value, struct spotflow_config_desired_msg* msg);
+
 /**
  * @brief
  *
@@ -98,6 +101,11 @@ int spotflow_config_cbor_decode_desired(const uint8_t* payload, size_t len,
 				return -1;
 			}
 			msg->desired_config_version = version;
+		} else if (key == KEY_TAG_MINIMAL_SEVERITIES) {
+			if (decode_tag_severities(&map_it, msg) < 0) {
+				return -1;
+			}
+			msg->flags |= SPOTFLOW_DESIRED_FLAG_TAG_MINIMAL_LOG_SEVERITIES;
 		} else {
 			// skip unknown keys
 			err = cbor_value_skip_tag(&map_it);
@@ -123,6 +131,68 @@ int spotflow_config_cbor_decode_desired(const uint8_t* payload, size_t len,
 	return 0;
 }
 
+/**
+ * @brief Decode the map of tags to their minimal log severities
+ *
+ * Entries with too long tags or above the maximum count are skipped. The map is not left, the
+ * caller advances over it.
+ *
+ * @param value
+ * @param msg
+ * @return int
+ */
+static int decode_tag_severities(CborValue* value, struct spotflow_config_desired_msg* msg)
+{
+	if (!cbor_value_is_map(value)) {
+		SPOTFLOW_DEBUG("[CONFIG_CBOR] Tag severities are not a map.");
+		return -1;
+	}
+
+	CborValue tag_it;
+	CborError err = cbor_value_enter_container(value, &tag_it);
+	if (err != CborNoError) {
+		SPOTFLOW_DEBUG("[CONFIG_CBOR] Error Code %d ", err);
+		return -1;
+	}
+
+	while (!cbor_value_at_end(&tag_it)) {
+		struct spotflow_config_tag_severity* entry = NULL;
+		bool has_tag = false;
+
+		if (msg->tag_severity_count < CONFIG_SPOTFLOW_TAG_LOG_LEVELS_MAX_COUNT) {
+			entry = &msg->tag_severities[msg->tag_severity_count];
+		}
+
+		if (entry != NULL && cbor_value_is_text_string(&tag_it)) {
+			size_t tag_len = sizeof(entry->tag);
+			has_tag = cbor_value_copy_text_string(&tag_it, entry->tag, &tag_len, NULL) ==
+				  CborNoError;
+		}
+
+		err = cbor_value_advance(&tag_it);
+		if (err != CborNoError) {
+			SPOTFLOW_DEBUG("[CONFIG_CBOR] Error Code %d ", err);
+			return -1;
+		}
+
+		uint64_t severity;
+		if (has_tag && cbor_value_get_uint64(&tag_it, &severity) == CborNoError) {
+			entry->severity = (uint32_t)severity;
+			msg->tag_severity_count++;
+		} else {
+			SPOTFLOW_DEBUG("[CONFIG_CBOR] Skipping tag severity entry.");
+		}
+
+		err = cbor_value_advance(&tag_it);
+		if (err != CborNoError) {
+			SPOTFLOW_DEBUG("[CONFIG_CBOR] Error Code %d ", err);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
 /**
  * @brief
  *
@@ -1,6 +1,9 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+#include <sys/param.h>
 
+#include "freertos/FreeRTOS.h"
 #include "esp_log.h"
 #include "esp_log_level.h"
 #include "spotflow.h"
@@ -9,6 +12,19 @@
 
 static volatile uint8_t sent_log_level = CONFIG_SPOTFLOW_DEFAULT_SENT_LOG_LEVEL;
 
+struct tag_log_level_entry {
+	uint32_t hash;
+	struct spotflow_config_tag_log_level tag_level;
+};
+
+/* Looked up from the log hook of every task, updated from the MQTT task */
+static struct tag_log_level_entry tag_log_levels[CONFIG_SPOTFLOW_TAG_LOG_LEVELS_MAX_COUNT];
+static volatile size_t tag_log_level_count;
+static portMUX_TYPE tag_log_levels_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t hash_tag(const char* tag);
+static void apply_tag_runtime_filters(void);
+
 uint8_t spotflow_config_get_sent_log_level()
 {
 	return sent_log_level;
@@ -20,6 +36,7 @@ void spotflow_config_init_sent_log_level(uint8_t level)
 	SPOTFLOW_LOG("Initialized sent log level to %d", sent_log_level);
 
 	spotflow_log_backend_try_set_runtime_filter(sent_log_level);
+	apply_tag_runtime_filters();
 }
 
 void spotflow_config_init_sent_log_level_default()
@@ -37,4 +54,92 @@ void spotflow_config_set_sent_log_level(uint8_t level)
 	sent_log_level = level;
 
 	spotflow_log_backend_try_set_runtime_filter(level);
+	apply_tag_runtime_filters();
+}
+
+/**
+ * @brief Get the sent log level of the given tag, the global one if the tag has none
+ *
+ * Called for every log before it is formatted, so tags without their own level cost only
+ * a single check.
+ *
+ * @param tag
+ * @return uint8_t
+ */
+uint8_t spotflow_config_get_sent_log_level_for_tag(const char* tag)
+{
+	uint8_t level = sent_log_level;
+	if (tag == NULL || tag_log_level_count == 0) {
+		return level;
+	}
+
+	uint32_t hash = hash_tag(tag);
+
+	portENTER_CRITICAL(&tag_log_levels_lock);
+	for (size_t i = 0; i < tag_log_level_count; i++) {
+		const struct tag_log_level_entry* entry = &tag_log_levels[i];
+		if (entry->hash == hash && strcmp(entry->tag_level.tag, tag) == 0) {
+			level = entry->tag_level.level;
+			break;
+		}
+	}
+	portEXIT_CRITICAL(&tag_log_levels_lock);
+
+	return level;
+}
+
+/**
+ * @brief Replace the sent log levels of individual tags
+ *
+ * Tags dropped from the table fall back to the global sent log level.
+ *
+ * @param levels
+ * @param count
+ */
+void spotflow_config_set_tag_log_levels(const struct spotflow_config_tag_log_level* levels,
+					size_t count)
+{
+	count = MIN(count, (size_t)CONFIG_SPOTFLOW_TAG_LOG_LEVELS_MAX_COUNT);
+
+#if CONFIG_SPOTFLOW_LOG_BACKEND_SET_RUNTIME_FILTERING
+	/* Only the MQTT task updates the table, so it can be read without the lock here */
+	for (size_t i = 0; i < tag_log_level_count; i++) {
+		spotflow_log_backend_try_set_tag_runtime_filter(tag_log_levels[i].tag_level.tag,
+								sent_log_level);
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_BACKEND_SET_RUNTIME_FILTERING */
+
+	portENTER_CRITICAL(&tag_log_levels_lock);
+	for (size_t i = 0; i < count; i++) {
+		tag_log_levels[i].hash = hash_tag(levels[i].tag);
+		tag_log_levels[i].tag_level = levels[i];
+	}
+	tag_log_level_count = count;
+	portEXIT_CRITICAL(&tag_log_levels_lock);
+
+	for (size_t i = 0; i < count; i++) {
+		SPOTFLOW_LOG("Updated sent log level of tag %s to %d", levels[i].tag, levels[i].level);
+	}
+
+	apply_tag_runtime_filters();
+}
+
+/* FNV-1a, tags are short so it is cheaper than comparing them with all the table entries */
+static uint32_t hash_tag(const char* tag)
+{
+	uint32_t hash = 2166136261u;
+	for (; *tag != '\0'; tag++) {
+		hash = (hash ^ (uint8_t)*tag) * 16777619u;
+	}
+	return hash;
+}
+
+static void apply_tag_runtime_filters(void)
+{
+#if CONFIG_SPOTFLOW_LOG_BACKEND_SET_RUNTIME_FILTERING
+	for (size_t i = 0; i < tag_log_level_count; i++) {
+		spotflow_log_backend_try_set_tag_runtime_filter(tag_log_levels[i].tag_level.tag,
+								tag_log_levels[i].tag_level.level);
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_BACKEND_SET_RUNTIME_FILTERING */
 }
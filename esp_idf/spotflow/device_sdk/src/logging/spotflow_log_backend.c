@@ -2,10 +2,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
 
 #include "spotflow.h"
 #include "logging/spotflow_log_backend.h"
 #include "logging/spotflow_log_cbor.h"
+#include "logging/spotflow_log_queue.h"
+#include "configs/spotflow_config_options.h"
+#include "net/spotflow_mqtt.h"
 // static const char *TAG = "spotflow_testing"; // Currently the Spotflow_LOG doesn't support tags
 
 typedef enum {
@@ -16,12 +24,46 @@ typedef enum {
 	SPOTFLOW_LOG_PREFIX_V1_TIME_STRING,
 } spotflow_log_prefix_t;
 
+/*
+ * Scratch buffers of a CPU core, shared by the tasks logging on it. The log hook runs in the
+ * context of the logging task, so the message is rendered and encoded without heap allocation.
+ * The mutex only serializes the tasks of one core (or tasks migrated in between).
+ */
+struct spotflow_log_scratch {
+	SemaphoreHandle_t mutex;
+	StaticSemaphore_t mutex_buffer;
+#if !CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING
+	char body[CONFIG_SPOTFLOW_LOG_BUFFER_SIZE];
+#endif /* !CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING */
+	uint8_t cbor[CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN];
+};
+
+static struct spotflow_log_scratch log_scratch[portNUM_PROCESSORS];
+static size_t log_sequence;
+
+static int filter_and_send_log(const char* body_fmt, va_list args,
+			       struct message_metadata* metadata);
+static int send_log(const char* body_fmt, va_list args, struct message_metadata* metadata);
+
+/**
+ * @brief Create the scratch buffer locks, must be called before the log hook is installed
+ */
+void spotflow_log_backend_init(void)
+{
+	for (size_t i = 0; i < portNUM_PROCESSORS; i++) {
+		if (log_scratch[i].mutex == NULL) {
+			log_scratch[i].mutex =
+			    xSemaphoreCreateMutexStatic(&log_scratch[i].mutex_buffer);
+		}
+	}
+}
+
+#if CONFIG_LOG_VERSION_1
 int spotflow_log_backend(const char* fmt, va_list args)
 {
-	static size_t sequence = 0;
 	struct message_metadata metadata = { 0 };
-	metadata.sequence_number = sequence;
-	sequence++;
+	metadata.sequence_number = log_sequence;
+	log_sequence++;
 
 	const char* body_fmt = fmt;
 	const char* prefix_end = NULL;
@@ -78,43 +120,115 @@ int spotflow_log_backend(const char* fmt, va_list args)
 		}
 	}
 
-	// Each va_list consumer needs its own copy; vsnprintf/va_arg leave it exhausted.
-	va_list args_len;
-	va_copy(args_len, args_after_prefix);
-	int len = vsnprintf(NULL, 0, body_fmt, args_len); // Get the required length
-	va_end(args_len);
+	int len = filter_and_send_log(body_fmt, args_after_prefix, &metadata);
+	va_end(args_after_prefix);
 
-	// If the len is smaller than 0 or if the log is bigger than the set buffer size.
-	if (len < 0 || len >= CONFIG_SPOTFLOW_LOG_BUFFER_SIZE) {
-		va_end(args_after_prefix);
+	// Optionally, call original log output to keep default behavior
+	if (original_vprintf) {
+		return original_vprintf(fmt, args);
+	}
+	return len;
+}
+#else
+/*
+ * ESP-IDF Log V2 passes the level and tag as fields and the format without any prefix, so no
+ * parsing is needed. All ESP_LOGx calls are redirected here by the linker (--wrap=esp_log).
+ * Logs from constrained environments (early boot, ISR, cache disabled) and logs filtered out by
+ * the runtime level of their tag are only passed on.
+ */
+void __wrap_esp_log(esp_log_config_t config, const char* tag, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+
+	if (!config.opts.constrained_env && config.opts.log_level <= esp_log_level_get(tag)) {
+		struct message_metadata metadata = {
+			.severity = spotflow_cbor_convert_log_level_to_severity(
+			    MIN(config.opts.log_level, ESP_LOG_DEBUG)),
+			.uptime_ms = esp_log_timestamp(),
+			.sequence_number = log_sequence++,
+			.source = tag,
+		};
+		filter_and_send_log(format, args, &metadata);
+	}
+
+	esp_log_va(config, tag, format, args);
+	va_end(args);
+}
+#endif /* CONFIG_LOG_VERSION_1 */
+
+/**
+ * @brief Send the message if its level passes the configured level of its tag
+ *
+ * Messages filtered out are neither rendered nor encoded.
+ *
+ * @param body_fmt Format string of the message without the ESP-IDF prefix
+ * @param args Arguments of the message without the prefix arguments
+ * @param metadata
+ * @return Length of the rendered message, 0 if filtered out
+ */
+static int filter_and_send_log(const char* body_fmt, va_list args,
+			       struct message_metadata* metadata)
+{
+	uint8_t level = spotflow_cbor_convert_severity_to_log_level(metadata->severity);
+	if (level > spotflow_config_get_sent_log_level_for_tag(metadata->source)) {
 		return 0;
 	}
 
-	// Dynamically assign memory in heap depending on the log size.
-	char* buffer = malloc(len + 1); // +1 for null terminator
-	if (!buffer) {
-		va_end(args_after_prefix);
+	return send_log(body_fmt, args, metadata);
+}
+
+/**
+ * @brief Render the message in a single pass, encode it and copy it into the message queue
+ *
+ * With CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING, the arguments are encoded instead of rendered.
+ *
+ * @param body_fmt Format string of the message without the ESP-IDF prefix
+ * @param args Arguments of the message without the prefix arguments
+ * @param metadata
+ * @return Length of the rendered message, negative on formatting error
+ */
+static int send_log(const char* body_fmt, va_list args, struct message_metadata* metadata)
+{
+	struct spotflow_log_scratch* scratch = &log_scratch[xPortGetCoreID()];
+	if (scratch->mutex == NULL) {
 		return 0;
 	}
 
+	xSemaphoreTake(scratch->mutex, portMAX_DELAY);
+
+#if CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING
+	size_t cbor_len = 0;
+	int len = 0;
+	int rc = spotflow_log_cbor_template_values(body_fmt, args, metadata, scratch->cbor,
+						   sizeof(scratch->cbor), &cbor_len);
+#else
 	va_list args_body;
-	va_copy(args_body, args_after_prefix);
-	va_end(args_after_prefix);
-	len = vsnprintf(buffer, len + 1, body_fmt, args_body);
+	va_copy(args_body, args);
+	int len = vsnprintf(scratch->body, sizeof(scratch->body), body_fmt, args_body);
 	va_end(args_body);
 
-	if (len < 0) {
-		free(buffer);
-		return 0;
+	size_t cbor_len = 0;
+	int rc = -1;
+	if (len > 0) {
+		// Messages longer than the buffer are truncated
+		size_t body_len = MIN((size_t)len, sizeof(scratch->body) - 1);
+		rc = spotflow_log_cbor(body_fmt, scratch->body, body_len, metadata, scratch->cbor,
+				       sizeof(scratch->cbor), &cbor_len);
 	}
+#endif /* CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING */
 
-	spotflow_log_cbor_send(body_fmt, buffer, &metadata);
+	if (rc == 0) {
+		uint8_t level = spotflow_cbor_convert_severity_to_log_level(metadata->severity);
+		spotflow_queue_push(scratch->cbor, cbor_len, level);
+	}
 
-	free(buffer);
-	// Optionally, call original log output to keep default behavior
-	if (original_vprintf) {
-		return original_vprintf(fmt, args);
+	xSemaphoreGive(scratch->mutex);
+
+	if (rc == 0) {
+		spotflow_mqtt_notify_action(SPOTFLOW_MQTT_NOTIFY_LOGS);
 	}
+
 	return len;
 }
 
@@ -131,3 +245,18 @@ void spotflow_log_backend_try_set_runtime_filter(uint8_t level)
 
 #endif /* CONFIG_SPOTFLOW_LOG_BACKEND_SET_RUNTIME_FILTERING */
 }
+
+/**
+ * @brief Set the value of a single tag at low level such that device doesn't generate its logs
+ *
+ * @param tag
+ * @param level
+ */
+void spotflow_log_backend_try_set_tag_runtime_filter(const char* tag, uint8_t level)
+{
+#if CONFIG_SPOTFLOW_LOG_BACKEND_SET_RUNTIME_FILTERING
+
+	esp_log_level_set(tag, level);
+
+#endif /* CONFIG_SPOTFLOW_LOG_BACKEND_SET_RUNTIME_FILTERING */
+}
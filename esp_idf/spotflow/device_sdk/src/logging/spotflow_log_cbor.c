@@ -1,8 +1,13 @@
 
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+
 #include "spotflow.h"
 #include "logging/spotflow_log_backend.h"
 #include "logging/spotflow_log_cbor.h"
 #include "logging/spotflow_log_queue.h"
+#include "spotflow_log_template.h"
 #include "configs/spotflow_config_options.h"
 #include "net/spotflow_mqtt.h"
 #include "esp_log_level.h"
@@ -13,7 +18,6 @@
 #define LOGS_MESSAGE_TYPE 0x00
 #define KEY_BODY 0x01
 #define KEY_BODY_TEMPLATE 0x02
-/* (unused for now) */
 #define KEY_BODY_TEMPLATE_VALUES 0x03
 #define KEY_SEVERITY 0x04
 #define KEY_LABELS 0x05
@@ -27,39 +31,41 @@ typedef enum {
 	LOG_SEVERITY_DEBUG = 0x1E, // Debug
 } LogSeverity;
 
+static void encode_log_fields(CborEncoder* map_encoder, const char* log_template,
+			      const struct message_metadata* metadata);
+static int finish_log_cbor(CborEncoder* encoder, CborEncoder* map_encoder, const uint8_t* buf,
+			   size_t* out_len);
+static int encode_template_value(const struct spotflow_template_value* value, void* ctx);
+
 /**
  * @brief To create the message format for logs in CBOR format
  *
- * @param body
- * @param severity
- * @param out_len
- * @return uint8_t*
+ * @param log_template Format string of the log
+ * @param body Rendered log message, not necessarily null-terminated
+ * @param body_len Length of the rendered log message
+ * @param metadata
+ * @param buf Buffer receiving the CBOR message
+ * @param buf_size Size of the buffer
+ * @param out_len Length of the CBOR message
+ * @return 0 on success, -1 if the message does not fit into the buffer
  */
-uint8_t* spotflow_log_cbor(const char* log_template, char* body, size_t* out_len,
-			   const struct message_metadata* metadata)
+int spotflow_log_cbor(const char* log_template, const char* body, size_t body_len,
+		      const struct message_metadata* metadata, uint8_t* buf, size_t buf_size,
+		      size_t* out_len)
 {
 	// Buffer to create array to cointain several items
 	CborEncoder array_encoder;
 	CborEncoder map_encoder;
-	CborEncoder labels_encoder;
-
-	uint8_t* buf = malloc(CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN);
-	if (!buf) {
-		SPOTFLOW_LOG("Failed to allocate CBOR buffer");
-		return NULL;
-	}
-
-	int body_len = strlen(body);
 
 	// Check if the last character is a newline and remove it
 	if (body_len > 0 && body[body_len - 1] == '\n') {
-		body[body_len - 1] = '\0';
+		body_len--;
 	}
 
 	int has_severity = metadata->severity != 0;
 	int has_source = metadata->source && metadata->source[0] != '\0';
 
-	cbor_encoder_init(&array_encoder, buf, CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN, 0);
+	cbor_encoder_init(&array_encoder, buf, buf_size, 0);
 	cbor_encoder_create_map(&array_encoder, &map_encoder, 5 + has_severity + has_source); // {
 	// Get device uptime in milliseconds since boot
 	/* messageType: "LOG" */
@@ -67,62 +73,153 @@ uint8_t* spotflow_log_cbor(const char* log_template, char* body, size_t* out_len
 	cbor_encode_uint(&map_encoder, LOGS_MESSAGE_TYPE);
 
 	cbor_encode_uint(&map_encoder, KEY_BODY);
-	cbor_encode_text_stringz(&map_encoder, body);
+	cbor_encode_text_string(&map_encoder, body, body_len);
+
+	encode_log_fields(&map_encoder, log_template, metadata);
+
+	return finish_log_cbor(&array_encoder, &map_encoder, buf, out_len);
+}
+
+/**
+ * @brief To create the message format for logs in CBOR format without formatting the message
+ *
+ * The arguments are encoded as an array of template values, in the order of the conversion
+ * specifications of the template, and the message is formatted in the cloud.
+ *
+ * @param log_template Format string of the log
+ * @param args Arguments of the format string
+ * @param metadata
+ * @param buf Buffer receiving the CBOR message
+ * @param buf_size Size of the buffer
+ * @param out_len Length of the CBOR message
+ * @return 0 on success, -1 if the message does not fit into the buffer or the template contains
+ *         an unsupported conversion specification
+ */
+int spotflow_log_cbor_template_values(const char* log_template, va_list args,
+				      const struct message_metadata* metadata, uint8_t* buf,
+				      size_t buf_size, size_t* out_len)
+{
+	CborEncoder array_encoder;
+	CborEncoder map_encoder;
+	CborEncoder values_encoder;
+
+	int has_severity = metadata->severity != 0;
+	int has_source = metadata->source && metadata->source[0] != '\0';
+
+	cbor_encoder_init(&array_encoder, buf, buf_size, 0);
+	cbor_encoder_create_map(&array_encoder, &map_encoder, 5 + has_severity + has_source); // {
+	cbor_encode_uint(&map_encoder, KEY_MESSAGE_TYPE);
+	cbor_encode_uint(&map_encoder, LOGS_MESSAGE_TYPE);
+
+	cbor_encode_uint(&map_encoder, KEY_BODY_TEMPLATE_VALUES);
+	cbor_encoder_create_array(&map_encoder, &values_encoder, CborIndefiniteLength); // [
+	if (spotflow_log_template_walk_values(log_template, args, encode_template_value,
+					      &values_encoder) < 0) {
+		SPOTFLOW_DEBUG("Unsupported conversion specification in template: %s", log_template);
+		return -1;
+	}
+	cbor_encoder_close_container(&map_encoder, &values_encoder); // ]
+
+	encode_log_fields(&map_encoder, log_template, metadata);
+
+	return finish_log_cbor(&array_encoder, &map_encoder, buf, out_len);
+}
+
+/**
+ * @brief Encode the severity, template and metadata shared by all the log messages
+ *
+ * @param map_encoder
+ * @param log_template
+ * @param metadata
+ */
+static void encode_log_fields(CborEncoder* map_encoder, const char* log_template,
+			      const struct message_metadata* metadata)
+{
+	CborEncoder labels_encoder;
 
-	if (has_severity) {
-		cbor_encode_uint(&map_encoder, KEY_SEVERITY);
-		cbor_encode_uint(&map_encoder, metadata->severity);
+	if (metadata->severity != 0) {
+		cbor_encode_uint(map_encoder, KEY_SEVERITY);
+		cbor_encode_uint(map_encoder, metadata->severity);
 	}else{
 		SPOTFLOW_DEBUG("Log severity is 0, skipping severity field in CBOR");
 	}
 
-	cbor_encode_uint(&map_encoder, KEY_BODY_TEMPLATE);
-	cbor_encode_text_stringz(&map_encoder, log_template);
+	cbor_encode_uint(map_encoder, KEY_BODY_TEMPLATE);
+	cbor_encode_text_stringz(map_encoder, log_template);
 	//------------Metadata
 
-	cbor_encode_uint(&map_encoder, KEY_SEQUENCE_NUMBER);
-	cbor_encode_uint(&map_encoder, metadata->sequence_number);
+	cbor_encode_uint(map_encoder, KEY_SEQUENCE_NUMBER);
+	cbor_encode_uint(map_encoder, metadata->sequence_number);
 
-	cbor_encode_uint(&map_encoder, KEY_DEVICE_UPTIME_MS);
-	cbor_encode_uint(&map_encoder, metadata->uptime_ms);
+	cbor_encode_uint(map_encoder, KEY_DEVICE_UPTIME_MS);
+	cbor_encode_uint(map_encoder, metadata->uptime_ms);
 
-	if (has_source) {
-		cbor_encode_uint(&map_encoder, KEY_LABELS);
-		cbor_encoder_create_map(&map_encoder, &labels_encoder, 1); // {
+	if (metadata->source && metadata->source[0] != '\0') {
+		cbor_encode_uint(map_encoder, KEY_LABELS);
+		cbor_encoder_create_map(map_encoder, &labels_encoder, 1); // {
 		cbor_encode_text_stringz(&labels_encoder, "source");
 		cbor_encode_text_stringz(&labels_encoder, metadata->source);
-		cbor_encoder_close_container(&map_encoder, &labels_encoder); // }
+		cbor_encoder_close_container(map_encoder, &labels_encoder); // }
 	}else{
 		SPOTFLOW_DEBUG("Log source is empty, skipping source field in CBOR");
 	}
+}
+
+/**
+ * @brief Close the log message map and check that it fits into the buffer
+ *
+ * @param encoder
+ * @param map_encoder
+ * @param buf
+ * @param out_len
+ * @return 0 on success, -1 if the message does not fit into the buffer
+ */
+static int finish_log_cbor(CborEncoder* encoder, CborEncoder* map_encoder, const uint8_t* buf,
+			   size_t* out_len)
+{
+	cbor_encoder_close_container(encoder, map_encoder); // }
 
-	cbor_encoder_close_container(&array_encoder, &map_encoder); // }
-	// Allocate buffer for JSON string (adjust size as needed)
+	if (cbor_encoder_get_extra_bytes_needed(encoder) > 0) {
+		SPOTFLOW_DEBUG("Log does not fit into the CBOR buffer, dropping");
+		return -1;
+	}
 
-	*out_len = cbor_encoder_get_buffer_size(&array_encoder, buf);
-	return buf;
+	*out_len = cbor_encoder_get_buffer_size(encoder, buf);
+	return 0;
 }
 
 /**
- * @brief Form and send the CBOR parameters
+ * @brief Encode a template value read from the arguments of the log
  *
- * @param buffer
+ * Running out of the buffer is detected when the message is finished.
+ *
+ * @param value
+ * @param ctx Array encoder of the template values
+ * @return 0
  */
-void spotflow_log_cbor_send(const char* fmt, char* buffer, const struct message_metadata* metadata)
+static int encode_template_value(const struct spotflow_template_value* value, void* ctx)
 {
-	size_t len = strlen(buffer);
-	int tmp_log_level = spotflow_cbor_convert_severity_to_log_level(metadata->severity);
-	int tmp_get_sent_log = spotflow_config_get_sent_log_level();
-	if ((tmp_log_level <= tmp_get_sent_log)) {
-		if (len > 0 && len < CONFIG_SPOTFLOW_LOG_BUFFER_SIZE) {
-			uint8_t* clog_cbor = spotflow_log_cbor(fmt, buffer, &len,
-							       metadata); // It reuses the length
-
-			spotflow_queue_push(clog_cbor, len);
-			spotflow_mqtt_notify_action(SPOTFLOW_MQTT_NOTIFY_LOGS);
-			free(clog_cbor);
-		}
+	CborEncoder* array_encoder = ctx;
+
+	switch (value->type) {
+	case SPOTFLOW_TEMPLATE_VALUE_INT:
+		cbor_encode_int(array_encoder, value->int_value);
+		break;
+	case SPOTFLOW_TEMPLATE_VALUE_UINT:
+		cbor_encode_uint(array_encoder, value->uint_value);
+		break;
+	case SPOTFLOW_TEMPLATE_VALUE_DOUBLE:
+		cbor_encode_double(array_encoder, value->double_value);
+		break;
+	case SPOTFLOW_TEMPLATE_VALUE_CHAR:
+		cbor_encode_text_string(array_encoder, &value->char_value, 1);
+		break;
+	case SPOTFLOW_TEMPLATE_VALUE_STRING:
+		cbor_encode_text_stringz(array_encoder, value->string_value);
+		break;
 	}
+
+	return 0;
 }
 
 /**
@@ -3,7 +3,7 @@
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "esp_log.h"
 
@@ -12,39 +12,206 @@
 #include "logging/spotflow_log_cbor.h"
 #include "spotflow.h"
 
-static QueueHandle_t queue_handle = NULL;
+#define QUEUE_SIZE CONFIG_SPOTFLOW_MESSAGE_QUEUE_SIZE
+#define QUEUE_BUFFER_SIZE CONFIG_SPOTFLOW_MESSAGE_QUEUE_BUFFER_SIZE
+#define QUEUE_MESSAGE_MAX_LEN CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN
+#define QUEUE_LEVEL_COUNT (ESP_LOG_VERBOSE + 1)
+
+_Static_assert(CONFIG_SPOTFLOW_MESSAGE_QUEUE_RESERVED_WARN +
+			       CONFIG_SPOTFLOW_MESSAGE_QUEUE_RESERVED_INFO +
+			       CONFIG_SPOTFLOW_MESSAGE_QUEUE_RESERVED_DEBUG <
+		       CONFIG_SPOTFLOW_MESSAGE_QUEUE_SIZE,
+	       "Reserved message queue capacity must be smaller than the queue size");
+_Static_assert(QUEUE_BUFFER_SIZE >= QUEUE_MESSAGE_MAX_LEN,
+	       "Message queue buffer must fit the largest CBOR log message");
+
+/* Messages are kept in a ring ordered from the oldest one */
+static queue_msg_t queue_entries[QUEUE_SIZE];
+static size_t queue_head;
+static size_t queue_count;
+static size_t queue_level_count[QUEUE_LEVEL_COUNT];
+static size_t queue_dropped_count[QUEUE_LEVEL_COUNT];
+static SemaphoreHandle_t queue_mutex = NULL;
+static StaticSemaphore_t queue_mutex_buffer;
+
+/*
+ * Message bytes are stored back to back in the order of the entries, between queue_buffer_start
+ * and queue_buffer_end, so that pushing a message does not allocate.
+ */
+static uint8_t queue_buffer[QUEUE_BUFFER_SIZE];
+static size_t queue_buffer_start;
+static size_t queue_buffer_end;
+
+/* Copy of the message returned by spotflow_queue_read(), valid until the next read */
+static uint8_t queue_read_buffer[QUEUE_MESSAGE_MAX_LEN];
+
+/* Messages of a level within its reserved count are not evicted by more severe messages */
+static const size_t queue_reserved_count[QUEUE_LEVEL_COUNT] = {
+	[ESP_LOG_WARN] = CONFIG_SPOTFLOW_MESSAGE_QUEUE_RESERVED_WARN,
+	[ESP_LOG_INFO] = CONFIG_SPOTFLOW_MESSAGE_QUEUE_RESERVED_INFO,
+	[ESP_LOG_DEBUG] = CONFIG_SPOTFLOW_MESSAGE_QUEUE_RESERVED_DEBUG,
+};
+
 /**
- * @brief To Add a message in Queue
- * 
- * @param msg Log Message 
+ * @brief Find the message to evict to make room for a new one
+ *
+ * The least severe, oldest message is chosen, only among messages at most as severe as the new one
+ * and not protected by the reserved capacity of their level.
+ *
+ * @param level Log level of the new message
+ * @return Position of the message counted from the oldest one,
+ *         -1 if the new message should be dropped
  */
-void spotflow_queue_push(uint8_t* msg, size_t len)
+static int find_eviction_victim(uint8_t level)
+{
+	int victim = -1;
+	uint8_t victim_level = level;
+
+	for (size_t i = 0; i < queue_count; i++) {
+		const queue_msg_t* entry = &queue_entries[(queue_head + i) % QUEUE_SIZE];
+		bool is_reserved = entry->level != level &&
+				   queue_level_count[entry->level] <= queue_reserved_count[entry->level];
+
+		if (entry->level < level || is_reserved) {
+			continue;
+		}
+
+		/* Ties keep the older message, which is found first */
+		if (victim < 0 || entry->level > victim_level) {
+			victim = i;
+			victim_level = entry->level;
+		}
+	}
+
+	return victim;
+}
+
+/**
+ * @brief Remove the message at the given position, moving the newer messages forward
+ *
+ * The bytes of the newer messages are moved to close the gap, so the removed message must be
+ * copied before its pointer is used.
+ *
+ * @param position Position of the message counted from the oldest one
+ * @return Removed message
+ */
+static queue_msg_t remove_entry(size_t position)
+{
+	queue_msg_t removed = queue_entries[(queue_head + position) % QUEUE_SIZE];
+
+	if (position == 0) {
+		queue_head = (queue_head + 1) % QUEUE_SIZE;
+		queue_buffer_start += removed.len;
+	} else {
+		uint8_t* gap_end = removed.ptr + removed.len;
+		memmove(removed.ptr, gap_end, &queue_buffer[queue_buffer_end] - gap_end);
+		queue_buffer_end -= removed.len;
+
+		for (size_t i = position; i + 1 < queue_count; i++) {
+			queue_msg_t* entry = &queue_entries[(queue_head + i) % QUEUE_SIZE];
+			*entry = queue_entries[(queue_head + i + 1) % QUEUE_SIZE];
+			entry->ptr -= removed.len;
+		}
+	}
+
+	queue_count--;
+	queue_level_count[removed.level]--;
+
+	if (queue_count == 0) {
+		queue_buffer_start = 0;
+		queue_buffer_end = 0;
+	}
+
+	return removed;
+}
+
+/**
+ * @brief Move the message bytes to the beginning of the buffer to make room at its end
+ */
+static void compact_buffer(void)
+{
+	size_t used = queue_buffer_end - queue_buffer_start;
+	memmove(queue_buffer, &queue_buffer[queue_buffer_start], used);
+
+	for (size_t i = 0; i < queue_count; i++) {
+		queue_entries[(queue_head + i) % QUEUE_SIZE].ptr -= queue_buffer_start;
+	}
+
+	queue_buffer_start = 0;
+	queue_buffer_end = used;
+}
+
+static bool has_room(size_t len)
 {
-	queue_msg_t qmsg;
-	qmsg.ptr = malloc(len);
-	qmsg.len = len;
+	return queue_count < QUEUE_SIZE &&
+	       queue_buffer_end - queue_buffer_start + len <= QUEUE_BUFFER_SIZE;
+}
 
-	if (!qmsg.ptr) {
-		SPOTFLOW_LOG("Heap allocation failed");
+/**
+ * @brief To Add a message in Queue
+ *
+ * The message is copied into the preallocated queue buffer. When the queue is full, the least
+ * severe, oldest messages are dropped until the new message fits. The new message is dropped
+ * instead if all the queued messages are more severe.
+ *
+ * @param msg Log Message
+ * @param len Length of the message
+ * @param level ESP log level of the message
+ */
+void spotflow_queue_push(uint8_t* msg, size_t len, uint8_t level)
+{
+	if (queue_mutex == NULL) {
+		SPOTFLOW_LOG("Queue not initialized");
 		return;
 	}
 
-	memcpy(qmsg.ptr, msg, len);
-	// Try to enqueue
-	if (xQueueSend(queue_handle, &qmsg, 0) != pdPASS) {
-		// Queue full → drop oldest
-		queue_msg_t dropped;
-		if (xQueueReceive(queue_handle, &dropped, 0) == pdPASS) {
-			SPOTFLOW_LOG("Queue full — dropped oldest message");
-			free(dropped.ptr);
+	if (level > ESP_LOG_VERBOSE) {
+		level = ESP_LOG_VERBOSE;
+	}
+
+	bool enqueued = len <= QUEUE_MESSAGE_MAX_LEN;
+	size_t evicted_count = 0;
+
+	xSemaphoreTake(queue_mutex, portMAX_DELAY);
+
+	while (enqueued && !has_room(len)) {
+		int victim = find_eviction_victim(level);
+		if (victim < 0) {
+			enqueued = false;
+		} else {
+			queue_msg_t evicted = remove_entry(victim);
+			queue_dropped_count[evicted.level]++;
+			evicted_count++;
 		}
+	}
 
-		// Retry enqueue
-		if (xQueueSend(queue_handle, &qmsg, 0) != pdPASS) {
-			SPOTFLOW_LOG("Queue send failed even after drop");
-			free(qmsg.ptr);
-			return;
+	if (enqueued) {
+		if (queue_buffer_end + len > QUEUE_BUFFER_SIZE) {
+			compact_buffer();
 		}
+
+		queue_msg_t* entry = &queue_entries[(queue_head + queue_count) % QUEUE_SIZE];
+		entry->ptr = &queue_buffer[queue_buffer_end];
+		entry->len = len;
+		entry->level = level;
+		memcpy(entry->ptr, msg, len);
+
+		queue_buffer_end += len;
+		queue_count++;
+		queue_level_count[level]++;
+	} else {
+		queue_dropped_count[level]++;
+	}
+
+	xSemaphoreGive(queue_mutex);
+
+	if (evicted_count > 0) {
+		SPOTFLOW_LOG("Queue full — dropped %u older messages", (unsigned)evicted_count);
+	}
+
+	if (!enqueued) {
+		SPOTFLOW_LOG("Queue full — dropped new message");
+		return;
 	}
 
 	SPOTFLOW_LOG("Message Added.\n");
@@ -52,44 +219,84 @@ void spotflow_queue_push(uint8_t* msg, size_t len)
 
 /**
  * @brief Read next message from queue (non-blocking)
- * 
+ *
+ * The message is copied out of the queue, its data stay valid until the next read.
+ *
  * @param out Pointer to structure receiving ptr+len
  * @return true if a message was read, false if queue empty
  */
 
 bool spotflow_queue_read(queue_msg_t* out)
 {
-	if (queue_handle == NULL || out == NULL) {
-       return false;
-    }
-	
-	if (xQueueReceive(queue_handle, out, 0) == pdPASS)
-		return true;
-	return false;
+	if (queue_mutex == NULL || out == NULL) {
+		return false;
+	}
+
+	bool has_message = false;
+
+	xSemaphoreTake(queue_mutex, portMAX_DELAY);
+	if (queue_count > 0) {
+		const queue_msg_t* oldest = &queue_entries[queue_head];
+		memcpy(queue_read_buffer, oldest->ptr, oldest->len);
+
+		*out = remove_entry(0);
+		out->ptr = queue_read_buffer;
+		has_message = true;
+	}
+	xSemaphoreGive(queue_mutex);
+
+	return has_message;
 }
 
 /**
- * @brief Free the queue message buffer
- * 
- * @param msg 
+ * @brief Release the message returned by spotflow_queue_read
+ *
+ * @param msg
  */
 void spotflow_queue_free(queue_msg_t* msg)
 {
-	if (msg && msg->ptr) {
-		free(msg->ptr);
+	if (msg) {
 		msg->ptr = NULL;
 		msg->len = 0;
 	}
 }
 
+/**
+ * @brief Get the number of log messages dropped because the queue was full
+ *
+ * @param level ESP log level of the dropped messages
+ * @return size_t
+ */
+size_t spotflow_queue_get_dropped_count(uint8_t level)
+{
+	if (level >= QUEUE_LEVEL_COUNT) {
+		return 0;
+	}
+
+	return queue_dropped_count[level];
+}
+
 /**
  * @brief Initialize the Queue to save the messgaes
- * 
+ *
+ * Messages remaining from a previous initialization are dropped.
  */
 void spotflow_queue_init(void)
 {
-	queue_handle = xQueueCreate(CONFIG_SPOTFLOW_MESSAGE_QUEUE_SIZE, sizeof(queue_msg_t));
-	if (queue_handle == NULL) {
-		SPOTFLOW_LOG("Failed to create queue");
+	if (queue_mutex == NULL) {
+		queue_mutex = xSemaphoreCreateMutexStatic(&queue_mutex_buffer);
+		if (queue_mutex == NULL) {
+			SPOTFLOW_LOG("Failed to create queue");
+			return;
+		}
 	}
+
+	xSemaphoreTake(queue_mutex, portMAX_DELAY);
+	queue_head = 0;
+	queue_count = 0;
+	queue_buffer_start = 0;
+	queue_buffer_end = 0;
+	memset(queue_level_count, 0, sizeof(queue_level_count));
+	memset(queue_dropped_count, 0, sizeof(queue_dropped_count));
+	xSemaphoreGive(queue_mutex);
 }
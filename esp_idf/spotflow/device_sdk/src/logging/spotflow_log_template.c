@@ -0,0 +1 @@
+../../../../../common/logging/spotflow_log_template.c
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../common/logging/spotflow_log_template.h
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "net/spotflow_mqtt.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "esp_timer.h"
 #include "esp_random.h"
 #include <string.h>
@@ -12,9 +13,22 @@
 #include <float.h>
 #include <errno.h>
 
+/* FNV-1a */
+#define LABELS_HASH_OFFSET_BASIS 2166136261U
+#define LABELS_HASH_PRIME 16777619U
+
+#define TIMESERIES_INDEX_EMPTY 0
+
+/* Window ends are shifted by up to 10% of the shortest aggregation interval */
+#define WINDOW_PHASE_MAX_MS 6000
+
 /* Forward declarations */
-static bool labels_equal(const struct metric_timeseries_state* ts,
+static uint32_t hash_label_string(uint32_t hash, const char* str, size_t max_len);
+static bool labels_equal(const struct metric_timeseries_labels* stored,
 			 const struct spotflow_label* labels, uint8_t label_count);
+static int update_timeseries(struct metric_aggregator_context* ctx,
+			     struct metric_timeseries_state* ts, int64_t value_int,
+			     float value_float);
 static void update_aggregation_int(struct metric_timeseries_state* ts, int64_t value);
 static void update_aggregation_float(struct metric_timeseries_state* ts, float value);
 static void reset_timeseries_state(struct spotflow_metric_base* metric,
@@ -25,14 +39,41 @@ static int flush_no_aggregation_metric(struct spotflow_metric_base* metric,
 				       const struct spotflow_label* labels, uint8_t label_count,
 				       int64_t value_int, float value_float);
 static int flush_timeseries(struct spotflow_metric_base* metric, struct metric_timeseries_state* ts,
-			    int64_t timestamp_ms);
-static int copy_labels_to_timeseries(struct metric_timeseries_state* ts,
-				     const struct spotflow_label* labels, uint8_t label_count);
+			    const struct metric_timeseries_labels* labels, int64_t timestamp_ms);
+static void copy_labels_to_timeseries(struct metric_timeseries_labels* stored,
+				      const struct spotflow_label* labels, uint8_t label_count);
+static int create_aggregation_timer(void);
+static void start_aggregation_timer(struct metric_aggregator_context* ctx);
+static void insert_scheduled(struct metric_aggregator_context* ctx);
+static void reschedule_aggregation_timer(void);
+static void close_aggregation_window(struct metric_aggregator_context* ctx, int64_t timestamp_ms);
 static void aggregation_timer_callback(void* arg);
 static uint32_t get_interval_ms(enum spotflow_agg_interval interval);
 static struct metric_timeseries_state*
 find_or_create_timeseries(struct metric_aggregator_context* ctx,
-			  const struct spotflow_label* labels, uint8_t label_count);
+			  const struct spotflow_label* labels, uint8_t label_count,
+			  uint32_t labels_hash);
+static struct metric_timeseries_state* find_timeseries(struct metric_aggregator_context* ctx,
+						       const struct spotflow_label* labels,
+						       uint8_t label_count, uint32_t labels_hash,
+						       uint16_t* empty_pos);
+static uint16_t find_empty_index_pos(const struct metric_aggregator_context* ctx,
+				     uint32_t labels_hash);
+static void remove_from_index(struct metric_aggregator_context* ctx, uint16_t slot);
+static void remove_scheduled(struct metric_aggregator_context* ctx);
+
+/* One timer closes the windows of all aggregated metrics with a started window, which wait for
+ * it in a list sorted by the window end. The list is guarded by g_schedule_lock.
+ */
+static esp_timer_handle_t g_aggregation_timer;
+static SemaphoreHandle_t g_schedule_lock;
+static struct metric_aggregator_context* g_scheduled_head;
+
+/* Metric whose window the timer callback is closing outside g_schedule_lock */
+static struct metric_aggregator_context* g_closing_ctx;
+
+/* Device-wide offset of the window ends, spreads the windows of devices booted together */
+static uint32_t g_window_phase_ms;
 
 /**
  * @brief Register a metric with the aggregator
@@ -53,21 +94,53 @@ int aggregator_register_metric(struct spotflow_metric_base* metric)
 		return -ENOMEM;
 	}
 
+	/* Label-less metrics have a single time series, they need no labels or index */
+	ctx->labels = NULL;
+	ctx->index = NULL;
+	ctx->index_mask = 0;
+	if (metric->max_labels > 0) {
+		/* Label sets are read only on hash matches and encoding, they are kept apart from
+		 * the aggregation state
+		 */
+		ctx->labels =
+		    calloc(metric->max_timeseries, sizeof(struct metric_timeseries_labels));
+		if (!ctx->labels) {
+			free(ctx->timeseries);
+			free(ctx);
+			return -ENOMEM;
+		}
+
+		/* Load factor at most 1/2 keeps the expected probe count low */
+		size_t index_capacity = 2;
+		while (index_capacity < 2U * metric->max_timeseries) {
+			index_capacity <<= 1;
+		}
+		ctx->index = calloc(index_capacity, sizeof(uint16_t));
+		if (!ctx->index) {
+			free(ctx->labels);
+			free(ctx->timeseries);
+			free(ctx);
+			return -ENOMEM;
+		}
+		ctx->index_mask = index_capacity - 1;
+	}
+
 	ctx->metric = metric;
 	ctx->timeseries_count = 0;
 	ctx->timeseries_capacity = metric->max_timeseries;
 	ctx->timer_started = false;
-
-	if (metric->agg_interval != SPOTFLOW_AGG_INTERVAL_NONE) {
-		esp_timer_create_args_t timer_args = { .callback = aggregation_timer_callback,
-						       .arg = ctx,
-						       .name = "aggregation_timer" };
-		esp_err_t err = esp_timer_create(&timer_args, &ctx->aggregation_timer);
-		if (err != ESP_OK) {
-			SPOTFLOW_LOG("Failed to create aggregation timer: %d", err);
+	ctx->next_scheduled = NULL;
+	ctx->window_end_ms = 0;
+
+	/* Registrations are serialized by the registry lock */
+	if (metric->agg_interval != SPOTFLOW_AGG_INTERVAL_NONE && g_aggregation_timer == NULL) {
+		int rc = create_aggregation_timer();
+		if (rc < 0) {
+			free(ctx->index);
+			free(ctx->labels);
 			free(ctx->timeseries);
 			free(ctx);
-			return -ENOMEM;
+			return rc;
 		}
 	}
 
@@ -78,9 +151,64 @@ int aggregator_register_metric(struct spotflow_metric_base* metric)
 	return 0;
 }
 
+void aggregator_unregister_metric(struct spotflow_metric_base* metric)
+{
+	struct metric_aggregator_context* ctx = metric->aggregator_context;
+	if (!ctx) {
+		return;
+	}
+
+	if (g_schedule_lock) {
+		/* Wait until the timer callback is done with the window it may be closing */
+		for (;;) {
+			xSemaphoreTake(g_schedule_lock, portMAX_DELAY);
+			if (g_closing_ctx != ctx) {
+				break;
+			}
+			xSemaphoreGive(g_schedule_lock);
+			vTaskDelay(1);
+		}
+
+		bool was_head = g_scheduled_head == ctx;
+		remove_scheduled(ctx);
+		if (was_head)
+			reschedule_aggregation_timer();
+		xSemaphoreGive(g_schedule_lock);
+	}
+
+	metric->aggregator_context = NULL;
+	free(ctx->index);
+	free(ctx->labels);
+	free(ctx->timeseries);
+	free(ctx);
+	SPOTFLOW_DEBUG("Unregistered aggregator for metric '%s'", metric->name);
+}
+
+int aggregator_flush_metric(struct spotflow_metric_base* metric)
+{
+	if (!metric || !metric->aggregator_context ||
+	    metric->agg_interval == SPOTFLOW_AGG_INTERVAL_NONE) {
+		return -EINVAL;
+	}
+
+	close_aggregation_window(metric->aggregator_context, esp_timer_get_time() / 1000ULL);
+	return 0;
+}
+
+uint32_t aggregator_hash_labels(const struct spotflow_label* labels, uint8_t label_count)
+{
+	uint32_t hash = LABELS_HASH_OFFSET_BASIS;
+
+	for (uint8_t i = 0; i < label_count; i++) {
+		hash = hash_label_string(hash, labels[i].key, SPOTFLOW_MAX_LABEL_KEY_LEN - 1);
+		hash = hash_label_string(hash, labels[i].value, SPOTFLOW_MAX_LABEL_VALUE_LEN - 1);
+	}
+	return hash;
+}
+
 int aggregator_report_value(struct spotflow_metric_base* metric,
 			    const struct spotflow_label* labels, uint8_t label_count,
-			    int64_t value_int, float value_float)
+			    uint32_t labels_hash, int64_t value_int, float value_float)
 {
 	if (!metric || !metric->aggregator_context) {
 		return -EINVAL;
@@ -99,7 +227,8 @@ int aggregator_report_value(struct spotflow_metric_base* metric,
 		return rc;
 	}
 
-	struct metric_timeseries_state* ts = find_or_create_timeseries(ctx, labels, label_count);
+	struct metric_timeseries_state* ts =
+	    find_or_create_timeseries(ctx, labels, label_count, labels_hash);
 
 	if (!ts) {
 		SPOTFLOW_LOG("Time series pool full for metric '%s' (%u/%u)", metric->name,
@@ -108,59 +237,134 @@ int aggregator_report_value(struct spotflow_metric_base* metric,
 		return -ENOSPC;
 	}
 
+	int rc = update_timeseries(ctx, ts, value_int, value_float);
+	xSemaphoreGive(metric->lock);
+	return rc;
+}
+
+int aggregator_bind_timeseries(struct spotflow_metric_base* metric,
+			       const struct spotflow_label* labels, uint8_t label_count,
+			       uint32_t labels_hash, struct metric_timeseries_state** ts_out)
+{
+	if (!metric || !metric->aggregator_context || metric->max_labels == 0) {
+		return -EINVAL;
+	}
+
+	struct metric_aggregator_context* ctx = metric->aggregator_context;
+
+	if (xSemaphoreTake(metric->lock, portMAX_DELAY) != pdTRUE) {
+		return -EINVAL;
+	}
+
+	/* Non-aggregated metrics use the time series only to keep the bound labels */
+	struct metric_timeseries_state* ts =
+	    find_or_create_timeseries(ctx, labels, label_count, labels_hash);
+	if (ts)
+		ts->bound = true;
+
+	xSemaphoreGive(metric->lock);
+
+	if (!ts) {
+		SPOTFLOW_LOG("Time series pool full for metric '%s', cannot bind labels",
+			     metric->name);
+		return -ENOSPC;
+	}
+
+	*ts_out = ts;
+	return 0;
+}
+
+int aggregator_report_bound_value(struct spotflow_metric_base* metric,
+				  struct metric_timeseries_state* ts, int64_t value_int,
+				  float value_float)
+{
+	struct metric_aggregator_context* ctx = metric->aggregator_context;
+	int rc;
+
+	if (xSemaphoreTake(metric->lock, portMAX_DELAY) != pdTRUE) {
+		return -EINVAL;
+	}
+
+	if (metric->agg_interval == SPOTFLOW_AGG_INTERVAL_NONE) {
+		/* Bound time series are always labeled */
+		const struct metric_timeseries_labels* stored = &ctx->labels[ts - ctx->timeseries];
+		struct spotflow_label labels[CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC];
+		for (uint8_t i = 0; i < stored->label_count; i++) {
+			labels[i].key = stored->labels[i].key;
+			labels[i].value = stored->labels[i].value;
+		}
+		rc = flush_no_aggregation_metric(metric, labels, stored->label_count, value_int,
+						 value_float);
+	} else {
+		rc = update_timeseries(ctx, ts, value_int, value_float);
+	}
+
+	xSemaphoreGive(metric->lock);
+	return rc;
+}
+
+/* Aggregates the value and starts the aggregation timer, called with metric->lock held */
+static int update_timeseries(struct metric_aggregator_context* ctx,
+			     struct metric_timeseries_state* ts, int64_t value_int,
+			     float value_float)
+{
+	struct spotflow_metric_base* metric = ctx->metric;
+
 	if (metric->type == SPOTFLOW_METRIC_TYPE_INT) {
 		update_aggregation_int(ts, value_int);
 	} else if (metric->type == SPOTFLOW_METRIC_TYPE_FLOAT) {
 		update_aggregation_float(ts, value_float);
 	} else {
-		xSemaphoreGive(metric->lock);
 		SPOTFLOW_LOG("Invalid metric type: %d", metric->type);
 		return -EINVAL;
 	}
 
 	if (!ctx->timer_started) {
-		uint32_t interval_ms = get_interval_ms(metric->agg_interval);
-		if (interval_ms > 0) {
-			uint32_t jitter = esp_random() % (interval_ms / 10);
-			ESP_ERROR_CHECK(esp_timer_start_once(ctx->aggregation_timer,
-							     (interval_ms - jitter) * 1000ULL));
-			ctx->timer_started = true;
-		}
+		start_aggregation_timer(ctx);
+		ctx->timer_started = true;
 	}
 
-	xSemaphoreGive(metric->lock);
 	return 0;
 }
 
-static bool labels_equal(const struct metric_timeseries_state* ts,
+/* Hashes a label string up to its stored length, the terminator separates the strings */
+static uint32_t hash_label_string(uint32_t hash, const char* str, size_t max_len)
+{
+	for (size_t i = 0; i < max_len && str[i] != '\0'; i++) {
+		hash = (hash ^ (uint8_t)str[i]) * LABELS_HASH_PRIME;
+	}
+	return hash * LABELS_HASH_PRIME;
+}
+
+/* Reported labels are compared as they are stored, i.e. truncated */
+static bool labels_equal(const struct metric_timeseries_labels* stored,
 			 const struct spotflow_label* labels, uint8_t label_count)
 {
-	if (ts->label_count != label_count)
+	if (stored->label_count != label_count)
 		return false;
 
 	for (uint8_t i = 0; i < label_count; i++) {
-		if (strcmp(ts->labels[i].key, labels[i].key) != 0 ||
-		    strcmp(ts->labels[i].value, labels[i].value) != 0) {
+		if (strncmp(stored->labels[i].key, labels[i].key,
+			    SPOTFLOW_MAX_LABEL_KEY_LEN - 1) != 0 ||
+		    strncmp(stored->labels[i].value, labels[i].value,
+			    SPOTFLOW_MAX_LABEL_VALUE_LEN - 1) != 0) {
 			return false;
 		}
 	}
 	return true;
 }
 
-static int copy_labels_to_timeseries(struct metric_timeseries_state* ts,
-				     const struct spotflow_label* labels, uint8_t label_count)
+/* Labels were validated by the caller of aggregator_report_value() */
+static void copy_labels_to_timeseries(struct metric_timeseries_labels* stored,
+				      const struct spotflow_label* labels, uint8_t label_count)
 {
+	stored->label_count = label_count;
 	for (uint8_t i = 0; i < label_count; i++) {
-		if (!labels[i].key || !labels[i].value) {
-			SPOTFLOW_LOG("Label key or value NULL at index %u", i);
-			return -1;
-		}
-		strncpy(ts->labels[i].key, labels[i].key, SPOTFLOW_MAX_LABEL_KEY_LEN - 1);
-		ts->labels[i].key[SPOTFLOW_MAX_LABEL_KEY_LEN - 1] = '\0';
-		strncpy(ts->labels[i].value, labels[i].value, SPOTFLOW_MAX_LABEL_VALUE_LEN - 1);
-		ts->labels[i].value[SPOTFLOW_MAX_LABEL_VALUE_LEN - 1] = '\0';
+		strncpy(stored->labels[i].key, labels[i].key, SPOTFLOW_MAX_LABEL_KEY_LEN - 1);
+		stored->labels[i].key[SPOTFLOW_MAX_LABEL_KEY_LEN - 1] = '\0';
+		strncpy(stored->labels[i].value, labels[i].value, SPOTFLOW_MAX_LABEL_VALUE_LEN - 1);
+		stored->labels[i].value[SPOTFLOW_MAX_LABEL_VALUE_LEN - 1] = '\0';
 	}
-	return 0;
 }
 
 static void update_aggregation_int(struct metric_timeseries_state* ts, int64_t value)
@@ -236,49 +440,115 @@ static uint32_t get_interval_ms(enum spotflow_agg_interval interval)
 	}
 }
 
+/**
+ * @brief Find or create time series slot
+ *
+ * Time series are looked up in the hash index by the hash of their label set. Slots are taken
+ * in order and never released, so the first free slot is the one after the active ones.
+ * When the pool is full, the first idle time series (count == 0) that is not bound to a handle
+ * is evicted, only this rare case scans all slots.
+ */
 static struct metric_timeseries_state*
 find_or_create_timeseries(struct metric_aggregator_context* ctx,
-			  const struct spotflow_label* labels, uint8_t label_count)
+			  const struct spotflow_label* labels, uint8_t label_count,
+			  uint32_t labels_hash)
 {
-	struct metric_timeseries_state* inactive_slot = NULL;
-	struct metric_timeseries_state* evictable_slot = NULL;
-
-	for (uint16_t i = 0; i < ctx->timeseries_capacity; i++) {
-		struct metric_timeseries_state* ts = &ctx->timeseries[i];
-
-		if (ts->active) {
-			if (labels_equal(ts, labels, label_count))
-				return ts;
-			if (ts->count == 0 && evictable_slot == NULL)
-				evictable_slot = ts;
-		} else if (!inactive_slot) {
-			inactive_slot = ts;
+	struct metric_timeseries_state* ts;
+
+	if (!ctx->index) {
+		/* Label-less metric, its only time series is created on the first report */
+		ts = &ctx->timeseries[0];
+		if (ts->active)
+			return ts;
+		ctx->timeseries_count = 1;
+	} else {
+		uint16_t index_pos;
+		ts = find_timeseries(ctx, labels, label_count, labels_hash, &index_pos);
+		if (ts)
+			return ts;
+
+		uint16_t slot;
+		if (ctx->timeseries_count < ctx->timeseries_capacity) {
+			slot = ctx->timeseries_count++;
+		} else {
+			for (slot = 0; slot < ctx->timeseries_capacity; slot++) {
+				if (ctx->timeseries[slot].count == 0 && !ctx->timeseries[slot].bound)
+					break;
+			}
+			if (slot == ctx->timeseries_capacity)
+				return NULL;
+
+			SPOTFLOW_DEBUG("Evicting idle timeseries for metric '%s'", ctx->metric->name);
+			remove_from_index(ctx, slot);
+			/* Removal can move other entries into the probe sequence of the new one */
+			index_pos = find_empty_index_pos(ctx, labels_hash);
 		}
-	}
-
-	struct metric_timeseries_state* ts = inactive_slot ? inactive_slot : evictable_slot;
-	if (!ts)
-		return NULL;
 
-	if (!inactive_slot) {
-		SPOTFLOW_DEBUG("Evicting idle timeseries for metric '%s'", ctx->metric->name);
-	} else {
-		ctx->timeseries_count++;
+		ctx->index[index_pos] = slot + 1;
+		ts = &ctx->timeseries[slot];
+		copy_labels_to_timeseries(&ctx->labels[slot], labels, label_count);
 	}
 
 	memset(ts, 0, sizeof(*ts));
 	ts->active = true;
-	ts->label_count = label_count;
-	if (copy_labels_to_timeseries(ts, labels, label_count) < 0) {
-		ts->active = false;
-		return NULL;
-	}
+	ts->labels_hash = labels_hash;
 
 	init_timeseries_aggregation_state(ts, ctx->metric->type);
 	SPOTFLOW_DEBUG("Initialized timeseries for metric '%s'", ctx->metric->name);
 	return ts;
 }
 
+/* Sets empty_pos to the index position for inserting the time series if it is not found */
+static struct metric_timeseries_state* find_timeseries(struct metric_aggregator_context* ctx,
+						       const struct spotflow_label* labels,
+						       uint8_t label_count, uint32_t labels_hash,
+						       uint16_t* empty_pos)
+{
+	/* Index is never full, so the probe sequence always ends with an empty entry */
+	for (uint16_t pos = labels_hash & ctx->index_mask;; pos = (pos + 1) & ctx->index_mask) {
+		uint16_t entry = ctx->index[pos];
+		if (entry == TIMESERIES_INDEX_EMPTY) {
+			*empty_pos = pos;
+			return NULL;
+		}
+
+		/* Label set is read only when the hash of the hot state matches */
+		struct metric_timeseries_state* ts = &ctx->timeseries[entry - 1];
+		if (ts->labels_hash == labels_hash &&
+		    labels_equal(&ctx->labels[entry - 1], labels, label_count))
+			return ts;
+	}
+}
+
+static uint16_t find_empty_index_pos(const struct metric_aggregator_context* ctx,
+				     uint32_t labels_hash)
+{
+	uint16_t pos = labels_hash & ctx->index_mask;
+	while (ctx->index[pos] != TIMESERIES_INDEX_EMPTY)
+		pos = (pos + 1) & ctx->index_mask;
+	return pos;
+}
+
+/* Following entries of the probe sequence are shifted back to the gap, so no tombstones */
+static void remove_from_index(struct metric_aggregator_context* ctx, uint16_t slot)
+{
+	uint16_t mask = ctx->index_mask;
+	uint16_t hole = ctx->timeseries[slot].labels_hash & mask;
+	while (ctx->index[hole] != slot + 1)
+		hole = (hole + 1) & mask;
+
+	for (uint16_t pos = (hole + 1) & mask; ctx->index[pos] != TIMESERIES_INDEX_EMPTY;
+	     pos = (pos + 1) & mask) {
+		uint16_t home = ctx->timeseries[ctx->index[pos] - 1].labels_hash & mask;
+		/* Entry can move to the hole only if the hole is not before its home position */
+		if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+			ctx->index[hole] = ctx->index[pos];
+			hole = pos;
+		}
+	}
+	ctx->index[hole] = TIMESERIES_INDEX_EMPTY;
+}
+
 static int flush_no_aggregation_metric(struct spotflow_metric_base* metric,
 				       const struct spotflow_label* labels, uint8_t label_count,
 				       int64_t value_int, float value_float)
@@ -301,13 +571,13 @@ static int flush_no_aggregation_metric(struct spotflow_metric_base* metric,
 }
 
 static int flush_timeseries(struct spotflow_metric_base* metric, struct metric_timeseries_state* ts,
-			    int64_t timestamp_ms)
+			    const struct metric_timeseries_labels* labels, int64_t timestamp_ms)
 {
 	uint8_t* cbor_data = NULL;
 	size_t cbor_len = 0;
 	uint64_t seq_num = metric->sequence_number++;
 
-	int rc = spotflow_metrics_cbor_encode_aggregated(metric, ts, timestamp_ms, seq_num,
+	int rc = spotflow_metrics_cbor_encode_aggregated(metric, ts, labels, timestamp_ms, seq_num,
 							 &cbor_data, &cbor_len);
 	if (rc < 0) {
 		free(cbor_data);
@@ -324,11 +594,97 @@ static int flush_timeseries(struct spotflow_metric_base* metric, struct metric_t
 	return rc;
 }
 
-static void aggregation_timer_callback(void* arg)
+/* Creates the timer shared by all aggregated metrics, called on the first registration */
+static int create_aggregation_timer(void)
+{
+	g_schedule_lock = xSemaphoreCreateMutex();
+	if (!g_schedule_lock) {
+		return -ENOMEM;
+	}
+
+	esp_timer_create_args_t timer_args = { .callback = aggregation_timer_callback,
+					       .name = "aggregation_timer" };
+	esp_err_t err = esp_timer_create(&timer_args, &g_aggregation_timer);
+	if (err != ESP_OK) {
+		SPOTFLOW_LOG("Failed to create aggregation timer: %d", err);
+		vSemaphoreDelete(g_schedule_lock);
+		g_schedule_lock = NULL;
+		g_aggregation_timer = NULL;
+		return -ENOMEM;
+	}
+
+	g_window_phase_ms = esp_random() % WINDOW_PHASE_MAX_MS;
+	return 0;
+}
+
+/*
+ * Schedules the end of the first window. Windows end at multiples of the interval (shifted by the
+ * device-wide phase), so the windows of metrics with the same interval are closed together and
+ * the first window is shorter. The intervals are multiples of each other, so the windows of
+ * longer intervals end together with the shorter ones.
+ */
+static void start_aggregation_timer(struct metric_aggregator_context* ctx)
+{
+	uint32_t interval_ms = get_interval_ms(ctx->metric->agg_interval);
+	int64_t now_ms = esp_timer_get_time() / 1000;
+
+	/* The phase is shorter than any interval, so the dividend is never negative */
+	int64_t window_index = (now_ms + interval_ms - g_window_phase_ms) / interval_ms;
+
+	xSemaphoreTake(g_schedule_lock, portMAX_DELAY);
+
+	ctx->window_end_ms = window_index * interval_ms + g_window_phase_ms;
+	insert_scheduled(ctx);
+	if (g_scheduled_head == ctx)
+		reschedule_aggregation_timer();
+
+	xSemaphoreGive(g_schedule_lock);
+}
+
+/* Inserts the metric into the scheduler list by its window end, called with g_schedule_lock held */
+static void insert_scheduled(struct metric_aggregator_context* ctx)
+{
+	struct metric_aggregator_context** link = &g_scheduled_head;
+
+	/* Metrics with the same window end stay in the order they were scheduled */
+	while (*link != NULL && (*link)->window_end_ms <= ctx->window_end_ms)
+		link = &(*link)->next_scheduled;
+
+	ctx->next_scheduled = *link;
+	*link = ctx;
+}
+
+/* Removes the metric from the scheduler list if it is there, called with g_schedule_lock held */
+static void remove_scheduled(struct metric_aggregator_context* ctx)
+{
+	struct metric_aggregator_context** link = &g_scheduled_head;
+
+	while (*link != NULL && *link != ctx)
+		link = &(*link)->next_scheduled;
+
+	if (*link == ctx)
+		*link = ctx->next_scheduled;
+	ctx->next_scheduled = NULL;
+}
+
+/* Starts the timer to the earliest window end, called with g_schedule_lock held */
+static void reschedule_aggregation_timer(void)
+{
+	if (g_scheduled_head == NULL)
+		return;
+
+	int64_t delay_ms = g_scheduled_head->window_end_ms - esp_timer_get_time() / 1000;
+
+	/* Fails if the timer is not running, e.g. when called from its callback */
+	esp_timer_stop(g_aggregation_timer);
+	ESP_ERROR_CHECK(esp_timer_start_once(g_aggregation_timer,
+					     (delay_ms > 0 ? delay_ms : 0) * 1000ULL));
+}
+
+/* Flushes all time series with values in the closed window */
+static void close_aggregation_window(struct metric_aggregator_context* ctx, int64_t timestamp_ms)
 {
-	struct metric_aggregator_context* ctx = (struct metric_aggregator_context*)arg;
 	struct spotflow_metric_base* metric = ctx->metric;
-	int64_t timestamp_ms = esp_timer_get_time() / 1000ULL;
 
 	if (xSemaphoreTake(metric->lock, portMAX_DELAY) != pdTRUE) {
 		SPOTFLOW_DEBUG("Aggregation window closed for metric.");
@@ -338,17 +694,50 @@ static void aggregation_timer_callback(void* arg)
 	for (uint16_t i = 0; i < ctx->timeseries_capacity; i++) {
 		struct metric_timeseries_state* ts = &ctx->timeseries[i];
 		if (ts->active && ts->count > 0) {
-			int rc = flush_timeseries(metric, ts, timestamp_ms);
+			const struct metric_timeseries_labels* labels =
+			    ctx->labels ? &ctx->labels[i] : NULL;
+			int rc = flush_timeseries(metric, ts, labels, timestamp_ms);
 			if (rc < 0)
 				SPOTFLOW_LOG("Failed to flush timeseries for metric '%s': %d",
 					     metric->name, rc);
 		}
 	}
 
-	uint32_t interval_ms = get_interval_ms(metric->agg_interval);
-	if (interval_ms > 0)
-		ESP_ERROR_CHECK(
-		    esp_timer_start_once(ctx->aggregation_timer, interval_ms * 1000ULL));
-
 	xSemaphoreGive(metric->lock);
 }
+
+/* Closes the windows of all metrics that ended in one pass with one timestamp */
+static void aggregation_timer_callback(void* arg)
+{
+	int64_t timestamp_ms = esp_timer_get_time() / 1000ULL;
+
+	for (;;) {
+		xSemaphoreTake(g_schedule_lock, portMAX_DELAY);
+
+		struct metric_aggregator_context* ctx = g_scheduled_head;
+		if (ctx == NULL || ctx->window_end_ms > timestamp_ms) {
+			xSemaphoreGive(g_schedule_lock);
+			break;
+		}
+
+		/* Move to the next window, skipping the windows missed by a delayed callback */
+		uint32_t interval_ms = get_interval_ms(ctx->metric->agg_interval);
+		g_scheduled_head = ctx->next_scheduled;
+		ctx->window_end_ms +=
+		    ((timestamp_ms - ctx->window_end_ms) / interval_ms + 1) * interval_ms;
+		insert_scheduled(ctx);
+		g_closing_ctx = ctx;
+
+		xSemaphoreGive(g_schedule_lock);
+
+		close_aggregation_window(ctx, timestamp_ms);
+
+		xSemaphoreTake(g_schedule_lock, portMAX_DELAY);
+		g_closing_ctx = NULL;
+		xSemaphoreGive(g_schedule_lock);
+	}
+
+	xSemaphoreTake(g_schedule_lock, portMAX_DELAY);
+	reschedule_aggregation_timer();
+	xSemaphoreGive(g_schedule_lock);
+}
@@ -4,7 +4,11 @@
 #include <string.h>
 
 static int validate_labels(const struct spotflow_metric_base* base,
-			   const struct spotflow_label* labels, uint8_t label_count);
+			   const struct spotflow_label* labels, uint8_t label_count,
+			   uint32_t* labels_hash);
+static int bind_labels(struct spotflow_metric_base* base, const struct spotflow_label* labels,
+		       uint8_t label_count, struct spotflow_metric_base** metric_out,
+		       struct metric_timeseries_state** ts_out);
 
 int spotflow_report_metric_int(struct spotflow_metric_int* metric, int64_t value)
 {
@@ -21,7 +25,7 @@ int spotflow_report_metric_int(struct spotflow_metric_int* metric, int64_t value
 	}
 
 	/* Type-safe: int metrics always store int values */
-	return aggregator_report_value(base, NULL, 0, value, 0.0);
+	return aggregator_report_value(base, NULL, 0, 0, value, 0.0);
 }
 
 int spotflow_report_metric_float(struct spotflow_metric_float* metric, float value)
@@ -39,7 +43,7 @@ int spotflow_report_metric_float(struct spotflow_metric_float* metric, float val
 	}
 
 	/* Type-safe: float metrics always store float values */
-	return aggregator_report_value(base, NULL, 0, 0, value);
+	return aggregator_report_value(base, NULL, 0, 0, 0, value);
 }
 
 int spotflow_report_metric_int_with_labels(struct spotflow_metric_int* metric, int64_t value,
@@ -57,13 +61,14 @@ int spotflow_report_metric_int_with_labels(struct spotflow_metric_int* metric, i
 		return -EINVAL;
 	}
 
-	int err = validate_labels(base, labels, label_count);
+	uint32_t labels_hash;
+	int err = validate_labels(base, labels, label_count, &labels_hash);
 	if (err) {
 		return err;
 	}
 
 	/* Type-safe: int metrics always store int values */
-	return aggregator_report_value(base, labels, label_count, value, 0.0);
+	return aggregator_report_value(base, labels, label_count, labels_hash, value, 0.0);
 }
 
 int spotflow_report_metric_float_with_labels(struct spotflow_metric_float* metric, float value,
@@ -82,13 +87,14 @@ int spotflow_report_metric_float_with_labels(struct spotflow_metric_float* metri
 		return -EINVAL;
 	}
 
-	int err = validate_labels(base, labels, label_count);
+	uint32_t labels_hash;
+	int err = validate_labels(base, labels, label_count, &labels_hash);
 	if (err) {
 		return err;
 	}
 
 	/* Type-safe: float metrics always store float values */
-	return aggregator_report_value(base, labels, label_count, 0, value);
+	return aggregator_report_value(base, labels, label_count, labels_hash, 0, value);
 }
 
 int spotflow_report_event(struct spotflow_metric_int* metric)
@@ -106,7 +112,7 @@ int spotflow_report_event(struct spotflow_metric_int* metric)
 	}
 
 	/* Events report value of 1 (event occurred) */
-	return aggregator_report_value(base, NULL, 0, 1, 0.0);
+	return aggregator_report_value(base, NULL, 0, 0, 1, 0.0);
 }
 
 int spotflow_report_event_with_labels(struct spotflow_metric_int* metric,
@@ -124,25 +130,80 @@ int spotflow_report_event_with_labels(struct spotflow_metric_int* metric,
 		return -EINVAL;
 	}
 
-	int err = validate_labels(base, labels, label_count);
+	uint32_t labels_hash;
+	int err = validate_labels(base, labels, label_count, &labels_hash);
 	if (err) {
 		return err;
 	}
 
 	/* Events report value of 1 (event occurred) */
-	return aggregator_report_value(base, labels, label_count, 1, 0.0);
+	return aggregator_report_value(base, labels, label_count, labels_hash, 1, 0.0);
+}
+
+int spotflow_metric_bind_labels_int(struct spotflow_metric_int* metric,
+				    const struct spotflow_label* labels, uint8_t label_count,
+				    struct spotflow_bound_metric_int* bound_out)
+{
+	if (metric == NULL || labels == NULL || bound_out == NULL) {
+		return -EINVAL;
+	}
+
+	return bind_labels(&metric->base, labels, label_count, &bound_out->metric,
+			   &bound_out->timeseries);
+}
+
+int spotflow_metric_bind_labels_float(struct spotflow_metric_float* metric,
+				      const struct spotflow_label* labels, uint8_t label_count,
+				      struct spotflow_bound_metric_float* bound_out)
+{
+	if (metric == NULL || labels == NULL || bound_out == NULL) {
+		return -EINVAL;
+	}
+
+	return bind_labels(&metric->base, labels, label_count, &bound_out->metric,
+			   &bound_out->timeseries);
+}
+
+int spotflow_report_bound_int(struct spotflow_bound_metric_int* bound, int64_t value)
+{
+	if (bound == NULL || bound->timeseries == NULL) {
+		return -EINVAL;
+	}
+
+	return aggregator_report_bound_value(bound->metric, bound->timeseries, value, 0.0);
+}
+
+int spotflow_report_bound_float(struct spotflow_bound_metric_float* bound, float value)
+{
+	if (bound == NULL || bound->timeseries == NULL) {
+		return -EINVAL;
+	}
+
+	return aggregator_report_bound_value(bound->metric, bound->timeseries, 0, value);
+}
+
+int spotflow_report_bound_event(struct spotflow_bound_metric_int* bound)
+{
+	if (bound == NULL || bound->timeseries == NULL) {
+		return -EINVAL;
+	}
+
+	/* Events report value of 1 (event occurred) */
+	return aggregator_report_bound_value(bound->metric, bound->timeseries, 1, 0.0);
 }
 
 /**
- * @brief Validate the labels for a metric
+ * @brief Validate the labels for a metric and compute their hash
  *
  * @param base
  * @param labels
  * @param label_count
+ * @param labels_hash Hash used to look up the time series of the labels
  * @return int
  */
 static int validate_labels(const struct spotflow_metric_base* base,
-			   const struct spotflow_label* labels, uint8_t label_count)
+			   const struct spotflow_label* labels, uint8_t label_count,
+			   uint32_t* labels_hash)
 {
 	if (label_count == 0 || label_count > base->max_labels) {
 		SPOTFLOW_LOG("Invalid label_count: %u (max %u)", label_count, base->max_labels);
@@ -162,5 +223,35 @@ static int validate_labels(const struct spotflow_metric_base* base,
 		}
 	}
 
+	*labels_hash = aggregator_hash_labels(labels, label_count);
+	return 0;
+}
+
+/**
+ * @brief Bind the labels of a labeled metric, the outputs are set only on success
+ */
+static int bind_labels(struct spotflow_metric_base* base, const struct spotflow_label* labels,
+		       uint8_t label_count, struct spotflow_metric_base** metric_out,
+		       struct metric_timeseries_state** ts_out)
+{
+	if (base->max_labels == 0) {
+		SPOTFLOW_LOG("Labels can be bound only for labeled metrics");
+		return -EINVAL;
+	}
+
+	uint32_t labels_hash;
+	int err = validate_labels(base, labels, label_count, &labels_hash);
+	if (err) {
+		return err;
+	}
+
+	struct metric_timeseries_state* ts;
+	err = aggregator_bind_timeseries(base, labels, label_count, labels_hash, &ts);
+	if (err) {
+		return err;
+	}
+
+	*metric_out = base;
+	*ts_out = ts;
 	return 0;
 }
@@ -36,6 +36,7 @@ static bool encode_aggregation_stats(CborEncoder* map, struct spotflow_metric_ba
 
 int spotflow_metrics_cbor_encode_aggregated(struct spotflow_metric_base* metric,
 					    struct metric_timeseries_state* ts,
+					    const struct metric_timeseries_labels* labels,
 					    int64_t timestamp_ms, uint64_t sequence_number,
 					    uint8_t** cbor_data, size_t* cbor_len)
 {
@@ -61,7 +62,7 @@ int spotflow_metrics_cbor_encode_aggregated(struct spotflow_metric_base* metric,
 	/* Base entries: messageType, metricName, aggregationInterval, deviceUptimeMs,
 	 *               sequenceNumber, sum, count, min, max = 9 */
 	uint32_t map_entries = 9;
-	if (ts->label_count > 0) {
+	if (labels != NULL) {
 		map_entries++; /* labels */
 	}
 	if (ts->sum_truncated) {
@@ -75,7 +76,7 @@ int spotflow_metrics_cbor_encode_aggregated(struct spotflow_metric_base* metric,
 	}
 
 	if (!encode_metric_header(&map, metric, timestamp_ms, sequence_number) ||
-	    (ts->label_count > 0 && !encode_labels(&map, ts->labels, ts->label_count)) ||
+	    (labels != NULL && !encode_labels(&map, labels->labels, labels->label_count)) ||
 	    !encode_aggregation_stats(&map, metric, ts)) {
 		SPOTFLOW_LOG("CBOR encoding failed");
 		free(buffer);
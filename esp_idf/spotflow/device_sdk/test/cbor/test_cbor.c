@@ -1,17 +1,22 @@
 #include "test_common.h"
+#include "configs/spotflow_config_cbor.h"
 
 /* optimized property keys */
 #define KEY_MESSAGE_TYPE 0x00
 #define LOGS_MESSAGE_TYPE 0x00
 #define KEY_BODY 0x01
 #define KEY_BODY_TEMPLATE 0x02
-/* (unused for now) */
 #define KEY_BODY_TEMPLATE_VALUES 0x03
 #define KEY_SEVERITY 0x04
 #define KEY_LABELS 0x05
 #define KEY_DEVICE_UPTIME_MS 0x06
 #define KEY_SEQUENCE_NUMBER 0x0D
 
+/* desired configuration keys */
+#define KEY_DESIRED_CONFIGURATION_VERSION 0x12
+#define KEY_TAG_MINIMAL_SEVERITIES 0x14
+#define UPDATE_DESIRED_CONFIGURATION_MESSAGE_TYPE 0x03
+
 typedef enum {
 	LOG_SEVERITY_ERROR = 0x3C, // Error
 	LOG_SEVERITY_WARN = 0x32, // Warn
@@ -22,21 +27,16 @@ typedef enum {
 // Maximum CBOR buffer length used in production
 #define MAX_CBOR_LEN CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN
 
-static uint8_t* cbor_buf = NULL;
+static uint8_t cbor_buf[MAX_CBOR_LEN];
 static size_t cbor_len = 0;
 
 void setUp(void)
 {
-	cbor_buf = NULL;
 	cbor_len = 0;
 }
 
 void tearDown(void)
 {
-	if (cbor_buf) {
-		free(cbor_buf);
-		cbor_buf = NULL;
-	}
 }
 
 static bool cbor_text_equals(CborValue* element, const char* expected_text, size_t expected_len)
@@ -137,9 +137,8 @@ TEST_CASE("CBOR encodes a simple log correctly", "[spotflow][cbor]")
 					 .severity = LOG_SEVERITY_INFO,
 					 .source = "unit_test" };
 
-	cbor_buf = spotflow_log_cbor(template_str, body, &cbor_len, &meta);
-
-	TEST_SPOTFLOW_ASSERT_TRUE(cbor_buf != NULL);
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_log_cbor(template_str, body, strlen(body), &meta,
+							cbor_buf, sizeof(cbor_buf), &cbor_len));
 	TEST_SPOTFLOW_ASSERT_LESS_OR_EQUAL(MAX_CBOR_LEN, cbor_len);
 
 	/* Verify message type */
@@ -164,9 +163,6 @@ TEST_CASE("CBOR encodes a simple log correctly", "[spotflow][cbor]")
 	/* Verify metadata - uptime */
 	TEST_SPOTFLOW_ASSERT_TRUE(
 	    contains_cbor_uint_value(cbor_buf, cbor_len, KEY_DEVICE_UPTIME_MS, 1000U));
-
-	free(cbor_buf);
-	cbor_buf = NULL;
 }
 
 TEST_CASE("CBOR handles empty source string", "[spotflow][cbor]")
@@ -178,9 +174,8 @@ TEST_CASE("CBOR handles empty source string", "[spotflow][cbor]")
 					 .source = "",
 					 .severity = LOG_SEVERITY_WARN };
 
-	cbor_buf = spotflow_log_cbor(template_str, body, &cbor_len, &meta);
-
-	TEST_SPOTFLOW_ASSERT_TRUE(cbor_buf != NULL);
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_log_cbor(template_str, body, strlen(body), &meta,
+							cbor_buf, sizeof(cbor_buf), &cbor_len));
 	TEST_SPOTFLOW_ASSERT_TRUE(cbor_len > 0U);
 
 	/* Verify basic structure - message type should be LOGS_MESSAGE_TYPE */
@@ -203,31 +198,25 @@ TEST_CASE("CBOR handles empty source string", "[spotflow][cbor]")
 
 	/* Verify body message */
 	TEST_SPOTFLOW_ASSERT_TRUE(contains_cbor_text_value(cbor_buf, cbor_len, KEY_BODY, body));
-
-	free(cbor_buf);
-	cbor_buf = NULL;
 }
 
 TEST_CASE("CBOR encodes large log body", "[spotflow][cbor]")
 {
 	const char* template = "Large template";
-	char* body = malloc(1024);
-	memset(body, 'A', 1023);
-	body[1023] = '\0';
+	char* body = malloc(CONFIG_SPOTFLOW_LOG_BUFFER_SIZE);
+	memset(body, 'A', CONFIG_SPOTFLOW_LOG_BUFFER_SIZE - 1);
+	body[CONFIG_SPOTFLOW_LOG_BUFFER_SIZE - 1] = '\0';
 
 	struct message_metadata meta = { .sequence_number = 99,
 					 .uptime_ms = 12345,
 					 .severity = LOG_SEVERITY_INFO,
 					 .source = "large_test" };
 
-	cbor_buf = spotflow_log_cbor(template, body, &cbor_len, &meta);
-
-	TEST_SPOTFLOW_ASSERT_TRUE(cbor_buf != NULL);
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_log_cbor(template, body, strlen(body), &meta, cbor_buf,
+							sizeof(cbor_buf), &cbor_len));
 
 	TEST_SPOTFLOW_ASSERT_TRUE(cbor_len > 0);
 	free(body);
-	free(cbor_buf);
-	cbor_buf = NULL;
 }
 
 TEST_CASE("CBOR handles NULL body safely", "[spotflow][cbor]")
@@ -242,10 +231,111 @@ TEST_CASE("CBOR handles NULL body safely", "[spotflow][cbor]")
 
 	// Allocate a dummy empty string if NULL
 	char dummy_body[] = "";
-	cbor_buf = spotflow_log_cbor(template, body ? body : dummy_body, &cbor_len, &meta);
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_log_cbor(template, body ? body : dummy_body, 0, &meta,
+							cbor_buf, sizeof(cbor_buf), &cbor_len));
+}
+
+TEST_CASE("CBOR rejects log not fitting the buffer", "[spotflow][cbor]")
+{
+	const char* template = "Template";
+	char body[] = "Message longer than the buffer";
+	uint8_t small_buf[16];
+
+	struct message_metadata meta = { .sequence_number = 7,
+					 .uptime_ms = 0,
+					 .severity = LOG_SEVERITY_INFO,
+					 .source = "small_test" };
+
+	TEST_SPOTFLOW_ASSERT_EQUAL(-1, spotflow_log_cbor(template, body, strlen(body), &meta,
+							 small_buf, sizeof(small_buf), &cbor_len));
+}
 
-	TEST_SPOTFLOW_ASSERT_TRUE(cbor_buf != NULL);
+static int encode_template_values(const struct message_metadata* meta, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	int rc = spotflow_log_cbor_template_values(fmt, args, meta, cbor_buf, sizeof(cbor_buf),
+						   &cbor_len);
+	va_end(args);
+	return rc;
+}
+
+TEST_CASE("CBOR encodes log template values", "[spotflow][cbor]")
+{
+	const char* template_str = "Value %d of %s is %u";
+
+	struct message_metadata meta = { .sequence_number = 3,
+					 .uptime_ms = 500,
+					 .severity = LOG_SEVERITY_INFO,
+					 .source = "values_test" };
+
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, encode_template_values(&meta, template_str, -5, "abc", 42U));
+	TEST_SPOTFLOW_ASSERT_TRUE(cbor_len > 0);
 
-	free(cbor_buf);
-	cbor_buf = NULL;
+	TEST_SPOTFLOW_ASSERT_TRUE(
+	    contains_cbor_text_value(cbor_buf, cbor_len, KEY_BODY_TEMPLATE, template_str));
+
+	CborParser parser;
+	CborValue map, element, values;
+	uint64_t key = 0;
+	TEST_SPOTFLOW_ASSERT_EQUAL(CborNoError,
+				   cbor_parser_init(cbor_buf, cbor_len, 0U, &parser, &map));
+	TEST_SPOTFLOW_ASSERT_EQUAL(CborNoError, cbor_value_enter_container(&map, &element));
+	while (get_cbor_key(&element, &key) && key != KEY_BODY_TEMPLATE_VALUES) {
+		TEST_SPOTFLOW_ASSERT_FALSE(key == KEY_BODY);
+		TEST_SPOTFLOW_ASSERT_EQUAL(CborNoError, cbor_value_advance(&element));
+	}
+	TEST_SPOTFLOW_ASSERT_EQUAL(KEY_BODY_TEMPLATE_VALUES, key);
+	TEST_SPOTFLOW_ASSERT_TRUE(cbor_value_is_array(&element));
+	TEST_SPOTFLOW_ASSERT_EQUAL(CborNoError, cbor_value_enter_container(&element, &values));
+
+	int64_t signed_value = 0;
+	TEST_SPOTFLOW_ASSERT_TRUE(cbor_value_is_integer(&values));
+	TEST_SPOTFLOW_ASSERT_EQUAL(CborNoError, cbor_value_get_int64(&values, &signed_value));
+	TEST_SPOTFLOW_ASSERT_EQUAL(-5, signed_value);
+	TEST_SPOTFLOW_ASSERT_EQUAL(CborNoError, cbor_value_advance(&values));
+
+	TEST_SPOTFLOW_ASSERT_TRUE(cbor_text_equals(&values, "abc", 3));
+	TEST_SPOTFLOW_ASSERT_EQUAL(CborNoError, cbor_value_advance(&values));
+
+	uint64_t unsigned_value = 0;
+	TEST_SPOTFLOW_ASSERT_EQUAL(CborNoError, cbor_value_get_uint64(&values, &unsigned_value));
+	TEST_SPOTFLOW_ASSERT_EQUAL(42, unsigned_value);
+	TEST_SPOTFLOW_ASSERT_EQUAL(CborNoError, cbor_value_advance(&values));
+	TEST_SPOTFLOW_ASSERT_TRUE(cbor_value_at_end(&values));
+}
+
+TEST_CASE("CBOR decodes desired tag log severities", "[spotflow][cbor]")
+{
+	uint8_t payload[64];
+	CborEncoder encoder, map_encoder, tags_encoder;
+
+	cbor_encoder_init(&encoder, payload, sizeof(payload), 0);
+	cbor_encoder_create_map(&encoder, &map_encoder, 3);
+	cbor_encode_uint(&map_encoder, KEY_MESSAGE_TYPE);
+	cbor_encode_uint(&map_encoder, UPDATE_DESIRED_CONFIGURATION_MESSAGE_TYPE);
+	cbor_encode_uint(&map_encoder, KEY_TAG_MINIMAL_SEVERITIES);
+	cbor_encoder_create_map(&map_encoder, &tags_encoder, 2);
+	cbor_encode_text_stringz(&tags_encoder, "wifi");
+	cbor_encode_uint(&tags_encoder, LOG_SEVERITY_ERROR);
+	cbor_encode_text_stringz(&tags_encoder, "noisy");
+	cbor_encode_uint(&tags_encoder, 0);
+	cbor_encoder_close_container(&map_encoder, &tags_encoder);
+	/* Keys after the tag map are still decoded */
+	cbor_encode_uint(&map_encoder, KEY_DESIRED_CONFIGURATION_VERSION);
+	cbor_encode_uint(&map_encoder, 7);
+	cbor_encoder_close_container(&encoder, &map_encoder);
+
+	size_t payload_len = cbor_encoder_get_buffer_size(&encoder, payload);
+	struct spotflow_config_desired_msg msg;
+
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_config_cbor_decode_desired(payload, payload_len, &msg));
+	TEST_SPOTFLOW_ASSERT_TRUE(msg.flags & SPOTFLOW_DESIRED_FLAG_TAG_MINIMAL_LOG_SEVERITIES);
+	TEST_SPOTFLOW_ASSERT_FALSE(msg.flags & SPOTFLOW_DESIRED_FLAG_MINIMAL_LOG_SEVERITY);
+	TEST_SPOTFLOW_ASSERT_EQUAL(2, msg.tag_severity_count);
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, strcmp("wifi", msg.tag_severities[0].tag));
+	TEST_SPOTFLOW_ASSERT_EQUAL(LOG_SEVERITY_ERROR, msg.tag_severities[0].severity);
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, strcmp("noisy", msg.tag_severities[1].tag));
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, msg.tag_severities[1].severity);
+	TEST_SPOTFLOW_ASSERT_EQUAL(7, msg.desired_config_version);
 }
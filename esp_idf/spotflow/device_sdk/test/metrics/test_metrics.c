@@ -0,0 +1,211 @@
+#include "test_common.h"
+#include "sdkconfig.h"
+
+#if CONFIG_SPOTFLOW_METRICS
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "metrics/spotflow_metrics_aggregator.h"
+#include "metrics/spotflow_metrics_backend.h"
+#include "metrics/spotflow_metrics_net.h"
+#include "metrics/spotflow_metrics_registry.h"
+
+#define BENCH_MAX_TIMESERIES 256
+#define BENCH_REPORTS 4096
+/* A lookup scanning the time series would be about 100 times slower at 256 than at 1 */
+#define BENCH_MAX_LATENCY_RATIO 8
+#define MAX_TEST_METRICS 4
+
+static char label_values[BENCH_MAX_TIMESERIES][8];
+static struct spotflow_label labels[BENCH_MAX_TIMESERIES];
+
+/* Metrics registered by the running test, unregistered by metrics_teardown() */
+static struct spotflow_metric_int* test_metrics[MAX_TEST_METRICS];
+static int test_metric_count;
+
+static void init_labels(void)
+{
+	for (int i = 0; i < BENCH_MAX_TIMESERIES; i++) {
+		snprintf(label_values[i], sizeof(label_values[i]), "ts_%d", i);
+		labels[i].key = "timeseries";
+		labels[i].value = label_values[i];
+	}
+}
+
+/* The SDK never releases metrics, the tests do it so that their names can be registered again */
+static void unregister_test_metric(struct spotflow_metric_int* metric)
+{
+	aggregator_unregister_metric(&metric->base);
+	vSemaphoreDelete(metric->base.lock);
+	memset(&metric->base, 0, sizeof(metric->base));
+}
+
+static void metrics_teardown(void)
+{
+	for (int i = 0; i < test_metric_count; i++) {
+		unregister_test_metric(test_metrics[i]);
+	}
+	test_metric_count = 0;
+}
+
+static void metrics_setup(void)
+{
+	static bool initialized;
+
+	if (!initialized) {
+		spotflow_metrics_init();
+		spotflow_metrics_net_init();
+		initialized = true;
+	}
+
+	/* Metrics of a test that failed before its teardown would make the next run fail */
+	metrics_teardown();
+	init_labels();
+}
+
+/* Daily windows are not closed during the tests */
+static struct spotflow_metric_int* register_test_metric(const char* name, uint16_t timeseries)
+{
+	struct spotflow_metric_int* metric;
+
+	TEST_SPOTFLOW_ASSERT_TRUE(test_metric_count < MAX_TEST_METRICS);
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_register_metric_int_with_labels(
+					  name, SPOTFLOW_AGG_INTERVAL_1DAY, timeseries, 1, &metric));
+	test_metrics[test_metric_count++] = metric;
+	return metric;
+}
+
+/* Returns the average report latency in nanoseconds with all the time series active */
+static int64_t measure_report_latency_ns(const char* name, uint16_t timeseries)
+{
+	struct spotflow_metric_int* metric = register_test_metric(name, timeseries);
+
+	for (uint16_t i = 0; i < timeseries; i++) {
+		TEST_SPOTFLOW_ASSERT_EQUAL(
+		    0, spotflow_report_metric_int_with_labels(metric, i, &labels[i], 1));
+	}
+
+	int64_t start_us = esp_timer_get_time();
+	for (int i = 0; i < BENCH_REPORTS; i++) {
+		TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_report_metric_int_with_labels(
+						  metric, i, &labels[i % timeseries], 1));
+	}
+	int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+	int64_t latency_ns = elapsed_us * 1000 / BENCH_REPORTS;
+	printf("Report latency with %u timeseries: %lld ns\n", timeseries, (long long)latency_ns);
+	return latency_ns;
+}
+
+/* Wall-clock figures are noisy under QEMU, so only a lookup that grows with the number of time
+ * series is caught, by a generous bound on the latency ratio.
+ */
+static void test_metrics_report_latency_impl(void)
+{
+	int64_t latency_1_ns = measure_report_latency_ns("bench_timeseries_1", 1);
+	measure_report_latency_ns("bench_timeseries_16", 16);
+	int64_t latency_256_ns = measure_report_latency_ns("bench_timeseries_256", 256);
+
+	int64_t max_latency_ns = BENCH_MAX_LATENCY_RATIO * (latency_1_ns > 0 ? latency_1_ns : 1);
+	TEST_SPOTFLOW_ASSERT_LESS_OR_EQUAL(max_latency_ns, latency_256_ns);
+}
+
+/* Reports go to all the time series in turn and the window is closed like by the timer. Only the
+ * public API, including the counters of a bound time series, and aggregator_flush_metric() are
+ * used, so the benchmark does not depend on the layout of the aggregator state.
+ */
+static void test_metrics_throughput_impl(void)
+{
+	struct spotflow_bound_metric_int bound = { 0 };
+	struct spotflow_metric_int* metric =
+	    register_test_metric("bench_throughput", BENCH_MAX_TIMESERIES);
+
+	/* The first time series is observed through a bound handle */
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_metric_bind_labels_int(metric, &labels[0], 1, &bound));
+
+	int64_t start_us = esp_timer_get_time();
+	for (int i = 0; i < BENCH_REPORTS; i++) {
+		TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_report_metric_int_with_labels(
+						  metric, i, &labels[i % BENCH_MAX_TIMESERIES], 1));
+	}
+	int64_t report_us = esp_timer_get_time() - start_us;
+
+	/* Reports i = 0, 256, 512... went to the first time series */
+	const int reports_per_timeseries = BENCH_REPORTS / BENCH_MAX_TIMESERIES;
+	TEST_SPOTFLOW_ASSERT_EQUAL(reports_per_timeseries, bound.timeseries->count);
+	TEST_SPOTFLOW_ASSERT_EQUAL(BENCH_MAX_TIMESERIES * reports_per_timeseries *
+					   (reports_per_timeseries - 1) / 2,
+				   bound.timeseries->sum_int);
+
+	/* Encodes and enqueues all the time series, the queue drops the oldest messages */
+	start_us = esp_timer_get_time();
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, aggregator_flush_metric(&metric->base));
+	int64_t flush_us = esp_timer_get_time() - start_us;
+
+	/* The window was closed, the time series starts over */
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, bound.timeseries->count);
+
+	printf("Report throughput with %u timeseries: %lld reports/s\n", BENCH_MAX_TIMESERIES,
+	       BENCH_REPORTS * 1000000LL / (report_us > 0 ? report_us : 1));
+	printf("Flush throughput with %u timeseries: %lld timeseries/s\n", BENCH_MAX_TIMESERIES,
+	       BENCH_MAX_TIMESERIES * 1000000LL / (flush_us > 0 ? flush_us : 1));
+}
+
+static void test_metrics_bound_labels_survive_eviction_impl(void)
+{
+	struct spotflow_bound_metric_int bound = { 0 };
+	struct spotflow_metric_int* metric = register_test_metric("test_bound_labels", 2);
+	struct metric_aggregator_context* ctx = metric->base.aggregator_context;
+
+	TEST_SPOTFLOW_ASSERT_EQUAL(-EINVAL, spotflow_report_bound_int(&bound, 1));
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_metric_bind_labels_int(metric, &labels[0], 1, &bound));
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_report_metric_int_with_labels(metric, 1, &labels[1], 1));
+
+	/* One time series is bound and the other has a value in the window, neither is evicted */
+	TEST_SPOTFLOW_ASSERT_EQUAL(-ENOSPC,
+				   spotflow_report_metric_int_with_labels(metric, 1, &labels[2], 1));
+
+	/* Closing the window leaves both time series idle, only the unbound one can be evicted */
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, aggregator_flush_metric(&metric->base));
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_report_metric_int_with_labels(metric, 1, &labels[2], 1));
+	TEST_SPOTFLOW_ASSERT_EQUAL(-ENOSPC,
+				   spotflow_report_metric_int_with_labels(metric, 1, &labels[3], 1));
+
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_report_bound_int(&bound, 5));
+	TEST_SPOTFLOW_ASSERT_EQUAL(1, bound.timeseries->count);
+	TEST_SPOTFLOW_ASSERT_EQUAL(5, bound.timeseries->sum_int);
+	const struct metric_timeseries_labels* bound_labels =
+	    &ctx->labels[bound.timeseries - ctx->timeseries];
+	TEST_SPOTFLOW_ASSERT_EQUAL(0, strcmp(label_values[0], bound_labels->labels[0].value));
+}
+
+/* ---------------- TEST CASES ---------------- */
+
+TEST_CASE("spotflow metrics: report latency at 1, 16 and 256 timeseries",
+	  "[spotflow][metrics][benchmark]")
+{
+	metrics_setup();
+	test_metrics_report_latency_impl();
+	metrics_teardown();
+}
+
+TEST_CASE("spotflow metrics: report and flush throughput at 256 timeseries",
+	  "[spotflow][metrics][benchmark]")
+{
+	metrics_setup();
+	test_metrics_throughput_impl();
+	metrics_teardown();
+}
+
+TEST_CASE("spotflow metrics: bound labels survive idle eviction", "[spotflow][metrics]")
+{
+	metrics_setup();
+	test_metrics_bound_labels_survive_eviction_impl();
+	metrics_teardown();
+}
+
+#endif /* CONFIG_SPOTFLOW_METRICS */
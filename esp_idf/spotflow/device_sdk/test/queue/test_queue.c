@@ -12,7 +12,7 @@ static void test_queue_single_push_pop_impl(void)
     const uint8_t data[] = { 0x10, 0x20, 0x30 };
     queue_msg_t msg = {0};
 
-    spotflow_queue_push((uint8_t *)data, sizeof(data));
+    spotflow_queue_push((uint8_t *)data, sizeof(data), ESP_LOG_INFO);
 
     TEST_SPOTFLOW_ASSERT_TRUE(spotflow_queue_read(&msg));
     TEST_SPOTFLOW_ASSERT_EQUAL(sizeof(data), msg.len);
@@ -29,9 +29,9 @@ static void test_queue_fifo_impl(void)
 
     queue_msg_t msg;
 
-    spotflow_queue_push((uint8_t *)a, sizeof(a));
-    spotflow_queue_push((uint8_t *)b, sizeof(b));
-    spotflow_queue_push((uint8_t *)c, sizeof(c));
+    spotflow_queue_push((uint8_t *)a, sizeof(a), ESP_LOG_INFO);
+    spotflow_queue_push((uint8_t *)b, sizeof(b), ESP_LOG_INFO);
+    spotflow_queue_push((uint8_t *)c, sizeof(c), ESP_LOG_INFO);
 
     spotflow_queue_read(&msg);
     TEST_SPOTFLOW_ASSERT_EQUAL(1, msg.ptr[0]);
@@ -59,7 +59,7 @@ static void test_queue_overflow_impl(void)
     queue_msg_t msg;
 
     for (int i = 0; i < CONFIG_SPOTFLOW_MESSAGE_QUEUE_SIZE + 2; i++) {
-        spotflow_queue_push(&dummy, sizeof(dummy));
+        spotflow_queue_push(&dummy, sizeof(dummy), ESP_LOG_INFO);
     }
 
     /* Behavior depends on implementation:
@@ -76,6 +76,81 @@ static void test_queue_overflow_impl(void)
     TEST_SPOTFLOW_ASSERT_LESS_OR_EQUAL(CONFIG_SPOTFLOW_MESSAGE_QUEUE_SIZE, count);
 }
 
+static void test_queue_error_survives_debug_flood_impl(void)
+{
+    const uint8_t error = 0xEE;
+    uint8_t debug = 0;
+    queue_msg_t msg;
+
+    spotflow_queue_push((uint8_t *)&error, sizeof(error), ESP_LOG_ERROR);
+    for (int i = 0; i < CONFIG_SPOTFLOW_MESSAGE_QUEUE_SIZE + 2; i++) {
+        debug = i;
+        spotflow_queue_push(&debug, sizeof(debug), ESP_LOG_DEBUG);
+    }
+
+    TEST_SPOTFLOW_ASSERT_EQUAL(3, spotflow_queue_get_dropped_count(ESP_LOG_DEBUG));
+    TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_queue_get_dropped_count(ESP_LOG_ERROR));
+
+    /* The error stays first, the oldest debug messages were evicted */
+    TEST_SPOTFLOW_ASSERT_TRUE(spotflow_queue_read(&msg));
+    TEST_SPOTFLOW_ASSERT_EQUAL(ESP_LOG_ERROR, msg.level);
+    TEST_SPOTFLOW_ASSERT_EQUAL(error, msg.ptr[0]);
+    spotflow_queue_free(&msg);
+
+    TEST_SPOTFLOW_ASSERT_TRUE(spotflow_queue_read(&msg));
+    TEST_SPOTFLOW_ASSERT_EQUAL(ESP_LOG_DEBUG, msg.level);
+    TEST_SPOTFLOW_ASSERT_EQUAL(3, msg.ptr[0]);
+    spotflow_queue_free(&msg);
+}
+
+static void test_queue_drops_less_severe_new_message_impl(void)
+{
+    uint8_t dummy = 0xAA;
+    queue_msg_t msg;
+
+    for (int i = 0; i < CONFIG_SPOTFLOW_MESSAGE_QUEUE_SIZE; i++) {
+        spotflow_queue_push(&dummy, sizeof(dummy), ESP_LOG_ERROR);
+    }
+    spotflow_queue_push(&dummy, sizeof(dummy), ESP_LOG_DEBUG);
+
+    TEST_SPOTFLOW_ASSERT_EQUAL(1, spotflow_queue_get_dropped_count(ESP_LOG_DEBUG));
+    TEST_SPOTFLOW_ASSERT_EQUAL(0, spotflow_queue_get_dropped_count(ESP_LOG_ERROR));
+
+    int count = 0;
+    while (spotflow_queue_read(&msg)) {
+        TEST_SPOTFLOW_ASSERT_EQUAL(ESP_LOG_ERROR, msg.level);
+        count++;
+        spotflow_queue_free(&msg);
+    }
+
+    TEST_SPOTFLOW_ASSERT_EQUAL(CONFIG_SPOTFLOW_MESSAGE_QUEUE_SIZE, count);
+}
+
+static void test_queue_buffer_full_evicts_oldest_impl(void)
+{
+    static uint8_t data[CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN];
+    const int pushed = CONFIG_SPOTFLOW_MESSAGE_QUEUE_BUFFER_SIZE / sizeof(data) + 1;
+    queue_msg_t msg;
+
+    /* Largest messages fill the buffer before the queue runs out of entries */
+    for (int i = 0; i < pushed; i++) {
+        memset(data, i, sizeof(data));
+        spotflow_queue_push(data, sizeof(data), ESP_LOG_INFO);
+    }
+
+    TEST_SPOTFLOW_ASSERT_EQUAL(1, spotflow_queue_get_dropped_count(ESP_LOG_INFO));
+
+    for (int i = 1; i < pushed; i++) {
+        TEST_SPOTFLOW_ASSERT_TRUE(spotflow_queue_read(&msg));
+        TEST_SPOTFLOW_ASSERT_EQUAL(sizeof(data), msg.len);
+        TEST_SPOTFLOW_ASSERT_EQUAL(i, msg.ptr[0]);
+        TEST_SPOTFLOW_ASSERT_EQUAL(i, msg.ptr[msg.len - 1]);
+        spotflow_queue_free(&msg);
+    }
+
+    TEST_SPOTFLOW_ASSERT_FALSE(spotflow_queue_read(&msg));
+}
+
 /* ---------------- TEST CASES ---------------- */
 
 TEST_CASE("spotflow queue: single push pop", "[spotflow][queue]")
@@ -101,3 +176,21 @@ TEST_CASE("spotflow queue: overflow", "[spotflow][queue]")
     queue_setup();
     test_queue_overflow_impl();
 }
+
+TEST_CASE("spotflow queue: error survives debug flood", "[spotflow][queue]")
+{
+    queue_setup();
+    test_queue_error_survives_debug_flood_impl();
+}
+
+TEST_CASE("spotflow queue: drops less severe new message", "[spotflow][queue]")
+{
+    queue_setup();
+    test_queue_drops_less_severe_new_message_impl();
+}
+
+TEST_CASE("spotflow queue: buffer full evicts oldest", "[spotflow][queue]")
+{
+    queue_setup();
+    test_queue_buffer_full_evicts_oldest_impl();
+}
@@ -9,10 +9,8 @@ extern "C" {
 #endif
 
 struct spotflow_cbor_output_context {
-	char cbor_buf[CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN];
+	uint8_t cbor_buf[CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN];
 	size_t cbor_len;
-	char log_msg[CONFIG_SPOTFLOW_LOG_BUFFER_SIZE];
-	size_t log_msg_ctr;
 };
 
 #ifdef __cplusplus
@@ -6,28 +6,57 @@
 #include <zephyr/net/mqtt.h>
 #include <zephyr/kernel.h>
 
+#include "logging/spotflow_log_buffer.h"
 #include "logging/spotflow_log_cbor.h"
 #include "logging/spotflow_cbor_output_context.h"
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+#include "logging/spotflow_log_rate_limit.h"
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+#include "logging/spotflow_log_coalesce.h"
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
+#ifdef CONFIG_SPOTFLOW_LOG_RETAINED
+#include "logging/spotflow_log_retained.h"
+#include "net/spotflow_session_metadata.h"
+#endif /* CONFIG_SPOTFLOW_LOG_RETAINED */
 #include "config/spotflow_config.h"
 #include "config/spotflow_config_options.h"
 #include "net/spotflow_processor.h"
 
 LOG_MODULE_REGISTER(spotflow_logging, CONFIG_SPOTFLOW_LOGS_PROCESSING_LOG_LEVEL);
 
-/* https://docs.zephyrproject.org/apidoc/latest/group__msgq__apis.html
- * Alignment of the message queue's ring buffer is not necessary,
- * setting q_align to 1 is sufficient.*/
-K_MSGQ_DEFINE(g_spotflow_logs_msgq, sizeof(struct spotflow_mqtt_logs_msg*),
-	      CONFIG_SPOTFLOW_LOG_BACKEND_QUEUE_SIZE, 1);
+#if defined(CONFIG_SPOTFLOW_LOG_RATE_LIMIT) || defined(CONFIG_SPOTFLOW_LOG_COALESCING)
+/* Summaries are put also by a work item, when no more messages are processed */
+#define SUMMARY_WORK 1
+#endif
 
 struct spotflow_log_context {
 	struct spotflow_cbor_output_context cbor_output_context;
 	size_t dropped_backend_count;
+	/* dropped messages by their log level, index 0 holds messages dropped by zephyr */
+	size_t dropped_level_count[LOG_LEVEL_DBG + 1];
 	size_t message_index;
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+	/* suppressed messages are not counted as processed, so they do not consume sequence numbers */
+	size_t suppressed_count;
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+	/* repeated messages are sent only as counts in the summaries of their runs */
+	size_t coalesced_count;
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
+	/* after panic, messages are processed in the panic context (and retained if enabled) */
+	bool panic_mode;
 };
 
 static struct spotflow_log_context spotflow_log_ctx;
 
+#ifdef CONFIG_SPOTFLOW_LOG_LAZY_ENCODING
+/* Raw records are encoded here by the Spotflow processing thread, or by panic() */
+static struct spotflow_cbor_output_context lazy_output_context;
+/* Raw log messages are copied here first, because they are not aligned in the records */
+static uint8_t lazy_log_msg[SPOTFLOW_LOG_RAW_MSG_MAX_LEN] __aligned(Z_LOG_MSG_ALIGNMENT);
+#endif /* CONFIG_SPOTFLOW_LOG_LAZY_ENCODING */
+
 static void init(const struct log_backend* backend);
 
 static void process(const struct log_backend* backend, union log_msg_generic* msg);
@@ -36,6 +65,11 @@ static void panic(const struct log_backend* backend);
 
 static void dropped(const struct log_backend* backend, uint32_t cnt);
 
+static void process_message(struct spotflow_log_context* context, struct log_msg* log_msg);
+
+static int put_message(struct spotflow_log_context* context, struct log_msg* log_msg,
+		       uint8_t level);
+
 static const struct log_backend_api log_backend_spotflow_api = {
 	.init = init,
 	.process = process,
@@ -50,10 +84,40 @@ LOG_BACKEND_DEFINE(log_backend_spotflow, log_backend_spotflow_api, true /* autos
 		   &spotflow_log_ctx);
 #endif /* CONFIG_SPOTFLOW_LOG_BACKEND */
 
-static int enqueue_log_msg(const struct spotflow_mqtt_logs_msg* msg,
-			   struct spotflow_log_context* ctx);
+static void log_record_dropped(const struct spotflow_log_record* record);
+
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+static void put_suppressed_summary(int16_t source_id, uint32_t suppressed_count);
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
+
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+static void put_repeat_summary(struct spotflow_log_context* context,
+			       const struct spotflow_log_repeat* repeat);
+static void flush_repeat_summary(struct spotflow_log_context* context, bool force,
+				 int32_t* next_flush_ms);
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
+
+#ifdef SUMMARY_WORK
+static void summary_work_handler(struct k_work* work);
+
+/* Puts the due summaries even when no more messages are processed */
+static K_WORK_DELAYABLE_DEFINE(summary_work, summary_work_handler);
+/* Serializes the processing of messages with the summary work item */
+static K_MUTEX_DEFINE(process_mutex);
+#endif /* SUMMARY_WORK */
 
-static void process_single_message_stats_update(struct spotflow_log_context* context, bool dropped);
+#ifdef CONFIG_SPOTFLOW_LOG_RETAINED
+static void process_panic_message(struct spotflow_log_context* context, struct log_msg* log_msg,
+				  uint8_t level);
+#endif /* CONFIG_SPOTFLOW_LOG_RETAINED */
+
+#ifdef CONFIG_SPOTFLOW_LOG_LAZY_ENCODING
+static int put_raw_message(struct spotflow_log_context* context, struct log_msg* log_msg,
+			   uint8_t level);
+#endif /* CONFIG_SPOTFLOW_LOG_LAZY_ENCODING */
+
+static void process_single_message_stats_update(struct spotflow_log_context* context,
+						uint8_t level, bool dropped);
 
 static void process_message_stats_update(struct spotflow_log_context* context, uint32_t cnt,
 					 bool dropped);
@@ -71,6 +135,47 @@ void spotflow_log_backend_try_set_runtime_filter(uint32_t level)
 #endif /* CONFIG_SPOTFLOW_LOG_BACKEND_SET_RUNTIME_FILTERING */
 }
 
+size_t spotflow_log_backend_get_dropped_count(uint8_t level)
+{
+	if (level >= ARRAY_SIZE(spotflow_log_ctx.dropped_level_count)) {
+		return 0;
+	}
+
+	return spotflow_log_ctx.dropped_level_count[level];
+}
+
+int spotflow_log_backend_get_record_payload(const struct spotflow_log_record* record,
+					    const uint8_t** data, size_t* len)
+{
+	if (!record->hdr.raw) {
+		*data = record->data;
+		*len = record->hdr.len;
+		return 0;
+	}
+
+#ifdef CONFIG_SPOTFLOW_LOG_LAZY_ENCODING
+	const struct spotflow_log_raw_record* raw_record =
+		(const struct spotflow_log_raw_record*)record->data;
+	size_t msg_len = record->hdr.len - sizeof(struct spotflow_log_raw_record);
+	if (msg_len > sizeof(lazy_log_msg)) {
+		return -EINVAL;
+	}
+
+	memcpy(lazy_log_msg, raw_record->log_msg, msg_len);
+
+	int rc = spotflow_cbor_encode_log((struct log_msg*)lazy_log_msg,
+					  raw_record->sequence_number, &lazy_output_context, len);
+	if (rc < 0) {
+		return rc;
+	}
+
+	*data = lazy_output_context.cbor_buf;
+	return 0;
+#else
+	return -ENOTSUP;
+#endif /* CONFIG_SPOTFLOW_LOG_LAZY_ENCODING */
+}
+
 static void init(const struct log_backend* const backend)
 {
 	LOG_DBG("Initializing spotflow logging backend");
@@ -78,9 +183,26 @@ static void init(const struct log_backend* const backend)
 	__ASSERT(backend->cb->ctx != NULL, "Spotflow log backend context is NULL");
 	struct spotflow_log_context* ctx = backend->cb->ctx;
 	ctx->cbor_output_context.cbor_len = 0;
-	ctx->cbor_output_context.log_msg_ctr = 0;
 	ctx->dropped_backend_count = 0;
+	memset(ctx->dropped_level_count, 0, sizeof(ctx->dropped_level_count));
 	ctx->message_index = 0;
+	ctx->panic_mode = false;
+
+	spotflow_log_buffer_init(log_record_dropped);
+
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+	ctx->suppressed_count = 0;
+	spotflow_log_rate_limit_init();
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
+
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+	ctx->coalesced_count = 0;
+	spotflow_log_coalesce_init();
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
+
+#ifdef CONFIG_SPOTFLOW_LOG_RETAINED
+	spotflow_log_retained_init();
+#endif /* CONFIG_SPOTFLOW_LOG_RETAINED */
 
 	spotflow_config_init();
 
@@ -91,55 +213,145 @@ static void init(const struct log_backend* const backend)
 
 static void process(const struct log_backend* const backend, union log_msg_generic* msg)
 {
-	struct log_msg* log_msg = &msg->log;
 	struct spotflow_log_context* ctx = backend->cb->ctx;
 	if (ctx == NULL) {
 		LOG_DBG("No spotflow log context");
 		return;
 	}
 
-	if (log_msg_get_level(log_msg) > spotflow_config_get_sent_log_level()) {
+#ifdef SUMMARY_WORK
+	/* The work item does not run after panic, when this can be an exception context */
+	if (!ctx->panic_mode) {
+		k_mutex_lock(&process_mutex, K_FOREVER);
+		process_message(ctx, &msg->log);
+		k_mutex_unlock(&process_mutex);
 		return;
 	}
+#endif /* SUMMARY_WORK */
 
-	uint8_t* cbor_data = NULL;
-	size_t cbor_data_len = 0;
-	int rc = spotflow_cbor_encode_log(log_msg, ctx->message_index, &ctx->cbor_output_context,
-					  &cbor_data, &cbor_data_len);
+	process_message(ctx, &msg->log);
+}
 
-	if (rc < 0) {
-		LOG_DBG("Failed to encode message: %d", rc);
-		process_single_message_stats_update(ctx, true /* dropped */);
+static void process_message(struct spotflow_log_context* ctx, struct log_msg* log_msg)
+{
+	uint8_t level = log_msg_get_level(log_msg);
+	if (level > spotflow_config_get_sent_log_level()) {
 		return;
 	}
 
-	/* Allocate memory for the message structure */
-	struct spotflow_mqtt_logs_msg* mqtt_msg = k_malloc(sizeof(struct spotflow_mqtt_logs_msg));
-	if (!mqtt_msg) {
-		LOG_DBG("Failed to allocate memory for message");
-		k_free(cbor_data);
-		process_single_message_stats_update(ctx, true /* dropped */);
+#ifdef CONFIG_SPOTFLOW_LOG_RETAINED
+	if (ctx->panic_mode) {
+		process_panic_message(ctx, log_msg, level);
+		return;
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_RETAINED */
+
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+	/* Repeated messages are only counted, they are neither formatted nor encoded */
+	if (spotflow_log_coalesce_check(log_msg)) {
+		ctx->coalesced_count++;
+		/* Does not postpone the work item if it is already scheduled */
+		k_work_schedule(&summary_work, K_MSEC(CONFIG_SPOTFLOW_LOG_COALESCING_WINDOW_MS));
+		return;
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
+
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+	/* Summaries of the previous interval are put before the message that triggered them */
+	spotflow_log_rate_limit_report(put_suppressed_summary, false /* force */);
+
+	/* Checked before encoding, so suppressed messages are not even formatted */
+	if (!spotflow_log_rate_limit_allow(log_msg_get_domain(log_msg),
+					   log_msg_get_source_id(log_msg))) {
+		ctx->suppressed_count++;
+		/* Does not postpone the work item if it is already scheduled */
+		k_work_schedule(&summary_work,
+				K_MSEC(CONFIG_SPOTFLOW_LOG_RATE_LIMIT_SUMMARY_INTERVAL_MS));
 		return;
 	}
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
+
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+	/* Run of the last sent message ends with a different message, its summary is put first */
+	flush_repeat_summary(ctx, true /* force */, NULL);
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
 
-	/* Set up the message */
-	mqtt_msg->payload = cbor_data;
-	mqtt_msg->len = cbor_data_len;
+	int rc = put_message(ctx, log_msg, level);
 
-	/* Enqueue the message (passing pointer) */
-	if (enqueue_log_msg(mqtt_msg, ctx) < 0) {
-		LOG_DBG("Unable to put message in queue, dropping");
-		k_free(mqtt_msg->payload);
-		k_free(mqtt_msg);
-		process_single_message_stats_update(ctx, true /* dropped */);
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+	/* Only messages in the buffer can be repeated, the others are not sent at all */
+	if (rc == 0) {
+		spotflow_log_coalesce_sent(log_msg);
+	}
+#else
+	ARG_UNUSED(rc);
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
+}
+
+static int put_message(struct spotflow_log_context* ctx, struct log_msg* log_msg, uint8_t level)
+{
+	int rc;
+
+#ifdef CONFIG_SPOTFLOW_LOG_LAZY_ENCODING
+	/* Formatting and encoding is left to the Spotflow processing thread */
+	rc = put_raw_message(ctx, log_msg, level);
+	if (rc != -E2BIG) {
+		return rc;
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_LAZY_ENCODING */
+
+	size_t cbor_data_len = 0;
+	rc = spotflow_cbor_encode_log(log_msg, ctx->message_index, &ctx->cbor_output_context,
+				      &cbor_data_len);
+
+	if (rc < 0) {
+		LOG_DBG("Failed to encode message: %d", rc);
+		process_single_message_stats_update(ctx, level, true /* dropped */);
+		return rc;
+	}
+
+	/* Copy the encoded message into the buffer, evicting the oldest ones if needed */
+	rc = spotflow_log_buffer_put(ctx->cbor_output_context.cbor_buf, cbor_data_len, level);
+	if (rc < 0) {
+		LOG_DBG("Unable to put message in buffer, dropping");
+		process_single_message_stats_update(ctx, level, true /* dropped */);
 	} else {
-		process_single_message_stats_update(ctx, false /* dropped */);
+		process_single_message_stats_update(ctx, level, false /* dropped */);
 	}
+
+	return rc;
 }
 
 static void panic(const struct log_backend* const backend)
 {
-	ARG_UNUSED(backend);
+	struct spotflow_log_context* ctx = backend->cb->ctx;
+	ctx->panic_mode = true;
+
+	spotflow_log_buffer_panic();
+
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+	/* There is no later report, the suppressed messages are reported right away */
+	spotflow_log_rate_limit_report(put_suppressed_summary, true /* force */);
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
+
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+	flush_repeat_summary(ctx, true /* force */, NULL);
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
+
+#ifdef CONFIG_SPOTFLOW_LOG_RETAINED
+	spotflow_log_retained_begin(spotflow_session_metadata_get_device_run_id());
+
+	/* Messages not sent yet are retained first, the messages flushed after panic are newer */
+	const struct spotflow_log_record* record;
+	while ((record = spotflow_log_buffer_claim()) != NULL) {
+		const uint8_t* data;
+		size_t len;
+		if (spotflow_log_backend_get_record_payload(record, &data, &len) == 0) {
+			spotflow_log_retained_append(data, len);
+		}
+		spotflow_log_buffer_release();
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_RETAINED */
 }
 
 static void dropped(const struct log_backend* const backend, uint32_t cnt)
@@ -147,62 +359,186 @@ static void dropped(const struct log_backend* const backend, uint32_t cnt)
 	/* Message did not reached the process function, dropping by zephyr middleware. */
 	/* Currently, we do not distinguish between backend and middleware drops. */
 	struct spotflow_log_context* ctx = backend->cb->ctx;
+	ctx->dropped_level_count[LOG_LEVEL_NONE] += cnt;
 	process_message_stats_update(ctx, cnt, true /* dropped */);
 }
 
-static int drop_log_msg_from_queue(struct spotflow_log_context* ctx);
+static void log_record_dropped(const struct spotflow_log_record* record)
+{
+	if (record->hdr.level < ARRAY_SIZE(spotflow_log_ctx.dropped_level_count)) {
+		spotflow_log_ctx.dropped_level_count[record->hdr.level]++;
+	}
 
-/* Helper that will drop & free the oldest if queue is full */
-static int enqueue_log_msg(const struct spotflow_mqtt_logs_msg* msg,
-			   struct spotflow_log_context* ctx)
+	/* not optimal, in edge case dropped_backend_count could overflow
+	but it is unlikely because message_index was already increased when added to buffer,
+	only statistic, keeping it as is */
+	spotflow_log_ctx.dropped_backend_count++;
+	/* currently not logged because it is messing up the output significantly */
+	/*LOG_DBG("Dropped oldest message");*/
+}
+
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+static void put_suppressed_summary(int16_t source_id, uint32_t suppressed_count)
 {
-	int rc = k_msgq_put(&g_spotflow_logs_msgq, &msg, K_NO_WAIT);
-	if (rc == -ENOMSG) {
-		/* queue full: grab the oldest pointer, free it */
-		rc = drop_log_msg_from_queue(ctx);
-		if (rc == 0) {
-			/* now there should be room for the new one */
-			rc = k_msgq_put(&g_spotflow_logs_msgq, &msg, K_NO_WAIT);
-		} else {
-			LOG_DBG("Failed to get message from queue %d", rc);
-		}
+	struct spotflow_log_context* ctx = &spotflow_log_ctx;
+	size_t cbor_data_len = 0;
+
+	int rc = spotflow_cbor_encode_suppressed_summary(source_id, suppressed_count,
+							 ctx->message_index,
+							 &ctx->cbor_output_context, &cbor_data_len);
+	if (rc == 0) {
+		rc = spotflow_log_buffer_put(ctx->cbor_output_context.cbor_buf, cbor_data_len,
+					     LOG_LEVEL_WRN);
+	}
+
+	if (rc < 0) {
+		LOG_DBG("Unable to put suppressed messages summary in buffer: %d", rc);
+	}
+	process_single_message_stats_update(ctx, LOG_LEVEL_WRN, rc < 0 /* dropped */);
+}
+
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
+
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+static void put_repeat_summary(struct spotflow_log_context* context,
+			       const struct spotflow_log_repeat* repeat)
+{
+	size_t cbor_data_len = 0;
+
+	int rc = spotflow_cbor_encode_repeat_summary(repeat, context->message_index,
+						     &context->cbor_output_context, &cbor_data_len);
+	if (rc == 0) {
+		rc = spotflow_log_buffer_put(context->cbor_output_context.cbor_buf, cbor_data_len,
+					     repeat->level);
+	}
+
+	if (rc < 0) {
+		LOG_DBG("Unable to put repeated messages summary in buffer: %d", rc);
+	}
+	process_single_message_stats_update(context, repeat->level, rc < 0 /* dropped */);
+}
+
+/* Puts the summary of the pending run if it has ended, next_flush_ms can be NULL */
+static void flush_repeat_summary(struct spotflow_log_context* context, bool force,
+				 int32_t* next_flush_ms)
+{
+	struct spotflow_log_repeat ended_run;
+	int32_t next_ms = spotflow_log_coalesce_flush(&ended_run, force);
+	if (ended_run.repeat_count > 0) {
+		put_repeat_summary(context, &ended_run);
+	}
+
+	if (next_flush_ms != NULL) {
+		*next_flush_ms = next_ms;
 	}
-	return rc;
 }
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
 
-static int drop_log_msg_from_queue(struct spotflow_log_context* ctx)
+#ifdef SUMMARY_WORK
+static void summary_work_handler(struct k_work* work)
 {
-	char* old;
-	int rc = k_msgq_get(&g_spotflow_logs_msgq, &old, K_NO_WAIT);
+	ARG_UNUSED(work);
+
+	int32_t next_ms = SYS_FOREVER_MS;
+
+	k_mutex_lock(&process_mutex, K_FOREVER);
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+	next_ms = spotflow_log_rate_limit_report(put_suppressed_summary, false /* force */);
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+	int32_t next_flush_ms;
+	flush_repeat_summary(&spotflow_log_ctx, false /* force */, &next_flush_ms);
+	if (next_ms == SYS_FOREVER_MS ||
+	    (next_flush_ms != SYS_FOREVER_MS && next_flush_ms < next_ms)) {
+		next_ms = next_flush_ms;
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
+	k_mutex_unlock(&process_mutex);
+
+	/* Summaries put by the messages processed meanwhile delay the next ones */
+	if (next_ms != SYS_FOREVER_MS) {
+		k_work_schedule(&summary_work, K_MSEC(next_ms));
+	}
+}
+#endif /* SUMMARY_WORK */
+
+#ifdef CONFIG_SPOTFLOW_LOG_RETAINED
+/* Encodes the message flushed after panic into the retained memory, uploaded after reboot */
+static void process_panic_message(struct spotflow_log_context* context, struct log_msg* log_msg,
+				  uint8_t level)
+{
+	size_t cbor_data_len = 0;
+	int rc = spotflow_cbor_encode_log(log_msg, context->message_index,
+					  &context->cbor_output_context, &cbor_data_len);
 	if (rc == 0) {
-		struct spotflow_mqtt_logs_msg* old_msg = (struct spotflow_mqtt_logs_msg*)old;
-		k_free(old_msg->payload);
-		k_free(old_msg);
+		rc = spotflow_log_retained_append(context->cbor_output_context.cbor_buf,
+						  cbor_data_len);
+	}
 
-		/* not optimal, in edge case dropped_backend_count could overflow
-		but it is unlikely because message_index was already increased when added to buffer,
-		only statistic, keeping it as is */
-		ctx->dropped_backend_count++;
-		/* currently not logged because it is messing up the output significantly */
-		/*LOG_DBG("Dropped oldest message");*/
+	process_single_message_stats_update(context, level, rc < 0 /* dropped */);
+}
+#endif /* CONFIG_SPOTFLOW_LOG_RETAINED */
+
+#ifdef CONFIG_SPOTFLOW_LOG_LAZY_ENCODING
+/*
+ * Copies the message into the buffer as it is, returns -E2BIG if it is too large to be encoded
+ * later, so it is encoded right away instead. Other errors mean the message was dropped.
+ */
+static int put_raw_message(struct spotflow_log_context* context, struct log_msg* log_msg,
+			   uint8_t level)
+{
+	size_t msg_len = log_msg_get_total_wlen(log_msg->hdr.desc) * sizeof(uint32_t);
+	if (msg_len > SPOTFLOW_LOG_RAW_MSG_MAX_LEN) {
+		return -E2BIG;
 	}
+
+	int rc = spotflow_log_buffer_put_raw(log_msg, msg_len, context->message_index, level);
+	if (rc < 0) {
+		LOG_DBG("Unable to put raw message in buffer, dropping");
+	}
+	process_single_message_stats_update(context, level, rc < 0 /* dropped */);
+
 	return rc;
 }
+#endif /* CONFIG_SPOTFLOW_LOG_LAZY_ENCODING */
 
 static inline void print_stat(const struct spotflow_log_context* context)
 {
 	LOG_DBG("Total processed %" PRIu32 ", dropped %" PRIu32 " messages", context->message_index,
 		context->dropped_backend_count);
+	LOG_DBG("Dropped by level: err %zu, wrn %zu, inf %zu, dbg %zu",
+		context->dropped_level_count[LOG_LEVEL_ERR],
+		context->dropped_level_count[LOG_LEVEL_WRN],
+		context->dropped_level_count[LOG_LEVEL_INF],
+		context->dropped_level_count[LOG_LEVEL_DBG]);
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+	LOG_DBG("Suppressed by rate limiting %zu messages", context->suppressed_count);
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+	LOG_DBG("Coalesced %zu repeated messages", context->coalesced_count);
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
 }
 
 static inline void reset_stat(struct spotflow_log_context* context)
 {
 	context->message_index = 0;
 	context->dropped_backend_count = 0;
+	memset(context->dropped_level_count, 0, sizeof(context->dropped_level_count));
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+	context->suppressed_count = 0;
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+	context->coalesced_count = 0;
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
 }
 
-static void process_single_message_stats_update(struct spotflow_log_context* context, bool dropped)
+static void process_single_message_stats_update(struct spotflow_log_context* context,
+						uint8_t level, bool dropped)
 {
+	if (dropped && level < ARRAY_SIZE(context->dropped_level_count)) {
+		context->dropped_level_count[level]++;
+	}
+
 	process_message_stats_update(context, 1, dropped);
 }
 
@@ -8,15 +8,36 @@ extern "C" {
 #include <stddef.h>
 #include <stdint.h>
 
-struct spotflow_mqtt_logs_msg {
-	uint8_t* payload;
-	size_t len;
-};
-
-extern struct k_msgq g_spotflow_logs_msgq;
+#include "logging/spotflow_log_buffer.h"
 
 void spotflow_log_backend_try_set_runtime_filter(uint32_t level);
 
+/**
+ * @brief Get the number of messages dropped by the backend since the last statistics reset
+ *
+ * @param level Log level of the messages (LOG_LEVEL_ERR to LOG_LEVEL_DBG), LOG_LEVEL_NONE
+ *              for messages dropped by Zephyr before reaching the backend
+ *
+ * @return Number of dropped messages
+ */
+size_t spotflow_log_backend_get_dropped_count(uint8_t level);
+
+/**
+ * @brief Get the encoded message of a record claimed from the log buffer
+ *
+ * Raw records (CONFIG_SPOTFLOW_LOG_LAZY_ENCODING) are formatted and encoded into a static
+ * buffer, which is valid until the next call. Must be called only from the Spotflow processing
+ * thread, or from the panic context.
+ *
+ * @param record Claimed record
+ * @param data Encoded message
+ * @param len Length of the encoded message in bytes
+ *
+ * @return 0 on success, negative errno if the raw message cannot be encoded
+ */
+int spotflow_log_backend_get_record_payload(const struct spotflow_log_record* record,
+					    const uint8_t** data, size_t* len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,362 @@
+#include "spotflow_log_buffer.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/mpsc_pbuf.h>
+
+#ifdef CONFIG_SPOTFLOW_LOG_SPOOL
+#include "spotflow_log_spool.h"
+#endif /* CONFIG_SPOTFLOW_LOG_SPOOL */
+
+LOG_MODULE_DECLARE(spotflow_logging, CONFIG_SPOTFLOW_LOGS_PROCESSING_LOG_LEVEL);
+
+#define LOG_BUFFER_WLEN(size) DIV_ROUND_UP(size, sizeof(uint32_t))
+/* Storage of a disabled reserved ring is never used, it only must not be empty */
+#define RESERVED_BUFFER_WLEN(size) LOG_BUFFER_WLEN(MAX(size, 1))
+/* Records moved to a reserved ring are followed by the index of their eviction */
+#define EVICTION_INDEX_WLEN 1
+
+#ifdef CONFIG_SPOTFLOW_LOG_LAZY_ENCODING
+#define RECORD_PAYLOAD_MAX_LEN                                                                     \
+	MAX(CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN,                                                      \
+	    sizeof(struct spotflow_log_raw_record) + SPOTFLOW_LOG_RAW_MSG_MAX_LEN)
+#else
+#define RECORD_PAYLOAD_MAX_LEN CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN
+#endif /* CONFIG_SPOTFLOW_LOG_LAZY_ENCODING */
+#define RESERVED_RECORD_MAX_LEN                                                                    \
+	(sizeof(struct spotflow_log_record_hdr) + RECORD_PAYLOAD_MAX_LEN +                         \
+	 EVICTION_INDEX_WLEN * sizeof(uint32_t))
+/* An enabled reserved ring smaller than the largest record would drop it on every attempt */
+#define RESERVED_BUFFER_SIZE_VALID(size) ((size) == 0 || (size) >= RESERVED_RECORD_MAX_LEN)
+
+/* The largest record must always fit, otherwise it would be dropped on every attempt */
+BUILD_ASSERT(CONFIG_SPOTFLOW_LOG_BACKEND_BUFFER_SIZE >=
+		     sizeof(struct spotflow_log_record_hdr) + RECORD_PAYLOAD_MAX_LEN,
+	     "CONFIG_SPOTFLOW_LOG_BACKEND_BUFFER_SIZE must hold the largest log record");
+
+BUILD_ASSERT(LOG_LEVEL_DBG < BIT(SPOTFLOW_LOG_RECORD_LEVEL_BITS),
+	     "Log level does not fit into the record header");
+
+BUILD_ASSERT(RESERVED_BUFFER_SIZE_VALID(CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_ERR_SIZE),
+	     "CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_ERR_SIZE must be 0 or hold the largest log");
+BUILD_ASSERT(RESERVED_BUFFER_SIZE_VALID(CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_WRN_SIZE),
+	     "CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_WRN_SIZE must be 0 or hold the largest log");
+BUILD_ASSERT(RESERVED_BUFFER_SIZE_VALID(CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_INF_SIZE),
+	     "CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_INF_SIZE must be 0 or hold the largest log");
+
+static uint32_t buffer_storage[LOG_BUFFER_WLEN(CONFIG_SPOTFLOW_LOG_BACKEND_BUFFER_SIZE)];
+static uint32_t reserved_err_storage[RESERVED_BUFFER_WLEN(
+	CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_ERR_SIZE)];
+static uint32_t reserved_wrn_storage[RESERVED_BUFFER_WLEN(
+	CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_WRN_SIZE)];
+static uint32_t reserved_inf_storage[RESERVED_BUFFER_WLEN(
+	CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_INF_SIZE)];
+
+/* Reserved capacity for records evicted from the main buffer, debug logs have none */
+struct reserved_buffer {
+	struct mpsc_pbuf_buffer buffer;
+	uint32_t* storage;
+	size_t size;
+	bool enabled;
+	/* Oldest record of the ring, claimed until the older records of other rings are sent */
+	const union mpsc_pbuf_generic* head;
+};
+
+static struct mpsc_pbuf_buffer log_buffer;
+static struct reserved_buffer reserved_buffers[] = {
+	[LOG_LEVEL_ERR] = {
+		.storage = reserved_err_storage,
+		.size = CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_ERR_SIZE,
+	},
+	[LOG_LEVEL_WRN] = {
+		.storage = reserved_wrn_storage,
+		.size = CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_WRN_SIZE,
+	},
+	[LOG_LEVEL_INF] = {
+		.storage = reserved_inf_storage,
+		.size = CONFIG_SPOTFLOW_LOG_BACKEND_RESERVED_INF_SIZE,
+	},
+};
+
+static spotflow_log_buffer_drop_cb log_buffer_drop_cb;
+
+/* Orders the records in the reserved rings, they are claimed in the order of their eviction */
+static uint32_t eviction_index;
+
+/* Record claimed by the processing thread, kept until it is successfully published */
+static struct mpsc_pbuf_buffer* claimed_buffer;
+static struct reserved_buffer* claimed_reserved;
+static const union mpsc_pbuf_generic* claimed_record;
+#ifdef CONFIG_SPOTFLOW_LOG_SPOOL
+static bool claimed_from_spool;
+#endif /* CONFIG_SPOTFLOW_LOG_SPOOL */
+
+/* After panic, the records are only drained from memory, the flash spool is not used */
+static bool panic_mode;
+
+static struct spotflow_log_record* alloc_record(struct mpsc_pbuf_buffer* buffer, size_t len,
+						uint8_t level, bool raw, size_t trailer_wlen);
+static uint32_t get_record_wlen(const union mpsc_pbuf_generic* packet);
+static uint32_t get_reserved_record_wlen(const union mpsc_pbuf_generic* packet);
+static uint32_t get_eviction_index(const union mpsc_pbuf_generic* packet);
+static struct reserved_buffer* claim_oldest_reserved(void);
+static void notify_record_evicted(const struct mpsc_pbuf_buffer* buffer,
+				  const union mpsc_pbuf_generic* packet);
+static void notify_record_dropped(const struct mpsc_pbuf_buffer* buffer,
+				  const union mpsc_pbuf_generic* packet);
+
+void spotflow_log_buffer_init(spotflow_log_buffer_drop_cb drop_cb)
+{
+	const struct mpsc_pbuf_buffer_config config = {
+		.buf = buffer_storage,
+		.size = ARRAY_SIZE(buffer_storage),
+		.notify_drop = notify_record_evicted,
+		.get_wlen = get_record_wlen,
+		.flags = MPSC_PBUF_MODE_OVERWRITE,
+	};
+
+	log_buffer_drop_cb = drop_cb;
+	eviction_index = 0;
+	claimed_buffer = NULL;
+	claimed_reserved = NULL;
+	claimed_record = NULL;
+	mpsc_pbuf_init(&log_buffer, &config);
+
+	for (size_t level = 0; level < ARRAY_SIZE(reserved_buffers); level++) {
+		struct reserved_buffer* reserved = &reserved_buffers[level];
+		reserved->enabled = reserved->size > 0;
+		reserved->head = NULL;
+		if (!reserved->enabled) {
+			continue;
+		}
+
+		const struct mpsc_pbuf_buffer_config reserved_config = {
+			.buf = reserved->storage,
+			.size = LOG_BUFFER_WLEN(reserved->size),
+			.notify_drop = notify_record_dropped,
+			.get_wlen = get_reserved_record_wlen,
+			.flags = MPSC_PBUF_MODE_OVERWRITE,
+		};
+		mpsc_pbuf_init(&reserved->buffer, &reserved_config);
+	}
+}
+
+int spotflow_log_buffer_put(const uint8_t* data, size_t len, uint8_t level)
+{
+	if (data == NULL || len == 0) {
+		return -EINVAL;
+	}
+
+	struct spotflow_log_record* record = alloc_record(&log_buffer, len, level, false, 0);
+	if (record == NULL) {
+		return -ENOMEM;
+	}
+
+	memcpy(record->data, data, len);
+	mpsc_pbuf_commit(&log_buffer, (union mpsc_pbuf_generic*)record);
+	return 0;
+}
+
+#ifdef CONFIG_SPOTFLOW_LOG_LAZY_ENCODING
+int spotflow_log_buffer_put_raw(const void* log_msg, size_t len, uint32_t sequence_number,
+				uint8_t level)
+{
+	if (log_msg == NULL || len == 0) {
+		return -EINVAL;
+	}
+
+	struct spotflow_log_record* record = alloc_record(
+		&log_buffer, sizeof(struct spotflow_log_raw_record) + len, level, true, 0);
+	if (record == NULL) {
+		return -ENOMEM;
+	}
+
+	struct spotflow_log_raw_record* raw_record = (struct spotflow_log_raw_record*)record->data;
+	raw_record->sequence_number = sequence_number;
+	memcpy(raw_record->log_msg, log_msg, len);
+	mpsc_pbuf_commit(&log_buffer, (union mpsc_pbuf_generic*)record);
+	return 0;
+}
+#endif /* CONFIG_SPOTFLOW_LOG_LAZY_ENCODING */
+
+const struct spotflow_log_record* spotflow_log_buffer_claim(void)
+{
+	if (claimed_record != NULL) {
+		return (const struct spotflow_log_record*)claimed_record;
+	}
+
+#ifdef CONFIG_SPOTFLOW_LOG_SPOOL
+	if (claimed_from_spool) {
+		return spotflow_log_spool_claim();
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_SPOOL */
+
+	/* Records in the reserved buffers were evicted from the main one, so they are older */
+	struct reserved_buffer* reserved = claim_oldest_reserved();
+	if (reserved != NULL) {
+		claimed_reserved = reserved;
+		claimed_buffer = &reserved->buffer;
+		claimed_record = reserved->head;
+		return (const struct spotflow_log_record*)claimed_record;
+	}
+
+#ifdef CONFIG_SPOTFLOW_LOG_SPOOL
+	/* Spooled records are older, but they are replayed at a limited rate between the newer ones */
+	const struct spotflow_log_record* spooled_record =
+		panic_mode ? NULL : spotflow_log_spool_claim();
+	if (spooled_record != NULL) {
+		claimed_from_spool = true;
+		return spooled_record;
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_SPOOL */
+
+	claimed_record = mpsc_pbuf_claim(&log_buffer);
+	claimed_buffer = &log_buffer;
+
+	return (const struct spotflow_log_record*)claimed_record;
+}
+
+void spotflow_log_buffer_release(void)
+{
+#ifdef CONFIG_SPOTFLOW_LOG_SPOOL
+	if (claimed_from_spool) {
+		spotflow_log_spool_release();
+		claimed_from_spool = false;
+		return;
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_SPOOL */
+
+	if (claimed_record == NULL) {
+		return;
+	}
+
+	mpsc_pbuf_free(claimed_buffer, claimed_record);
+	if (claimed_reserved != NULL) {
+		claimed_reserved->head = NULL;
+		claimed_reserved = NULL;
+	}
+	claimed_record = NULL;
+	claimed_buffer = NULL;
+}
+
+void spotflow_log_buffer_panic(void)
+{
+	panic_mode = true;
+
+#ifdef CONFIG_SPOTFLOW_LOG_SPOOL
+	/* Spooled record claimed by the dead processing thread stays in the spool */
+	claimed_from_spool = false;
+#endif /* CONFIG_SPOTFLOW_LOG_SPOOL */
+}
+
+/*
+ * Allocated record must be committed by mpsc_pbuf_commit() once its payload is written,
+ * trailer_wlen words are allocated after the payload
+ */
+static struct spotflow_log_record* alloc_record(struct mpsc_pbuf_buffer* buffer, size_t len,
+						uint8_t level, bool raw, size_t trailer_wlen)
+{
+	size_t wlen = DIV_ROUND_UP(sizeof(struct spotflow_log_record_hdr) + len, sizeof(uint32_t)) +
+		      trailer_wlen;
+
+	/* In overwrite mode, the oldest records are evicted until the new one fits */
+	union mpsc_pbuf_generic* packet = mpsc_pbuf_alloc(buffer, wlen, K_NO_WAIT);
+	if (packet == NULL) {
+		LOG_DBG("Log message of %zu bytes does not fit into the buffer", len);
+		return NULL;
+	}
+
+	struct spotflow_log_record* record = (struct spotflow_log_record*)packet;
+	record->hdr.level = level;
+	record->hdr.raw = raw;
+	record->hdr.len = len;
+
+	return record;
+}
+
+static uint32_t get_record_wlen(const union mpsc_pbuf_generic* packet)
+{
+	const struct spotflow_log_record* record = (const struct spotflow_log_record*)packet;
+
+	return DIV_ROUND_UP(sizeof(struct spotflow_log_record_hdr) + record->hdr.len,
+			    sizeof(uint32_t));
+}
+
+static uint32_t get_reserved_record_wlen(const union mpsc_pbuf_generic* packet)
+{
+	return get_record_wlen(packet) + EVICTION_INDEX_WLEN;
+}
+
+static uint32_t get_eviction_index(const union mpsc_pbuf_generic* packet)
+{
+	return ((const uint32_t*)packet)[get_record_wlen(packet)];
+}
+
+/* Claims the heads of all the reserved rings and returns the ring whose head was evicted first */
+static struct reserved_buffer* claim_oldest_reserved(void)
+{
+	struct reserved_buffer* oldest = NULL;
+
+	for (size_t level = 0; level < ARRAY_SIZE(reserved_buffers); level++) {
+		struct reserved_buffer* reserved = &reserved_buffers[level];
+		if (!reserved->enabled) {
+			continue;
+		}
+
+		if (reserved->head == NULL) {
+			reserved->head = mpsc_pbuf_claim(&reserved->buffer);
+		}
+		if (reserved->head == NULL) {
+			continue;
+		}
+
+		/* The difference is compared, so the order is kept when the index wraps around */
+		if (oldest == NULL || (int32_t)(get_eviction_index(reserved->head) -
+						get_eviction_index(oldest->head)) < 0) {
+			oldest = reserved;
+		}
+	}
+
+	return oldest;
+}
+
+/* Moves the record evicted from the main buffer to the spool or reserved capacity of its level */
+static void notify_record_evicted(const struct mpsc_pbuf_buffer* buffer,
+				  const union mpsc_pbuf_generic* packet)
+{
+	const struct spotflow_log_record* record = (const struct spotflow_log_record*)packet;
+
+	/* The evicted record is not overwritten until the allocation that evicted it returns */
+#ifdef CONFIG_SPOTFLOW_LOG_SPOOL
+	/* Spooling all the evicted records keeps them in order, reserved capacity is a fallback */
+	if (!panic_mode && spotflow_log_spool_store(record) == 0) {
+		return;
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_SPOOL */
+
+	if (record->hdr.level < ARRAY_SIZE(reserved_buffers) &&
+	    reserved_buffers[record->hdr.level].enabled) {
+		struct mpsc_pbuf_buffer* reserved = &reserved_buffers[record->hdr.level].buffer;
+		struct spotflow_log_record* moved =
+			alloc_record(reserved, record->hdr.len, record->hdr.level, record->hdr.raw,
+				     EVICTION_INDEX_WLEN);
+		if (moved != NULL) {
+			memcpy(moved->data, record->data, record->hdr.len);
+			((uint32_t*)moved)[get_record_wlen(packet)] = eviction_index++;
+			mpsc_pbuf_commit(reserved, (union mpsc_pbuf_generic*)moved);
+			return;
+		}
+	}
+
+	notify_record_dropped(buffer, packet);
+}
+
+static void notify_record_dropped(const struct mpsc_pbuf_buffer* buffer,
+				  const union mpsc_pbuf_generic* packet)
+{
+	ARG_UNUSED(buffer);
+
+	if (log_buffer_drop_cb != NULL) {
+		log_buffer_drop_cb((const struct spotflow_log_record*)packet);
+	}
+}
@@ -0,0 +1,135 @@
+#ifndef SPOTFLOW_LOG_BUFFER_H
+#define SPOTFLOW_LOG_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/sys/mpsc_pbuf.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPOTFLOW_LOG_RECORD_LEVEL_BITS 3
+
+/* Larger raw log messages are encoded right away (CONFIG_SPOTFLOW_LOG_LAZY_ENCODING) */
+#define SPOTFLOW_LOG_RAW_MSG_MAX_LEN CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN
+
+/**
+ * @brief Header of a record stored in the log buffer
+ *
+ * The first two bits are owned by mpsc_pbuf, the rest holds the log level of the message,
+ * whether the payload is a raw log message and the payload length in bytes.
+ */
+struct spotflow_log_record_hdr {
+	MPSC_PBUF_HDR;
+	uint32_t level : SPOTFLOW_LOG_RECORD_LEVEL_BITS;
+	uint32_t raw : 1;
+	uint32_t len : 32 - MPSC_PBUF_HDR_BITS - SPOTFLOW_LOG_RECORD_LEVEL_BITS - 1;
+};
+
+/**
+ * @brief Variable-length record stored in the log buffer
+ *
+ * The payload is an encoded CBOR message ready to be published, or a raw log message
+ * (struct spotflow_log_raw_record) to be encoded when it is claimed
+ * (CONFIG_SPOTFLOW_LOG_LAZY_ENCODING).
+ */
+struct spotflow_log_record {
+	struct spotflow_log_record_hdr hdr;
+	uint8_t data[];
+};
+
+/**
+ * @brief Payload of a raw record, a copy of the log message with its sequence number
+ *
+ * The copy is not aligned as a log message, it must be copied to an aligned buffer before
+ * it is accessed as struct log_msg.
+ */
+struct spotflow_log_raw_record {
+	uint32_t sequence_number;
+	uint8_t log_msg[];
+};
+
+/**
+ * @brief Callback invoked for every record evicted to make room for a newer one
+ */
+typedef void (*spotflow_log_buffer_drop_cb)(const struct spotflow_log_record* record);
+
+/**
+ * @brief Initialize the log buffer
+ *
+ * Must be called before any other function of this module.
+ *
+ * @param drop_cb Callback invoked for evicted records (can be NULL)
+ */
+void spotflow_log_buffer_init(spotflow_log_buffer_drop_cb drop_cb);
+
+/**
+ * @brief Copy an encoded message into the log buffer
+ *
+ * If the buffer is full, the oldest records are evicted to make room for the new one.
+ * Evicted records are moved to the flash spool if it is enabled. Otherwise, evicted records
+ * with a reserved capacity for their log level are moved there instead, so they are dropped
+ * only when the reserved capacity is exhausted by newer records.
+ *
+ * @param data Encoded message
+ * @param len Length of the encoded message in bytes
+ * @param level Log level of the message (LOG_LEVEL_ERR to LOG_LEVEL_DBG)
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Invalid parameters
+ *         -ENOMEM: Message does not fit into the buffer
+ */
+int spotflow_log_buffer_put(const uint8_t* data, size_t len, uint8_t level);
+
+#ifdef CONFIG_SPOTFLOW_LOG_LAZY_ENCODING
+/**
+ * @brief Copy a raw log message into the log buffer, to be encoded when it is sent
+ *
+ * Records are evicted the same way as by spotflow_log_buffer_put().
+ *
+ * @param log_msg Log message
+ * @param len Total length of the log message in bytes
+ * @param sequence_number Sequence number assigned to the message
+ * @param level Log level of the message (LOG_LEVEL_ERR to LOG_LEVEL_DBG)
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Invalid parameters
+ *         -ENOMEM: Message does not fit into the buffer
+ */
+int spotflow_log_buffer_put_raw(const void* log_msg, size_t len, uint32_t sequence_number,
+				uint8_t level);
+#endif /* CONFIG_SPOTFLOW_LOG_LAZY_ENCODING */
+
+/**
+ * @brief Get the oldest record without removing it from the buffer
+ *
+ * Records moved to the reserved capacity are older than the other ones and they are returned
+ * first, in the order in which they were evicted. Records moved to the flash spool
+ * (CONFIG_SPOTFLOW_LOG_SPOOL) are returned next, but at most at the configured replay rate.
+ * The same record is returned by subsequent calls until spotflow_log_buffer_release()
+ * is called. Must be called only from the Spotflow processing thread.
+ *
+ * @return Oldest record, NULL if the buffer is empty
+ */
+const struct spotflow_log_record* spotflow_log_buffer_claim(void);
+
+/**
+ * @brief Remove the record returned by spotflow_log_buffer_claim() from the buffer
+ */
+void spotflow_log_buffer_release(void);
+
+/**
+ * @brief Switch the buffer to panic mode
+ *
+ * Afterwards, the records can be drained by spotflow_log_buffer_claim() from the panic context.
+ * Records in the flash spool are not returned and evicted records are not spooled anymore.
+ */
+void spotflow_log_buffer_panic(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPOTFLOW_LOG_BUFFER_H */
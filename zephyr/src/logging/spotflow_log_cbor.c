@@ -1,9 +1,20 @@
 #include "spotflow_log_cbor.h"
 
+#include <stdarg.h>
+#include <string.h>
+
 #include <zcbor_common.h>
 #include <zcbor_encode.h>
 
+#include <zephyr/kernel.h>
+
 #include "spotflow_cbor_output_context.h"
+#if CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING
+#include "spotflow_log_template.h"
+#endif /* CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING */
+#ifdef CONFIG_SPOTFLOW_LOG_DICTIONARY
+#include "spotflow_log_dictionary.h"
+#endif /* CONFIG_SPOTFLOW_LOG_DICTIONARY */
 #include "zephyr/logging/log.h"
 #include "zephyr/logging/log_core.h"
 #include "zephyr/logging/log_ctrl.h"
@@ -15,37 +26,103 @@ LOG_MODULE_DECLARE(spotflow_logging, CONFIG_SPOTFLOW_LOGS_PROCESSING_LOG_LEVEL);
 #define LOGS_MESSAGE_TYPE 0x00
 #define KEY_BODY 0x01
 #define KEY_BODY_TEMPLATE 0x02
-/* (unused for now) */
 #define KEY_BODY_TEMPLATE_VALUES 0x03
 #define KEY_SEVERITY 0x04
 #define KEY_LABELS 0x05
 #define KEY_DEVICE_UPTIME_MS 0x06
 #define KEY_SEQUENCE_NUMBER 0x0D
+#define KEY_BODY_TEMPLATE_ID 0x20
+#define KEY_SOURCE_ID 0x21
+#define KEY_REPEAT_COUNT 0x23
+#define KEY_FIRST_DEVICE_UPTIME_MS 0x24
 
 #define ZCBOR_STATE_DEPTH 2
 
+#if CONFIG_SPOTFLOW_LOG_INCLUDE_BODY_TEMPLATE || CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING
+#define SEND_BODY_TEMPLATE 1
+#endif
+
+#ifdef SEND_BODY_TEMPLATE
+/* type, sequence number, severity, uptime, labels, body or template values and template */
+#define MAP_KEY_VALUE_PAIRS 7
+#else
+#define MAP_KEY_VALUE_PAIRS 6
+#endif
+
+#if defined(CONFIG_SPOTFLOW_LOG_RATE_LIMIT) || defined(CONFIG_SPOTFLOW_LOG_COALESCING)
+/* Logs generated by the backend itself, with a short plain text body */
+#define ENCODE_SUMMARY_LOGS 1
+/* type, sequence number, severity, uptime, labels and body */
+#define SUMMARY_MAP_KEY_VALUE_PAIRS 6
+/* repeat count and uptime of the first repeated message */
+#define REPEAT_MAP_KEY_VALUE_PAIRS 2
+#define SUMMARY_BODY_MAX_LEN 64
+#endif
+
+#if CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING
+/* Upper bound on the number of template values, needed only for canonical encoding */
+#define TEMPLATE_VALUES_MAX_COUNT UINT8_MAX
+#endif /* CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING */
+
+/* Text string header with up to 2 bytes of length, reserved before the length is known */
+#define BODY_HEADER_MAX_LEN 3
+/* End of the outer map following the body */
+#define BODY_TRAILER_LEN 1
+
+BUILD_ASSERT(CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN <= UINT16_MAX,
+	     "Length of the log body must fit into the reserved text string header");
+
 struct message_metadata {
 	uint32_t severity;
 	uint32_t uptime_ms;
 	size_t sequence_number;
 	const char* source;
+	/* IDs of the strings in the log dictionary, negative if sent inline */
+	int source_id;
+	int template_id;
 };
 
-static int encode_cbor_spotflow(const struct message_metadata* metadata,
-				const char* formatted_message, const char* message_template,
-				uint8_t buf[], size_t* encoded_len);
-static int get_formatted_message(struct spotflow_cbor_output_context* output_context,
-				 uint8_t* package);
+#if CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING
+static int encode_template_value(const struct spotflow_template_value* value, void* ctx);
+static int encode_template_values(cbprintf_cb out, void* ctx, const char* fmt, va_list ap);
+#endif /* CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING */
+
+/* Destination of the formatted body written directly into the CBOR buffer */
+struct body_output {
+	uint8_t* pos;
+	const uint8_t* end;
+	bool truncated;
+};
+
+static int encode_body(zcbor_state_t* state, uint8_t* package);
+static int encode_cbor_spotflow(const struct message_metadata* metadata, uint8_t* package,
+				const char* message_template, bool format_body, uint8_t buf[],
+				size_t* encoded_len);
 static void extract_metadata(struct message_metadata* metadata, struct log_msg* log_msg,
 			     size_t sequence_number);
+static void lookup_dictionary_ids(struct message_metadata* metadata, const char* message_template,
+				  const uint8_t* package, size_t package_len);
+static int encode_message_metadata_to_cbor(const struct message_metadata* metadata,
+					   zcbor_state_t* state);
+#ifdef SEND_BODY_TEMPLATE
+static bool encode_body_template(const struct message_metadata* metadata,
+				 const char* message_template, zcbor_state_t* state);
+#endif /* SEND_BODY_TEMPLATE */
+#ifdef ENCODE_SUMMARY_LOGS
+static void init_summary_metadata(struct message_metadata* metadata, uint8_t level,
+				  uint32_t uptime_ms, uint8_t domain_id, int16_t source_id,
+				  size_t sequence_number);
+static int encode_summary_cbor(const struct message_metadata* metadata, const char* body,
+			       const struct spotflow_log_repeat* repeat, uint8_t buf[],
+			       size_t* encoded_len);
+#endif /* ENCODE_SUMMARY_LOGS */
 
 int spotflow_cbor_encode_log(struct log_msg* log_msg, size_t sequence_number,
 			     struct spotflow_cbor_output_context* output_context,
-			     uint8_t** cbor_data, size_t* cbor_data_len)
+			     size_t* cbor_data_len)
 {
 	__ASSERT(log_msg != NULL, "log_msg is NULL");
 	__ASSERT(output_context != NULL, "output_context is NULL");
-	__ASSERT(cbor_data != NULL, "cbor_data is NULL");
 	__ASSERT(cbor_data_len != NULL, "cbor_data_len is NULL");
 
 	struct message_metadata metadata;
@@ -55,69 +132,75 @@ int spotflow_cbor_encode_log(struct log_msg* log_msg, size_t sequence_number,
 	https://docs.zephyrproject.org/latest/services/formatted_output.html#cbprintf-package-format */
 	size_t plen;
 	uint8_t* package = log_msg_get_package(log_msg, &plen);
-	int rc = get_formatted_message(output_context, package);
-	if (rc < 0) {
-		LOG_DBG("Failed to get formatted message: %d", rc);
-		return rc;
-	}
 
 	/* get message template */
 	struct cbprintf_package_hdr_ext* hdr = (struct cbprintf_package_hdr_ext*)package;
 	const char* message_template = hdr->fmt;
 
-	size_t cbor_len;
-	rc = encode_cbor_spotflow(&metadata, output_context->log_msg, message_template,
-				  output_context->cbor_buf, &cbor_len);
+	lookup_dictionary_ids(&metadata, message_template, package, plen);
+
+	/* encoded message stays in output_context->cbor_buf until it is copied by the caller */
+	int rc = encode_cbor_spotflow(&metadata, package, message_template,
+				      !IS_ENABLED(CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING),
+				      output_context->cbor_buf, cbor_data_len);
+	if (rc == -ENOTSUP && IS_ENABLED(CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING)) {
+		/* Arguments of an unsupported conversion cannot be read, the body is formatted */
+		rc = encode_cbor_spotflow(&metadata, package, message_template,
+					  true /* format_body */, output_context->cbor_buf,
+					  cbor_data_len);
+	}
 	if (rc < 0) {
 		LOG_DBG("Failed to encode spotflow log message %d", rc);
 		return rc;
 	}
 
-	uint8_t* data = k_malloc(cbor_len);
-	if (!data) {
-		LOG_DBG("Failed to allocate memory for CBOR data");
-		return -ENOMEM;
-	}
-	/* Copy CBOR data */
-	memcpy(data, output_context->cbor_buf, cbor_len);
-
-	*cbor_data_len = cbor_len;
-	*cbor_data = data;
 	return 0;
 }
 
-static int cb_out(int c, void* output_ctx)
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+int spotflow_cbor_encode_suppressed_summary(int16_t source_id, uint32_t suppressed_count,
+					    size_t sequence_number,
+					    struct spotflow_cbor_output_context* output_context,
+					    size_t* cbor_data_len)
 {
-	__ASSERT(output_ctx != NULL, "output_ctx is NULL");
+	__ASSERT(output_context != NULL, "output_context is NULL");
+	__ASSERT(cbor_data_len != NULL, "cbor_data_len is NULL");
 
-	struct spotflow_cbor_output_context* ctx = (struct spotflow_cbor_output_context*)output_ctx;
-	if (ctx->log_msg_ctr >= CONFIG_SPOTFLOW_LOG_BUFFER_SIZE) {
-		return -ENOMEM;
-	}
-	ctx->log_msg[ctx->log_msg_ctr++] = (char)c;
-	return 0;
+	struct message_metadata metadata;
+	init_summary_metadata(&metadata, LOG_LEVEL_WRN, k_uptime_get_32(), Z_LOG_LOCAL_DOMAIN_ID,
+			      source_id, sequence_number);
+
+	char body[SUMMARY_BODY_MAX_LEN];
+	snprintk(body, sizeof(body), "%" PRIu32 " messages suppressed by rate limiting",
+		 suppressed_count);
+
+	return encode_summary_cbor(&metadata, body, NULL, output_context->cbor_buf,
+				   cbor_data_len);
 }
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
 
-static int get_formatted_message(struct spotflow_cbor_output_context* output_context,
-				 uint8_t* package)
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+int spotflow_cbor_encode_repeat_summary(const struct spotflow_log_repeat* repeat,
+					size_t sequence_number,
+					struct spotflow_cbor_output_context* output_context,
+					size_t* cbor_data_len)
 {
+	__ASSERT(repeat != NULL, "repeat is NULL");
 	__ASSERT(output_context != NULL, "output_context is NULL");
-	__ASSERT(package != NULL, "package is NULL");
-	output_context->log_msg_ctr = 0;
-	int rc = cbpprintf(cb_out, output_context, package);
-	if (output_context->log_msg_ctr >= CONFIG_SPOTFLOW_LOG_BUFFER_SIZE) {
-		LOG_DBG("Log message buffer overflow, total length: %zu bytes",
-			output_context->log_msg_ctr);
-		return -ENOMEM;
-	}
-	output_context->log_msg[output_context->log_msg_ctr++] = '\0';
-	if (rc < 0) {
-		LOG_DBG("cbprintf failed to format message: %d", rc);
-		return rc;
-	}
-	/* returning 0 because cbprintf returns the number of characters printed */
-	return 0;
+	__ASSERT(cbor_data_len != NULL, "cbor_data_len is NULL");
+
+	struct message_metadata metadata;
+	init_summary_metadata(&metadata, repeat->level, repeat->last_uptime_ms, repeat->domain_id,
+			      repeat->source_id, sequence_number);
+
+	char body[SUMMARY_BODY_MAX_LEN];
+	snprintk(body, sizeof(body), "Last message repeated %" PRIu32 " times",
+		 repeat->repeat_count);
+
+	return encode_summary_cbor(&metadata, body, repeat, output_context->cbor_buf,
+				   cbor_data_len);
 }
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
 
 /* Integer severity values */
 /* debug-severity = 30 */
@@ -181,6 +264,29 @@ static void extract_metadata(struct message_metadata* metadata, struct log_msg*
 	metadata->source = sname;
 }
 
+static void lookup_dictionary_ids(struct message_metadata* metadata, const char* message_template,
+				  const uint8_t* package, size_t package_len)
+{
+	metadata->source_id = -ENOENT;
+	metadata->template_id = -ENOENT;
+
+#ifdef CONFIG_SPOTFLOW_LOG_DICTIONARY
+	metadata->source_id = spotflow_log_dictionary_get_id(metadata->source);
+
+#ifdef SEND_BODY_TEMPLATE
+	/* Template copied into the package does not outlive the message, it is sent inline */
+	const uint8_t* template_addr = (const uint8_t*)message_template;
+	if (template_addr < package || template_addr >= package + package_len) {
+		metadata->template_id = spotflow_log_dictionary_get_id(message_template);
+	}
+#endif /* SEND_BODY_TEMPLATE */
+#else
+	ARG_UNUSED(message_template);
+	ARG_UNUSED(package);
+	ARG_UNUSED(package_len);
+#endif /* CONFIG_SPOTFLOW_LOG_DICTIONARY */
+}
+
 static int encode_message_metadata_to_cbor(const struct message_metadata* metadata,
 					   zcbor_state_t* state)
 {
@@ -194,6 +300,16 @@ static int encode_message_metadata_to_cbor(const struct message_metadata* metada
 	zcbor_uint32_put(state, KEY_DEVICE_UPTIME_MS);
 	zcbor_uint32_put(state, metadata->uptime_ms);
 
+	/* source already defined in the log dictionary is sent only as its ID */
+	if (metadata->source_id >= 0) {
+		zcbor_uint32_put(state, KEY_SOURCE_ID);
+		if (!zcbor_uint32_put(state, metadata->source_id)) {
+			LOG_DBG("Failed to encode source ID: %d", zcbor_peek_error(state));
+			return -EINVAL;
+		}
+		return 0;
+	}
+
 	/* labels → nested map with one element */
 	zcbor_uint32_put(state, KEY_LABELS);
 	zcbor_map_start_encode(state, 1);
@@ -208,17 +324,26 @@ static int encode_message_metadata_to_cbor(const struct message_metadata* metada
 	return 0;
 }
 
-static int encode_cbor_spotflow(const struct message_metadata* metadata,
-				const char* formatted_message, const char* message_template,
-				uint8_t buf[], size_t* encoded_len)
+#ifdef SEND_BODY_TEMPLATE
+static bool encode_body_template(const struct message_metadata* metadata,
+				 const char* message_template, zcbor_state_t* state)
 {
-#if CONFIG_SPOTFLOW_LOG_INCLUDE_BODY_TEMPLATE
-	const size_t map_key_value_pairs = 6;
-#else
-	const size_t map_key_value_pairs = 5;
-#endif
+	/* template already defined in the log dictionary is sent only as its ID */
+	if (metadata->template_id >= 0) {
+		return zcbor_uint32_put(state, KEY_BODY_TEMPLATE_ID) &&
+		       zcbor_uint32_put(state, metadata->template_id);
+	}
 
-	/* zcbor supports state arrays; we need 2 states for nested array */
+	return zcbor_uint32_put(state, KEY_BODY_TEMPLATE) &&
+	       zcbor_tstr_put_term(state, message_template, SIZE_MAX);
+}
+#endif /* SEND_BODY_TEMPLATE */
+
+static int encode_cbor_spotflow(const struct message_metadata* metadata, uint8_t* package,
+				const char* message_template, bool format_body, uint8_t buf[],
+				size_t* encoded_len)
+{
+	/* zcbor supports state arrays; we need 2 states for nested map or array */
 	zcbor_state_t state[ZCBOR_STATE_DEPTH];
 
 	bool succ;
@@ -228,7 +353,7 @@ static int encode_cbor_spotflow(const struct message_metadata* metadata,
 	zcbor_new_encode_state(state, ZCBOR_STATE_DEPTH, buf, CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN, 1);
 
 	/* start outer map */
-	succ = zcbor_map_start_encode(state, map_key_value_pairs);
+	succ = zcbor_map_start_encode(state, MAP_KEY_VALUE_PAIRS);
 
 	/* messageType: "LOG" */
 	succ = succ && zcbor_uint32_put(state, KEY_MESSAGE_TYPE);
@@ -237,26 +362,45 @@ static int encode_cbor_spotflow(const struct message_metadata* metadata,
 	int rc = encode_message_metadata_to_cbor(metadata, state);
 	if (rc < 0) {
 		LOG_DBG("Failed to encode metadata to cbor: %d", rc);
-		LOG_DBG("Encoding failed: %d", zcbor_peek_error(state));
 		return rc;
 	}
 
-	/* body */
-	succ = succ && zcbor_uint32_put(state, KEY_BODY);
-	succ = succ && zcbor_tstr_put_term(state, formatted_message, SIZE_MAX);
-
-#if CONFIG_SPOTFLOW_LOG_INCLUDE_BODY_TEMPLATE
+#ifdef SEND_BODY_TEMPLATE
 	/* bodyTemplate */
-	succ = succ && zcbor_uint32_put(state, KEY_BODY_TEMPLATE);
-	succ = succ && zcbor_tstr_put_term(state, message_template, SIZE_MAX);
+	succ = succ && encode_body_template(metadata, message_template, state);
 #endif
 
+#if CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING
+	/* bodyTemplateValues, the formatter walks the template and reads the packaged arguments */
+	if (!format_body) {
+		succ = succ && zcbor_uint32_put(state, KEY_BODY_TEMPLATE_VALUES);
+		if (succ) {
+			rc = cbpprintf_external(NULL, encode_template_values, state, package);
+			if (rc < 0) {
+				LOG_DBG("Failed to encode template values: %d", rc);
+				return rc;
+			}
+		}
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING */
+
+	/* body is encoded last, so it can take all the remaining space */
+	if (format_body) {
+		succ = succ && zcbor_uint32_put(state, KEY_BODY);
+		if (succ) {
+			rc = encode_body(state, package);
+			if (rc < 0) {
+				LOG_DBG("Failed to encode body: %d", rc);
+				return rc;
+			}
+		}
+	}
+
 	/* finish cbor */
-	succ = succ && zcbor_map_end_encode(state, map_key_value_pairs);
+	succ = succ && zcbor_map_end_encode(state, MAP_KEY_VALUE_PAIRS);
 
 	if (succ != true) {
 		LOG_DBG("Failed to encode cbor: %d", zcbor_peek_error(state));
-		LOG_DBG("Encoding failed: %d", zcbor_peek_error(state));
 		return -EINVAL;
 	}
 
@@ -264,3 +408,208 @@ static int encode_cbor_spotflow(const struct message_metadata* metadata,
 	*encoded_len = state->payload - buf;
 	return 0;
 }
+
+#ifdef ENCODE_SUMMARY_LOGS
+static void init_summary_metadata(struct message_metadata* metadata, uint8_t level,
+				  uint32_t uptime_ms, uint8_t domain_id, int16_t source_id,
+				  size_t sequence_number)
+{
+	metadata->severity = spotflow_cbor_convert_log_level_to_severity(level);
+	metadata->uptime_ms = uptime_ms;
+	metadata->sequence_number = sequence_number;
+	metadata->source = source_id >= 0 ? log_source_name_get(domain_id, source_id) : "unknown";
+	metadata->source_id = -ENOENT;
+	metadata->template_id = -ENOENT;
+#ifdef CONFIG_SPOTFLOW_LOG_DICTIONARY
+	metadata->source_id = spotflow_log_dictionary_get_id(metadata->source);
+#endif /* CONFIG_SPOTFLOW_LOG_DICTIONARY */
+}
+
+static int encode_summary_cbor(const struct message_metadata* metadata, const char* body,
+			       const struct spotflow_log_repeat* repeat, uint8_t buf[],
+			       size_t* encoded_len)
+{
+	zcbor_state_t state[ZCBOR_STATE_DEPTH];
+	zcbor_new_encode_state(state, ZCBOR_STATE_DEPTH, buf, CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN, 1);
+
+	size_t pairs = SUMMARY_MAP_KEY_VALUE_PAIRS;
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+	if (repeat != NULL) {
+		pairs += REPEAT_MAP_KEY_VALUE_PAIRS;
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
+
+	bool succ = zcbor_map_start_encode(state, pairs);
+	succ = succ && zcbor_uint32_put(state, KEY_MESSAGE_TYPE);
+	succ = succ && zcbor_uint32_put(state, LOGS_MESSAGE_TYPE);
+
+	int rc = encode_message_metadata_to_cbor(metadata, state);
+	if (rc < 0) {
+		LOG_DBG("Failed to encode metadata to cbor: %d", rc);
+		return rc;
+	}
+
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+	if (repeat != NULL) {
+		succ = succ && zcbor_uint32_put(state, KEY_REPEAT_COUNT);
+		succ = succ && zcbor_uint32_put(state, repeat->repeat_count);
+		succ = succ && zcbor_uint32_put(state, KEY_FIRST_DEVICE_UPTIME_MS);
+		succ = succ && zcbor_uint32_put(state, repeat->first_uptime_ms);
+	}
+#else
+	ARG_UNUSED(repeat);
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
+
+	succ = succ && zcbor_uint32_put(state, KEY_BODY);
+	succ = succ && zcbor_tstr_put_term(state, body, SUMMARY_BODY_MAX_LEN);
+	succ = succ && zcbor_map_end_encode(state, pairs);
+
+	if (succ != true) {
+		LOG_DBG("Failed to encode summary log: %d", zcbor_peek_error(state));
+		return -EINVAL;
+	}
+
+	*encoded_len = state->payload - buf;
+	return 0;
+}
+#endif /* ENCODE_SUMMARY_LOGS */
+
+#if CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING
+
+/* Template walker callback encoding each value into the CBOR array */
+static int encode_template_value(const struct spotflow_template_value* value, void* ctx)
+{
+	zcbor_state_t* state = ctx;
+	bool succ;
+
+	switch (value->type) {
+	case SPOTFLOW_TEMPLATE_VALUE_INT:
+		succ = zcbor_int64_put(state, value->int_value);
+		break;
+	case SPOTFLOW_TEMPLATE_VALUE_UINT:
+		succ = zcbor_uint64_put(state, value->uint_value);
+		break;
+	case SPOTFLOW_TEMPLATE_VALUE_DOUBLE:
+		succ = zcbor_float64_put(state, value->double_value);
+		break;
+	case SPOTFLOW_TEMPLATE_VALUE_CHAR:
+		succ = zcbor_tstr_encode_ptr(state, &value->char_value, 1);
+		break;
+	case SPOTFLOW_TEMPLATE_VALUE_STRING:
+		succ = zcbor_tstr_put_term(state, value->string_value, SIZE_MAX);
+		break;
+	default:
+		return -ENOTSUP;
+	}
+
+	if (succ != true) {
+		LOG_DBG("Failed to encode template value: %d", zcbor_peek_error(state));
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/* cbprintf formatter encoding the arguments into a CBOR array instead of printing them */
+static int encode_template_values(cbprintf_cb out, void* ctx, const char* fmt, va_list ap)
+{
+	ARG_UNUSED(out);
+	__ASSERT(ctx != NULL, "ctx is NULL");
+
+	zcbor_state_t* state = ctx;
+
+	if (!zcbor_list_start_encode(state, TEMPLATE_VALUES_MAX_COUNT)) {
+		return -ENOMEM;
+	}
+
+	int rc = spotflow_log_template_walk_values(fmt, ap, encode_template_value, state);
+	if (rc < 0) {
+		if (rc == -ENOTSUP) {
+			LOG_DBG("Unsupported conversion specification in template: %s", fmt);
+		}
+		return rc;
+	}
+
+	if (!zcbor_list_end_encode(state, TEMPLATE_VALUES_MAX_COUNT)) {
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+#endif /* CONFIG_SPOTFLOW_LOG_DEFERRED_FORMATTING */
+
+static int cb_out(int c, void* output_ctx)
+{
+	__ASSERT(output_ctx != NULL, "output_ctx is NULL");
+
+	struct body_output* out = (struct body_output*)output_ctx;
+	if (out->pos >= out->end) {
+		out->truncated = true;
+		return -ENOMEM;
+	}
+	*out->pos++ = (uint8_t)c;
+	return 0;
+}
+
+/* Drops a UTF-8 sequence possibly split by the truncation */
+static size_t trim_incomplete_utf8(const uint8_t* text, size_t len)
+{
+	size_t end = len;
+
+	while (end > 0 && (text[end - 1] & 0xC0) == 0x80) {
+		end--;
+	}
+
+	if (end > 0 && (text[end - 1] & 0xC0) == 0xC0) {
+		uint8_t lead = text[end - 1];
+		size_t expected_len = 4;
+		if ((lead & 0xE0) == 0xC0) {
+			expected_len = 2;
+		} else if ((lead & 0xF0) == 0xE0) {
+			expected_len = 3;
+		}
+
+		if (len - (end - 1) < expected_len) {
+			return end - 1;
+		}
+	}
+
+	return len;
+}
+
+/* Formats the body after the space reserved for the text string header */
+static int encode_body(zcbor_state_t* state, uint8_t* package)
+{
+	uint8_t* text = state->payload_mut + BODY_HEADER_MAX_LEN;
+
+	if (text + BODY_TRAILER_LEN > state->payload_end) {
+		return -ENOMEM;
+	}
+
+	struct body_output out = {
+		.pos = text,
+		.end = state->payload_end - BODY_TRAILER_LEN,
+		.truncated = false,
+	};
+
+	int rc = cbpprintf(cb_out, &out, package);
+	if (rc < 0 && !out.truncated) {
+		LOG_DBG("cbprintf failed to format message: %d", rc);
+		return rc;
+	}
+
+	size_t len = out.pos - text;
+	if (out.truncated) {
+		/* Message longer than the remaining space is sent truncated instead of dropped */
+		len = trim_incomplete_utf8(text, len);
+		LOG_DBG("Log message truncated to %zu bytes", len);
+	}
+
+	/* zcbor writes the shortest header and moves the text already in the buffer right after it */
+	if (!zcbor_tstr_encode_ptr(state, (const char*)text, len)) {
+		LOG_DBG("Failed to encode body: %d", zcbor_peek_error(state));
+		return -ENOMEM;
+	}
+
+	return 0;
+}
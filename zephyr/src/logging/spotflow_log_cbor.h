@@ -6,6 +6,9 @@
 #include "zephyr/logging/log.h"
 
 #include "spotflow_cbor_output_context.h"
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+#include "spotflow_log_coalesce.h"
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
 
 #ifdef __cplusplus
 extern "C" {
@@ -13,7 +16,21 @@ extern "C" {
 
 int spotflow_cbor_encode_log(struct log_msg* log_msg, size_t sequence_number,
 			     struct spotflow_cbor_output_context* output_context,
-			     uint8_t** cbor_data, size_t* cbor_data_len);
+			     size_t* cbor_data_len);
+
+#ifdef CONFIG_SPOTFLOW_LOG_RATE_LIMIT
+int spotflow_cbor_encode_suppressed_summary(int16_t source_id, uint32_t suppressed_count,
+					    size_t sequence_number,
+					    struct spotflow_cbor_output_context* output_context,
+					    size_t* cbor_data_len);
+#endif /* CONFIG_SPOTFLOW_LOG_RATE_LIMIT */
+
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING
+int spotflow_cbor_encode_repeat_summary(const struct spotflow_log_repeat* repeat,
+					size_t sequence_number,
+					struct spotflow_cbor_output_context* output_context,
+					size_t* cbor_data_len);
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING */
 
 uint32_t spotflow_cbor_convert_log_level_to_severity(uint8_t lvl);
 uint8_t spotflow_cbor_convert_severity_to_log_level(uint32_t severity);
@@ -0,0 +1,148 @@
+#include "spotflow_log_coalesce.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/logging/log_output.h>
+#include <zephyr/sys/cbprintf.h>
+
+LOG_MODULE_DECLARE(spotflow_logging, CONFIG_SPOTFLOW_LOGS_PROCESSING_LOG_LEVEL);
+
+#define FNV1A_OFFSET_BASIS 2166136261U
+#define FNV1A_PRIME 16777619U
+
+/* Last sent message, identified without keeping the message itself */
+struct coalesce_state {
+	bool valid;
+	const char* message_template;
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY
+	uint32_t body_hash;
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY */
+	struct spotflow_log_repeat run;
+};
+
+static struct coalesce_state last_sent;
+
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY
+/* Hash of the last checked message, reused if the message is sent */
+static const struct log_msg* hashed_msg;
+static uint32_t hashed_body_hash;
+
+static int hash_body_char(int c, void* ctx)
+{
+	uint32_t* hash = ctx;
+
+	*hash = (*hash ^ (uint8_t)c) * FNV1A_PRIME;
+	return c;
+}
+
+static uint32_t get_body_hash(uint8_t* package)
+{
+	uint32_t hash = FNV1A_OFFSET_BASIS;
+
+	/* Rendering only into the hash is still much cheaper than encoding and sending */
+	int rc = cbpprintf(hash_body_char, &hash, package);
+	if (rc < 0) {
+		LOG_DBG("cbprintf failed to hash message: %d", rc);
+	}
+
+	return hash;
+}
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY */
+
+static uint32_t get_uptime_ms(struct log_msg* log_msg)
+{
+	return log_output_timestamp_to_us(log_msg_get_timestamp(log_msg)) / 1000U;
+}
+
+void spotflow_log_coalesce_init(void)
+{
+	last_sent.valid = false;
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY
+	hashed_msg = NULL;
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY */
+}
+
+bool spotflow_log_coalesce_check(struct log_msg* log_msg)
+{
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY
+	hashed_msg = NULL;
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY */
+
+	if (!last_sent.valid) {
+		return false;
+	}
+
+	size_t plen;
+	uint8_t* package = log_msg_get_package(log_msg, &plen);
+	const char* message_template = ((struct cbprintf_package_hdr_ext*)package)->fmt;
+	uint32_t uptime_ms = get_uptime_ms(log_msg);
+
+	bool is_repeat = last_sent.message_template == message_template &&
+			 last_sent.run.level == log_msg_get_level(log_msg) &&
+			 last_sent.run.domain_id == log_msg_get_domain(log_msg) &&
+			 last_sent.run.source_id == log_msg_get_source_id(log_msg) &&
+			 uptime_ms - last_sent.run.first_uptime_ms <=
+				 CONFIG_SPOTFLOW_LOG_COALESCING_WINDOW_MS;
+	if (!is_repeat) {
+		return false;
+	}
+
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY
+	/* Only the messages matching the last sent one in everything else are rendered */
+	hashed_msg = log_msg;
+	hashed_body_hash = get_body_hash(package);
+	if (hashed_body_hash != last_sent.body_hash) {
+		return false;
+	}
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY */
+
+	last_sent.run.repeat_count++;
+	last_sent.run.last_uptime_ms = uptime_ms;
+	return true;
+}
+
+void spotflow_log_coalesce_sent(struct log_msg* log_msg)
+{
+	size_t plen;
+	uint8_t* package = log_msg_get_package(log_msg, &plen);
+	const char* message_template = ((struct cbprintf_package_hdr_ext*)package)->fmt;
+	uint32_t uptime_ms = get_uptime_ms(log_msg);
+
+	/* Templates are compared by address, a template copied into the package can be reused */
+	const uint8_t* template_addr = (const uint8_t*)message_template;
+	last_sent.valid = template_addr < package || template_addr >= package + plen;
+	if (!last_sent.valid) {
+		return;
+	}
+
+	last_sent.message_template = message_template;
+#ifdef CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY
+	last_sent.body_hash = hashed_msg == log_msg ? hashed_body_hash : get_body_hash(package);
+#endif /* CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY */
+	last_sent.run.level = log_msg_get_level(log_msg);
+	last_sent.run.domain_id = log_msg_get_domain(log_msg);
+	last_sent.run.source_id = log_msg_get_source_id(log_msg);
+	last_sent.run.repeat_count = 0;
+	last_sent.run.first_uptime_ms = uptime_ms;
+	last_sent.run.last_uptime_ms = uptime_ms;
+}
+
+int32_t spotflow_log_coalesce_flush(struct spotflow_log_repeat* ended_run, bool force)
+{
+	ended_run->repeat_count = 0;
+
+	if (!last_sent.valid || last_sent.run.repeat_count == 0) {
+		return SYS_FOREVER_MS;
+	}
+
+	/* Repeated messages arriving after the window start a new run, so it can end now */
+	uint32_t elapsed_ms = k_uptime_get_32() - last_sent.run.first_uptime_ms;
+	if (!force && elapsed_ms <= CONFIG_SPOTFLOW_LOG_COALESCING_WINDOW_MS) {
+		return CONFIG_SPOTFLOW_LOG_COALESCING_WINDOW_MS - elapsed_ms + 1;
+	}
+
+	*ended_run = last_sent.run;
+	last_sent.run.repeat_count = 0;
+
+	return SYS_FOREVER_MS;
+}
@@ -0,0 +1,71 @@
+#ifndef SPOTFLOW_LOG_COALESCE_H
+#define SPOTFLOW_LOG_COALESCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/logging/log.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Run of messages repeating the last sent message */
+struct spotflow_log_repeat {
+	uint8_t level;
+	uint8_t domain_id;
+	int16_t source_id;
+	/* Number of repeated messages, not including the sent one */
+	uint32_t repeat_count;
+	uint32_t first_uptime_ms;
+	uint32_t last_uptime_ms;
+};
+
+/**
+ * @brief Reset the coalescing state, the next message is always sent
+ */
+void spotflow_log_coalesce_init(void);
+
+/**
+ * @brief Compare a message with the last sent one and count it if it is repeated
+ *
+ * Messages are repeated if they have the same source, level and template (and rendered body
+ * if CONFIG_SPOTFLOW_LOG_COALESCING_COMPARE_BODY is enabled) and arrive within
+ * CONFIG_SPOTFLOW_LOG_COALESCING_WINDOW_MS after the first repeated one. The body is rendered
+ * only if all the other properties match. Must be called only from the log processing context,
+ * before the message is encoded.
+ *
+ * @param log_msg Message to check
+ *
+ * @return true if the message repeats the last sent message and must not be sent
+ */
+bool spotflow_log_coalesce_check(struct log_msg* log_msg);
+
+/**
+ * @brief Remember a message put into the buffer as the last sent one
+ *
+ * Must be called only for messages not counted by spotflow_log_coalesce_check(), after
+ * the run of the previous message was ended by spotflow_log_coalesce_flush().
+ *
+ * @param log_msg Message put into the buffer
+ */
+void spotflow_log_coalesce_sent(struct log_msg* log_msg);
+
+/**
+ * @brief End the run of messages repeating the last sent one once its window elapses
+ *
+ * Must not be called concurrently with the other functions of this module.
+ *
+ * @param ended_run Filled with the ended run, its repeat_count is 0 if there is no such run
+ * @param force End the run even if its window has not elapsed yet
+ *
+ * @return Time until the window of the pending run elapses in milliseconds,
+ *         SYS_FOREVER_MS if there is no pending run
+ */
+int32_t spotflow_log_coalesce_flush(struct spotflow_log_repeat* ended_run, bool force);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPOTFLOW_LOG_COALESCE_H */
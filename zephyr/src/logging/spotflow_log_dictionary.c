@@ -0,0 +1,170 @@
+#include "spotflow_log_dictionary.h"
+
+#include <string.h>
+
+#include <zcbor_common.h>
+#include <zcbor_encode.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "net/spotflow_mqtt.h"
+
+LOG_MODULE_DECLARE(spotflow_logging, CONFIG_SPOTFLOW_LOGS_PROCESSING_LOG_LEVEL);
+
+#define KEY_MESSAGE_TYPE 0x00
+#define KEY_DICTIONARY_ENTRIES 0x22
+
+#define LOG_DICTIONARY_MESSAGE_TYPE 0x06
+
+#define ZCBOR_STATE_DEPTH 2
+
+#define DICTIONARY_SIZE CONFIG_SPOTFLOW_LOG_DICTIONARY_SIZE
+/* Hash table is kept at most half full, so there is always an empty slot ending the probing */
+#define DICTIONARY_SLOT_COUNT (2 * DICTIONARY_SIZE)
+
+#define DICTIONARY_MESSAGE_MAX_LEN CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN
+/* Message type pair, entries key and headers and ends of both maps */
+#define DICTIONARY_MESSAGE_OVERHEAD 8
+/* Ends of both maps, reserved while adding entries */
+#define DICTIONARY_MAP_ENDS_LEN 2
+/* Entry ID and string header */
+#define DICTIONARY_ENTRY_OVERHEAD 8
+/* Longer strings would not fit into a dictionary message, they are always sent inline */
+#define DICTIONARY_STRING_MAX_LEN                                                                  \
+	(DICTIONARY_MESSAGE_MAX_LEN - DICTIONARY_MESSAGE_OVERHEAD - DICTIONARY_ENTRY_OVERHEAD)
+
+BUILD_ASSERT(DICTIONARY_SIZE <= UINT16_MAX, "CONFIG_SPOTFLOW_LOG_DICTIONARY_SIZE is too large");
+
+static struct k_spinlock dictionary_lock;
+
+/* Strings indexed by their IDs, IDs are assigned sequentially and never reused */
+static const char* dictionary_strings[DICTIONARY_SIZE];
+/* Open addressing table indexed by string address, holds ID + 1 (0 is an empty slot) */
+static uint16_t dictionary_slots[DICTIONARY_SLOT_COUNT];
+static uint16_t dictionary_count;
+
+/* Entries with lower IDs were already sent in the current session (processing thread only) */
+static uint16_t dictionary_sent_count;
+
+static uint8_t dictionary_cbor_buf[DICTIONARY_MESSAGE_MAX_LEN];
+
+static uint32_t find_slot(const char* str);
+static int encode_dictionary_entries(uint16_t first_id, uint16_t end_id, uint16_t* encoded_count,
+				     size_t* encoded_len);
+
+int spotflow_log_dictionary_get_id(const char* str)
+{
+	if (str == NULL) {
+		return -EINVAL;
+	}
+
+	int id = -ENOSPC;
+	k_spinlock_key_t key = k_spin_lock(&dictionary_lock);
+
+	uint32_t slot = find_slot(str);
+	if (dictionary_slots[slot] != 0) {
+		id = dictionary_slots[slot] - 1;
+	} else if (dictionary_count < DICTIONARY_SIZE &&
+		   strnlen(str, DICTIONARY_STRING_MAX_LEN + 1) <= DICTIONARY_STRING_MAX_LEN) {
+		id = dictionary_count;
+		dictionary_strings[id] = str;
+		dictionary_slots[slot] = id + 1;
+		/* The entry is complete before it becomes visible to the processing thread */
+		dictionary_count++;
+	}
+
+	k_spin_unlock(&dictionary_lock, key);
+	return id;
+}
+
+int spotflow_log_dictionary_send_pending(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&dictionary_lock);
+	uint16_t count = dictionary_count;
+	k_spin_unlock(&dictionary_lock, key);
+
+	if (dictionary_sent_count >= count) {
+		return 0;
+	}
+
+	uint16_t encoded_count = 0;
+	size_t encoded_len = 0;
+	int rc = encode_dictionary_entries(dictionary_sent_count, count, &encoded_count,
+					   &encoded_len);
+	if (rc < 0) {
+		LOG_DBG("Failed to encode log dictionary: %d", rc);
+		return rc;
+	}
+
+	rc = spotflow_mqtt_publish_ingest_cbor_msg(dictionary_cbor_buf, encoded_len);
+	if (rc < 0) {
+		return rc;
+	}
+
+	LOG_DBG("Published %u log dictionary entries", encoded_count);
+	dictionary_sent_count += encoded_count;
+
+	return 1;
+}
+
+void spotflow_log_dictionary_reset_session(void)
+{
+	dictionary_sent_count = 0;
+}
+
+static uint32_t find_slot(const char* str)
+{
+	/* Multiplicative hashing spreads the addresses of neighbouring strings */
+	uint32_t slot = ((uint32_t)(uintptr_t)str * 2654435761U) % DICTIONARY_SLOT_COUNT;
+
+	while (dictionary_slots[slot] != 0 &&
+	       dictionary_strings[dictionary_slots[slot] - 1] != str) {
+		slot = (slot + 1) % DICTIONARY_SLOT_COUNT;
+	}
+
+	return slot;
+}
+
+static int encode_dictionary_entries(uint16_t first_id, uint16_t end_id, uint16_t* encoded_count,
+				     size_t* encoded_len)
+{
+	zcbor_state_t state[ZCBOR_STATE_DEPTH];
+	zcbor_new_encode_state(state, ZCBOR_STATE_DEPTH, dictionary_cbor_buf,
+			       sizeof(dictionary_cbor_buf), 1);
+
+	bool succ = zcbor_map_start_encode(state, 2);
+
+	succ = succ && zcbor_uint32_put(state, KEY_MESSAGE_TYPE);
+	succ = succ && zcbor_uint32_put(state, LOG_DICTIONARY_MESSAGE_TYPE);
+
+	/* entries → map from ID to string */
+	succ = succ && zcbor_uint32_put(state, KEY_DICTIONARY_ENTRIES);
+	succ = succ && zcbor_map_start_encode(state, end_id - first_id);
+
+	uint16_t id = first_id;
+	for (; succ && id < end_id; id++) {
+		size_t len = strlen(dictionary_strings[id]);
+		size_t remaining = state->payload_end - state->payload;
+
+		/* Entries that do not fit are sent in the next message */
+		if (remaining < len + DICTIONARY_ENTRY_OVERHEAD + DICTIONARY_MAP_ENDS_LEN) {
+			break;
+		}
+
+		succ = succ && zcbor_uint32_put(state, id);
+		succ = succ && zcbor_tstr_encode_ptr(state, dictionary_strings[id], len);
+	}
+
+	succ = succ && zcbor_map_end_encode(state, end_id - first_id);
+	succ = succ && zcbor_map_end_encode(state, 2);
+
+	if (succ != true) {
+		LOG_DBG("Failed to encode log dictionary: %d", zcbor_peek_error(state));
+		return -EINVAL;
+	}
+
+	*encoded_count = id - first_id;
+	*encoded_len = state->payload - dictionary_cbor_buf;
+	return 0;
+}
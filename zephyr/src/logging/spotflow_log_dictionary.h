@@ -0,0 +1,42 @@
+#ifndef SPOTFLOW_LOG_DICTIONARY_H
+#define SPOTFLOW_LOG_DICTIONARY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Get the dictionary ID of a constant string, assigning a new one on first use
+ *
+ * Strings are identified by their address, so only strings with static storage duration
+ * (log templates and source names) can be used. Can be called from any context.
+ *
+ * @param str String to look up
+ *
+ * @return ID of the string on success, negative errno on failure
+ *         -EINVAL: Invalid parameters
+ *         -ENOSPC: Dictionary is full or the string is too long, it has to be sent inline
+ */
+int spotflow_log_dictionary_get_id(const char* str);
+
+/**
+ * @brief Publish definitions of the entries not yet sent in the current session
+ *
+ * Must be called from the Spotflow processing thread before publishing logs referencing
+ * the entries.
+ *
+ * @return 0 if there was nothing to send, 1 if some entries were published,
+ *         negative errno on failure
+ */
+int spotflow_log_dictionary_send_pending(void);
+
+/**
+ * @brief Start a new session, all entries are sent again before they are referenced
+ */
+void spotflow_log_dictionary_reset_session(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPOTFLOW_LOG_DICTIONARY_H */
@@ -1,35 +1,247 @@
+#include <string.h>
+
 #include "zephyr/kernel.h"
 #include "logging/spotflow_log_backend.h"
+#include "logging/spotflow_log_buffer.h"
+#ifdef CONFIG_SPOTFLOW_LOG_DICTIONARY
+#include "logging/spotflow_log_dictionary.h"
+#endif /* CONFIG_SPOTFLOW_LOG_DICTIONARY */
+#ifdef CONFIG_SPOTFLOW_LOG_RETAINED
+#include "logging/spotflow_log_retained.h"
+#endif /* CONFIG_SPOTFLOW_LOG_RETAINED */
 #include "net/spotflow_mqtt.h"
 #include "zephyr/logging/log.h"
 
 LOG_MODULE_DECLARE(spotflow_logging, CONFIG_SPOTFLOW_LOGS_PROCESSING_LOG_LEVEL);
 
+static int publish_pending_dictionary_entries(void);
+static int publish_retained_logs(void);
+
+#ifdef CONFIG_SPOTFLOW_LOG_BATCHING
+
+/* CBOR array header: initial byte followed by up to 2 bytes of item count */
+#define BATCH_HEADER_MAX_LEN 3
+#define CBOR_MAJOR_TYPE_ARRAY 0x80
+#define CBOR_ADDITIONAL_INFO_UINT8 24
+#define CBOR_ADDITIONAL_INFO_UINT16 25
+
+BUILD_ASSERT(CONFIG_SPOTFLOW_LOG_BATCH_MAX_SIZE >= CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN,
+	     "CONFIG_SPOTFLOW_LOG_BATCH_MAX_SIZE must be at least CONFIG_SPOTFLOW_CBOR_LOG_MAX_LEN");
+
+/* Encoded log maps are appended after space reserved for the array header */
+struct spotflow_log_batch {
+	uint8_t buf[BATCH_HEADER_MAX_LEN + CONFIG_SPOTFLOW_LOG_BATCH_MAX_SIZE];
+	size_t len;
+	uint16_t count;
+	bool full;
+	int64_t opened_at_ms;
+};
+
+static struct spotflow_log_batch log_batch;
+
+static void fill_batch(struct spotflow_log_batch* batch);
+static bool is_batch_ready(const struct spotflow_log_batch* batch);
+static size_t prepend_batch_header(struct spotflow_log_batch* batch);
+static void reset_batch(struct spotflow_log_batch* batch);
+
 int spotflow_poll_and_process_enqueued_logs(void)
 {
-	struct spotflow_mqtt_logs_msg* msg_ptr;
+	/* Logs retained from the previous run are older than all the buffered ones */
+	int rc = publish_retained_logs();
+	if (rc != 0) {
+		return rc;
+	}
+
+	fill_batch(&log_batch);
 
-	/* Peek without removing - returns non-zero if queue empty */
-	if (k_msgq_peek(&g_spotflow_logs_msgq, &msg_ptr) != 0) {
-		return 0; /* Queue empty */
+	if (!is_batch_ready(&log_batch)) {
+		return 0; /* Nothing to send yet */
 	}
 
-	int rc = spotflow_mqtt_publish_ingest_cbor_msg(msg_ptr->payload, msg_ptr->len);
+	/* Logs in the batch can reference dictionary entries that were not sent yet */
+	rc = publish_pending_dictionary_entries();
+	if (rc != 0) {
+		return rc;
+	}
+
+	size_t header_len = prepend_batch_header(&log_batch);
+	uint8_t* payload = &log_batch.buf[BATCH_HEADER_MAX_LEN - header_len];
+
+	/* Batch stays intact until it is successfully published */
+	rc = spotflow_mqtt_publish_ingest_cbor_msg(payload, header_len + log_batch.len);
 	if (rc == -EAGAIN) {
 		/* Temporary, retry later without aborting connection */
 		return rc;
 	}
 	if (rc < 0) {
-		LOG_DBG("Failed to publish log message: %d, aborting connection", rc);
+		LOG_DBG("Failed to publish log batch: %d, aborting connection", rc);
 		spotflow_mqtt_abort_mqtt();
 		return rc;
 	}
 
-	/* Only remove after successful publish */
-	k_msgq_get(&g_spotflow_logs_msgq, &msg_ptr, K_NO_WAIT);
+	LOG_DBG("Published batch of %u log messages (%zu bytes)", log_batch.count,
+		header_len + log_batch.len);
 
-	k_free(msg_ptr->payload);
-	k_free(msg_ptr);
+	reset_batch(&log_batch);
 
 	return 1;
 }
+
+/* Moves records from the log buffer to the batch until the buffer is empty or the batch full */
+static void fill_batch(struct spotflow_log_batch* batch)
+{
+	while (!batch->full && batch->count < UINT16_MAX) {
+		const struct spotflow_log_record* record = spotflow_log_buffer_claim();
+		if (record == NULL) {
+			return;
+		}
+
+		const uint8_t* data;
+		size_t len;
+		if (spotflow_log_backend_get_record_payload(record, &data, &len) < 0) {
+			LOG_DBG("Failed to encode raw log message, dropping");
+			spotflow_log_buffer_release();
+			continue;
+		}
+
+		if (batch->len + len > CONFIG_SPOTFLOW_LOG_BATCH_MAX_SIZE) {
+			/* Record stays claimed and opens the next batch */
+			batch->full = true;
+			return;
+		}
+
+		if (batch->count == 0) {
+			batch->opened_at_ms = k_uptime_get();
+		}
+
+		memcpy(&batch->buf[BATCH_HEADER_MAX_LEN + batch->len], data, len);
+		batch->len += len;
+		batch->count++;
+
+		spotflow_log_buffer_release();
+	}
+
+	batch->full = true;
+}
+
+static bool is_batch_ready(const struct spotflow_log_batch* batch)
+{
+	if (batch->count == 0) {
+		return false;
+	}
+
+	if (batch->full) {
+		return true;
+	}
+
+	return k_uptime_get() - batch->opened_at_ms >= CONFIG_SPOTFLOW_LOG_BATCH_LINGER_MS;
+}
+
+/* Writes the array header right before the first log map and returns its length */
+static size_t prepend_batch_header(struct spotflow_log_batch* batch)
+{
+	uint8_t* end = &batch->buf[BATCH_HEADER_MAX_LEN];
+
+	if (batch->count < CBOR_ADDITIONAL_INFO_UINT8) {
+		end[-1] = CBOR_MAJOR_TYPE_ARRAY | batch->count;
+		return 1;
+	}
+
+	if (batch->count <= UINT8_MAX) {
+		end[-2] = CBOR_MAJOR_TYPE_ARRAY | CBOR_ADDITIONAL_INFO_UINT8;
+		end[-1] = batch->count;
+		return 2;
+	}
+
+	end[-3] = CBOR_MAJOR_TYPE_ARRAY | CBOR_ADDITIONAL_INFO_UINT16;
+	end[-2] = batch->count >> 8;
+	end[-1] = batch->count & 0xFF;
+	return 3;
+}
+
+static void reset_batch(struct spotflow_log_batch* batch)
+{
+	batch->len = 0;
+	batch->count = 0;
+	batch->full = false;
+}
+
+#else
+
+int spotflow_poll_and_process_enqueued_logs(void)
+{
+	/* Logs retained from the previous run are older than all the buffered ones */
+	int rc = publish_retained_logs();
+	if (rc != 0) {
+		return rc;
+	}
+
+	/* Claim without removing - returns NULL if buffer empty */
+	const struct spotflow_log_record* record = spotflow_log_buffer_claim();
+	if (record == NULL) {
+		return 0; /* Buffer empty */
+	}
+
+	/* Raw records are encoded again on retry, the encoded message is not kept */
+	const uint8_t* data;
+	size_t len;
+	rc = spotflow_log_backend_get_record_payload(record, &data, &len);
+	if (rc < 0) {
+		LOG_DBG("Failed to encode raw log message: %d, dropping", rc);
+		spotflow_log_buffer_release();
+		return 1;
+	}
+
+	/* The record can reference dictionary entries that were not sent yet */
+	rc = publish_pending_dictionary_entries();
+	if (rc != 0) {
+		return rc;
+	}
+
+	/* Encoded records are published directly from the buffer, they stay claimed until sent */
+	rc = spotflow_mqtt_publish_ingest_cbor_msg((uint8_t*)data, len);
+	if (rc == -EAGAIN) {
+		/* Temporary, retry later without aborting connection */
+		return rc;
+	}
+	if (rc < 0) {
+		LOG_DBG("Failed to publish log message: %d, aborting connection", rc);
+		spotflow_mqtt_abort_mqtt();
+		return rc;
+	}
+
+	/* Only release after successful publish */
+	spotflow_log_buffer_release();
+
+	return 1;
+}
+
+#endif /* CONFIG_SPOTFLOW_LOG_BATCHING */
+
+static int publish_pending_dictionary_entries(void)
+{
+#ifdef CONFIG_SPOTFLOW_LOG_DICTIONARY
+	int rc = spotflow_log_dictionary_send_pending();
+	if (rc < 0 && rc != -EAGAIN) {
+		LOG_DBG("Failed to publish log dictionary: %d, aborting connection", rc);
+		spotflow_mqtt_abort_mqtt();
+	}
+	return rc;
+#else
+	return 0;
+#endif /* CONFIG_SPOTFLOW_LOG_DICTIONARY */
+}
+
+static int publish_retained_logs(void)
+{
+#ifdef CONFIG_SPOTFLOW_LOG_RETAINED
+	int rc = spotflow_log_retained_send();
+	if (rc < 0 && rc != -EAGAIN) {
+		LOG_DBG("Failed to publish retained logs: %d, aborting connection", rc);
+		spotflow_mqtt_abort_mqtt();
+	}
+	return rc;
+#else
+	return 0;
+#endif /* CONFIG_SPOTFLOW_LOG_RETAINED */
+}
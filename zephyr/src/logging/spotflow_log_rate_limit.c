@@ -0,0 +1,99 @@
+#include "spotflow_log_rate_limit.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(spotflow_logging, CONFIG_SPOTFLOW_LOGS_PROCESSING_LOG_LEVEL);
+
+#define RATE_LIMIT_SOURCE_COUNT CONFIG_SPOTFLOW_LOG_RATE_LIMIT_MAX_SOURCES
+
+/* Tokens are kept in thousandths, so refilling by the rate per second every millisecond is exact */
+#define TOKEN_COST MSEC_PER_SEC
+#define TOKEN_REFILL_PER_MS CONFIG_SPOTFLOW_LOG_RATE_LIMIT_RATE
+#define TOKEN_CAPACITY ((uint32_t)CONFIG_SPOTFLOW_LOG_RATE_LIMIT_BURST * TOKEN_COST)
+
+/* Elapsed time after which any bucket is full again, also prevents the refill from overflowing */
+#define BUCKET_FULL_AFTER_MS DIV_ROUND_UP(TOKEN_CAPACITY, TOKEN_REFILL_PER_MS)
+
+struct rate_limit_bucket {
+	uint32_t tokens;
+	uint32_t refilled_at_ms;
+	uint32_t suppressed_count;
+};
+
+static struct rate_limit_bucket buckets[RATE_LIMIT_SOURCE_COUNT];
+
+static uint32_t last_report_ms;
+static bool has_suppressed;
+
+void spotflow_log_rate_limit_init(void)
+{
+	uint32_t now_ms = k_uptime_get_32();
+
+	for (size_t i = 0; i < ARRAY_SIZE(buckets); i++) {
+		buckets[i].tokens = TOKEN_CAPACITY;
+		buckets[i].refilled_at_ms = now_ms;
+		buckets[i].suppressed_count = 0;
+	}
+
+	last_report_ms = now_ms;
+	has_suppressed = false;
+}
+
+bool spotflow_log_rate_limit_allow(uint8_t domain_id, int16_t source_id)
+{
+	if (domain_id != Z_LOG_LOCAL_DOMAIN_ID || source_id < 0 ||
+	    source_id >= RATE_LIMIT_SOURCE_COUNT) {
+		return true;
+	}
+
+	struct rate_limit_bucket* bucket = &buckets[source_id];
+	uint32_t now_ms = k_uptime_get_32();
+	uint32_t elapsed_ms = now_ms - bucket->refilled_at_ms;
+
+	if (elapsed_ms >= BUCKET_FULL_AFTER_MS) {
+		bucket->tokens = TOKEN_CAPACITY;
+	} else {
+		bucket->tokens = MIN(bucket->tokens + elapsed_ms * TOKEN_REFILL_PER_MS,
+				     TOKEN_CAPACITY);
+	}
+	bucket->refilled_at_ms = now_ms;
+
+	if (bucket->tokens < TOKEN_COST) {
+		bucket->suppressed_count++;
+		has_suppressed = true;
+		return false;
+	}
+
+	bucket->tokens -= TOKEN_COST;
+	return true;
+}
+
+int32_t spotflow_log_rate_limit_report(spotflow_log_rate_limit_report_cb report_cb, bool force)
+{
+	if (!has_suppressed) {
+		return SYS_FOREVER_MS;
+	}
+
+	uint32_t now_ms = k_uptime_get_32();
+	uint32_t elapsed_ms = now_ms - last_report_ms;
+	if (!force && elapsed_ms < CONFIG_SPOTFLOW_LOG_RATE_LIMIT_SUMMARY_INTERVAL_MS) {
+		return CONFIG_SPOTFLOW_LOG_RATE_LIMIT_SUMMARY_INTERVAL_MS - elapsed_ms;
+	}
+
+	last_report_ms = now_ms;
+	has_suppressed = false;
+
+	for (size_t i = 0; i < ARRAY_SIZE(buckets); i++) {
+		if (buckets[i].suppressed_count == 0) {
+			continue;
+		}
+
+		LOG_DBG("Suppressed %" PRIu32 " messages of source %zu",
+			buckets[i].suppressed_count, i);
+		report_cb(i, buckets[i].suppressed_count);
+		buckets[i].suppressed_count = 0;
+	}
+
+	return SYS_FOREVER_MS;
+}
@@ -0,0 +1,53 @@
+#ifndef SPOTFLOW_LOG_RATE_LIMIT_H
+#define SPOTFLOW_LOG_RATE_LIMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Callback reporting the number of messages of a log source suppressed since its last report
+ */
+typedef void (*spotflow_log_rate_limit_report_cb)(int16_t source_id, uint32_t suppressed_count);
+
+/**
+ * @brief Reset all the log sources to a full burst
+ */
+void spotflow_log_rate_limit_init(void);
+
+/**
+ * @brief Take a token from the bucket of the log source of a message
+ *
+ * Must be called only from the log processing context, before the message is formatted.
+ * Messages from other domains and from sources with IDs not fitting into the table are
+ * always allowed.
+ *
+ * @param domain_id Log domain of the message
+ * @param source_id Log source ID of the message
+ *
+ * @return true if the message can be sent, false if it is suppressed
+ */
+bool spotflow_log_rate_limit_allow(uint8_t domain_id, int16_t source_id);
+
+/**
+ * @brief Report the suppressed messages of all throttled sources once per summary interval
+ *
+ * Must not be called concurrently with spotflow_log_rate_limit_allow(). Does nothing if there
+ * are no suppressed messages or the interval since the last report has not elapsed yet.
+ *
+ * @param report_cb Callback invoked for each source with suppressed messages
+ * @param force Report the suppressed messages even if the interval has not elapsed yet
+ *
+ * @return Time until the next report is due in milliseconds,
+ *         SYS_FOREVER_MS if there are no suppressed messages left
+ */
+int32_t spotflow_log_rate_limit_report(spotflow_log_rate_limit_report_cb report_cb, bool force);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPOTFLOW_LOG_RATE_LIMIT_H */
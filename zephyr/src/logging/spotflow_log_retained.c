@@ -0,0 +1,192 @@
+#include "spotflow_log_retained.h"
+
+#include <string.h>
+
+#include <zcbor_common.h>
+#include <zcbor_decode.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+
+#include "net/spotflow_mqtt.h"
+
+LOG_MODULE_DECLARE(spotflow_logging, CONFIG_SPOTFLOW_LOGS_PROCESSING_LOG_LEVEL);
+
+#define KEY_MESSAGE_TYPE 0x00
+#define KEY_DEVICE_RUN_ID 0x1E
+#define KEY_LOGS 0x25
+
+#define RETAINED_LOGS_MESSAGE_TYPE 0x07
+
+#define RETAINED_MAGIC 0x53465254 /* "SFRT" */
+#define RETAINED_SIZE CONFIG_SPOTFLOW_LOG_RETAINED_SIZE
+
+#define CBOR_MAJOR_TYPE_ARRAY 0x80
+#define CBOR_MAJOR_TYPE_MAP 0xA0
+#define CBOR_ADDITIONAL_INFO_UINT8 24
+#define CBOR_ADDITIONAL_INFO_UINT16 25
+#define CBOR_ADDITIONAL_INFO_UINT64 27
+/* Map header, message type, device run ID and logs array header */
+#define RETAINED_HEADER_MAX_LEN 20
+
+#define ZCBOR_STATE_DEPTH 1
+
+/* Encoded logs survive the reset, they are valid only if the magic and CRC match */
+struct retained_logs {
+	uint32_t magic;
+	uint32_t crc;
+	/* Fields below are covered by the CRC, up to the length of the records */
+	uint64_t device_run_id;
+	uint32_t len;
+	uint32_t count;
+	/* Message header is written right before the records when they are sent */
+	uint8_t header[RETAINED_HEADER_MAX_LEN];
+	uint8_t records[RETAINED_SIZE];
+};
+
+static __noinit struct retained_logs retained_logs;
+
+/* Logs of the previous run are waiting to be sent */
+static bool retained_logs_pending;
+
+static uint32_t compute_crc(void);
+static int discard_oldest_record(void);
+static size_t write_message_header(void);
+
+void spotflow_log_retained_init(void)
+{
+	retained_logs_pending = retained_logs.magic == RETAINED_MAGIC &&
+				retained_logs.len <= RETAINED_SIZE && retained_logs.count > 0 &&
+				retained_logs.crc == compute_crc();
+
+	if (retained_logs_pending) {
+		LOG_INF("Found %" PRIu32 " logs retained from the previous run", retained_logs.count);
+	} else {
+		retained_logs.magic = 0;
+	}
+}
+
+void spotflow_log_retained_begin(uint64_t device_run_id)
+{
+	retained_logs_pending = false;
+	retained_logs.device_run_id = device_run_id;
+	retained_logs.len = 0;
+	retained_logs.count = 0;
+	retained_logs.crc = compute_crc();
+	retained_logs.magic = RETAINED_MAGIC;
+}
+
+int spotflow_log_retained_append(const uint8_t* data, size_t len)
+{
+	if (len > RETAINED_SIZE) {
+		return -ENOMEM;
+	}
+
+	/* The newest logs are the most relevant for the cause of the panic */
+	while (retained_logs.len + len > RETAINED_SIZE) {
+		if (discard_oldest_record() < 0) {
+			retained_logs.len = 0;
+			retained_logs.count = 0;
+		}
+	}
+
+	memcpy(&retained_logs.records[retained_logs.len], data, len);
+	retained_logs.len += len;
+	retained_logs.count++;
+
+	/* It is not known which log is the last one, so the CRC is always kept up to date */
+	retained_logs.crc = compute_crc();
+
+	return 0;
+}
+
+int spotflow_log_retained_send(void)
+{
+	if (!retained_logs_pending) {
+		return 0;
+	}
+
+	size_t header_len = write_message_header();
+	uint8_t* payload = retained_logs.records - header_len;
+
+	int rc = spotflow_mqtt_publish_ingest_cbor_msg(payload, header_len + retained_logs.len);
+	if (rc < 0) {
+		return rc;
+	}
+
+	LOG_DBG("Published %" PRIu32 " logs retained from the previous run", retained_logs.count);
+
+	retained_logs_pending = false;
+	retained_logs.magic = 0;
+
+	return 1;
+}
+
+static uint32_t compute_crc(void)
+{
+	size_t len = MIN(retained_logs.len, RETAINED_SIZE);
+
+	uint32_t crc = crc32_ieee((const uint8_t*)&retained_logs.device_run_id,
+				  offsetof(struct retained_logs, header) -
+					  offsetof(struct retained_logs, device_run_id));
+	return crc32_ieee_update(crc, retained_logs.records, len);
+}
+
+/* Records are encoded CBOR maps, the length of the oldest one is found by skipping it */
+static int discard_oldest_record(void)
+{
+	ZCBOR_STATE_D(state, ZCBOR_STATE_DEPTH, retained_logs.records, retained_logs.len, 1, 0);
+
+	if (!zcbor_any_skip(state, NULL)) {
+		LOG_DBG("Failed to skip retained log: %d", zcbor_peek_error(state));
+		return -EINVAL;
+	}
+
+	size_t record_len = state->payload - retained_logs.records;
+	memmove(retained_logs.records, &retained_logs.records[record_len],
+		retained_logs.len - record_len);
+	retained_logs.len -= record_len;
+	retained_logs.count--;
+
+	return 0;
+}
+
+/* Writes the message header right before the records and returns its length */
+static size_t write_message_header(void)
+{
+	uint8_t header[RETAINED_HEADER_MAX_LEN];
+	size_t len = 0;
+	bool has_run_id = retained_logs.device_run_id != 0;
+
+	/* message type, logs and optional device run ID */
+	header[len++] = CBOR_MAJOR_TYPE_MAP | (has_run_id ? 3 : 2);
+	header[len++] = KEY_MESSAGE_TYPE;
+	header[len++] = RETAINED_LOGS_MESSAGE_TYPE;
+
+	if (has_run_id) {
+		header[len++] = CBOR_ADDITIONAL_INFO_UINT8;
+		header[len++] = KEY_DEVICE_RUN_ID;
+		header[len++] = CBOR_ADDITIONAL_INFO_UINT64;
+		sys_put_be64(retained_logs.device_run_id, &header[len]);
+		len += sizeof(uint64_t);
+	}
+
+	header[len++] = CBOR_ADDITIONAL_INFO_UINT8;
+	header[len++] = KEY_LOGS;
+
+	if (retained_logs.count < CBOR_ADDITIONAL_INFO_UINT8) {
+		header[len++] = CBOR_MAJOR_TYPE_ARRAY | retained_logs.count;
+	} else if (retained_logs.count <= UINT8_MAX) {
+		header[len++] = CBOR_MAJOR_TYPE_ARRAY | CBOR_ADDITIONAL_INFO_UINT8;
+		header[len++] = retained_logs.count;
+	} else {
+		header[len++] = CBOR_MAJOR_TYPE_ARRAY | CBOR_ADDITIONAL_INFO_UINT16;
+		sys_put_be16(retained_logs.count, &header[len]);
+		len += sizeof(uint16_t);
+	}
+
+	memcpy(retained_logs.records - len, header, len);
+	return len;
+}
@@ -0,0 +1,55 @@
+#ifndef SPOTFLOW_LOG_RETAINED_H
+#define SPOTFLOW_LOG_RETAINED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Check the logs retained from the previous run
+ *
+ * Must be called once at boot, before spotflow_log_retained_begin() can be called.
+ */
+void spotflow_log_retained_init(void);
+
+/**
+ * @brief Start retaining logs of the current run, discarding the ones from the previous run
+ *
+ * Called on panic, does not allocate nor block.
+ *
+ * @param device_run_id Device run ID of the current run, 0 if unknown
+ */
+void spotflow_log_retained_begin(uint64_t device_run_id);
+
+/**
+ * @brief Append an encoded log to the retained logs
+ *
+ * If the retained memory is full, the oldest retained logs are discarded to make room for the
+ * new one. Called on panic, does not allocate nor block.
+ *
+ * @param data Encoded log
+ * @param len Length of the encoded log in bytes
+ *
+ * @return 0 on success, negative errno on failure
+ *         -ENOMEM: Log does not fit into the retained memory
+ */
+int spotflow_log_retained_append(const uint8_t* data, size_t len);
+
+/**
+ * @brief Publish the logs retained from the previous run
+ *
+ * Must be called only from the Spotflow processing thread.
+ *
+ * @return 0 if there was nothing to send, 1 if the logs were published,
+ *         negative errno on failure
+ */
+int spotflow_log_retained_send(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPOTFLOW_LOG_RETAINED_H */
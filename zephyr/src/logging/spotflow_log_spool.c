@@ -0,0 +1,341 @@
+#include "spotflow_log_spool.h"
+
+#include <string.h>
+
+#include <zephyr/fs/fcb.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+
+LOG_MODULE_DECLARE(spotflow_logging, CONFIG_SPOTFLOW_LOGS_PROCESSING_LOG_LEVEL);
+
+#define SPOOL_PARTITION_ID FIXED_PARTITION_ID(spotflow_log_partition)
+#define SPOOL_FCB_MAGIC 0x53464c47 /* "SFLG" */
+#define SPOOL_FCB_VERSION 1
+
+#define SPOOL_BLOCK_SIZE CONFIG_SPOTFLOW_LOG_SPOOL_BLOCK_SIZE
+#define SPOOL_REPLAY_INTERVAL_MS (MSEC_PER_SEC / CONFIG_SPOTFLOW_LOG_SPOOL_REPLAY_RATE)
+
+/* Records are stored in the same layout as in the log buffer, aligned to words */
+#define SPOOL_RECORD_SIZE(len)                                                                     \
+	ROUND_UP(sizeof(struct spotflow_log_record_hdr) + (len), sizeof(uint32_t))
+
+enum spool_state {
+	SPOOL_STATE_UNINITIALIZED,
+	SPOOL_STATE_READY,
+	SPOOL_STATE_FAILED,
+};
+
+/* Serializes the flash access of the work item and the processing thread */
+static K_MUTEX_DEFINE(spool_lock);
+static enum spool_state spool_state;
+static struct fcb spool_fcb;
+static struct flash_sector spool_sectors[CONFIG_SPOTFLOW_LOG_SPOOL_MAX_SECTORS];
+
+/*
+ * Records waiting to be appended to flash as a single entry. One block is filled by the log
+ * processing thread while the other one, once full, is written by the work item.
+ */
+static struct k_spinlock write_lock;
+static uint32_t write_blocks[2][SPOOL_BLOCK_SIZE / sizeof(uint32_t)];
+static size_t write_block_lens[2];
+static size_t filled_block;
+static bool full_block_pending;
+
+/* Entry being replayed, its sector is erased once the next sector is reached */
+static uint32_t read_block[SPOOL_BLOCK_SIZE / sizeof(uint32_t)];
+static size_t read_block_len;
+static size_t read_offset;
+static struct fcb_entry read_loc;
+
+/* Record claimed by the processing thread, kept until it is successfully published */
+static const struct spotflow_log_record* claimed_record;
+static uint32_t replayed_at_ms;
+
+static void flush_work_handler(struct k_work* work);
+
+static K_WORK_DEFINE(flush_work, flush_work_handler);
+
+static int init_spool(void);
+static bool seal_filled_block(void);
+static int flush_full_block(void);
+static int write_block(uint32_t* block, size_t block_len);
+static int read_next_entry(void);
+static const struct spotflow_log_record* get_next_record(void);
+
+int spotflow_log_spool_store(const struct spotflow_log_record* record)
+{
+	size_t size = SPOOL_RECORD_SIZE(record->hdr.len);
+	if (size > SPOOL_BLOCK_SIZE) {
+		return -ENOMEM;
+	}
+
+	if (spool_state == SPOOL_STATE_FAILED) {
+		return -EIO;
+	}
+
+	int rc = 0;
+	bool sealed = false;
+	k_spinlock_key_t key = k_spin_lock(&write_lock);
+
+	if (write_block_lens[filled_block] + size > SPOOL_BLOCK_SIZE) {
+		sealed = seal_filled_block();
+		if (!sealed) {
+			/* Both blocks are full, the flash is slower than the logs are evicted */
+			rc = -EBUSY;
+		}
+	}
+
+	if (rc == 0) {
+		uint8_t* block = (uint8_t*)write_blocks[filled_block];
+		memcpy(block + write_block_lens[filled_block], record, size);
+		write_block_lens[filled_block] += size;
+	}
+
+	k_spin_unlock(&write_lock, key);
+
+	if (sealed) {
+		k_work_submit(&flush_work);
+	}
+
+	return rc;
+}
+
+const struct spotflow_log_record* spotflow_log_spool_claim(void)
+{
+	if (claimed_record != NULL) {
+		return claimed_record;
+	}
+
+	if (k_uptime_get_32() - replayed_at_ms < SPOOL_REPLAY_INTERVAL_MS) {
+		return NULL;
+	}
+
+	k_mutex_lock(&spool_lock, K_FOREVER);
+	if (init_spool() == 0) {
+		claimed_record = get_next_record();
+	}
+	k_mutex_unlock(&spool_lock);
+
+	return claimed_record;
+}
+
+void spotflow_log_spool_release(void)
+{
+	if (claimed_record == NULL) {
+		return;
+	}
+
+	/* Read block is accessed only by the processing thread */
+	read_offset += SPOOL_RECORD_SIZE(claimed_record->hdr.len);
+	claimed_record = NULL;
+	replayed_at_ms = k_uptime_get_32();
+}
+
+static int init_spool(void)
+{
+	if (spool_state == SPOOL_STATE_READY) {
+		return 0;
+	}
+	if (spool_state == SPOOL_STATE_FAILED) {
+		return -EIO;
+	}
+
+	/* Initialized on first use, the flash driver might not be ready when the backend starts */
+	spool_state = SPOOL_STATE_FAILED;
+
+	uint32_t sector_cnt = ARRAY_SIZE(spool_sectors);
+	int rc = flash_area_get_sectors(SPOOL_PARTITION_ID, &sector_cnt, spool_sectors);
+	if (rc < 0) {
+		LOG_ERR("Failed to get log spool flash sectors: %d", rc);
+		return -EIO;
+	}
+
+	spool_fcb.f_magic = SPOOL_FCB_MAGIC;
+	spool_fcb.f_version = SPOOL_FCB_VERSION;
+	spool_fcb.f_sectors = spool_sectors;
+	spool_fcb.f_sector_cnt = sector_cnt;
+	spool_fcb.f_scratch_cnt = 0;
+
+	rc = fcb_init(SPOOL_PARTITION_ID, &spool_fcb);
+	if (rc < 0) {
+		LOG_ERR("Failed to initialize log spool: %d", rc);
+		return -EIO;
+	}
+
+	spool_state = SPOOL_STATE_READY;
+	LOG_DBG("Log spool initialized with %" PRIu32 " sectors", sector_cnt);
+	return 0;
+}
+
+/* Writes the blocks filled by the log processing thread, flash is never written from there */
+static void flush_work_handler(struct k_work* work)
+{
+	ARG_UNUSED(work);
+
+	k_mutex_lock(&spool_lock, K_FOREVER);
+	flush_full_block();
+	k_mutex_unlock(&spool_lock);
+}
+
+/*
+ * Hands the filled block over to be written and starts filling the other one, must be called
+ * with write_lock held. Returns false if the other block is not written yet.
+ */
+static bool seal_filled_block(void)
+{
+	if (full_block_pending) {
+		return false;
+	}
+
+	full_block_pending = true;
+	filled_block ^= 1;
+	return true;
+}
+
+/* Writes the sealed block to flash, must be called with spool_lock held */
+static int flush_full_block(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&write_lock);
+	bool pending = full_block_pending;
+	size_t full_block = filled_block ^ 1;
+	k_spin_unlock(&write_lock, key);
+
+	if (!pending) {
+		return 0;
+	}
+
+	/* The sealed block is not touched by the log processing thread until it is released */
+	int rc = init_spool();
+	if (rc == 0) {
+		rc = write_block(write_blocks[full_block], write_block_lens[full_block]);
+	}
+
+	key = k_spin_lock(&write_lock);
+	write_block_lens[full_block] = 0;
+	full_block_pending = false;
+	k_spin_unlock(&write_lock, key);
+
+	return rc;
+}
+
+/* Appends all the collected records as a single entry, padded to the flash write alignment */
+static int write_block(uint32_t* block, size_t block_len)
+{
+	if (block_len == 0) {
+		return 0;
+	}
+
+	/* Zero padding reads as a record of zero length, which ends the block */
+	size_t len = ROUND_UP(block_len, flash_area_align(spool_fcb.fap));
+	if (len > SPOOL_BLOCK_SIZE) {
+		LOG_DBG("Log spool block size is not aligned to the flash write block size");
+		return -EIO;
+	}
+	memset((uint8_t*)block + block_len, 0, len - block_len);
+
+	struct fcb_entry loc;
+	int rc = fcb_append(&spool_fcb, len, &loc);
+	if (rc == -ENOSPC) {
+		/* Spool is full, the oldest logs are dropped */
+		LOG_DBG("Log spool full, erasing oldest sector");
+		if (read_loc.fe_sector == spool_fcb.f_oldest) {
+			memset(&read_loc, 0, sizeof(read_loc));
+		}
+
+		rc = fcb_rotate(&spool_fcb);
+		if (rc == 0) {
+			rc = fcb_append(&spool_fcb, len, &loc);
+		}
+	}
+
+	if (rc == 0) {
+		rc = flash_area_write(spool_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), block, len);
+	}
+	if (rc == 0) {
+		rc = fcb_append_finish(&spool_fcb, &loc);
+	}
+
+	if (rc < 0) {
+		LOG_DBG("Failed to write log spool block: %d", rc);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int read_next_entry(void)
+{
+	struct fcb_entry loc = read_loc;
+
+	int rc = fcb_getnext(&spool_fcb, &loc);
+	while (rc != 0) {
+		/* Records not yet written are newer than all the entries in flash */
+		k_spinlock_key_t key = k_spin_lock(&write_lock);
+		bool has_unwritten = full_block_pending ||
+				     (write_block_lens[filled_block] > 0 && seal_filled_block());
+		k_spin_unlock(&write_lock, key);
+
+		if (!has_unwritten || flush_full_block() < 0) {
+			break;
+		}
+
+		rc = fcb_getnext(&spool_fcb, &loc);
+	}
+
+	if (rc != 0) {
+		/* Everything was replayed, erase the spool so it is not replayed again after reboot */
+		if (!fcb_is_empty(&spool_fcb)) {
+			fcb_clear(&spool_fcb);
+		}
+		memset(&read_loc, 0, sizeof(read_loc));
+		return -ENOENT;
+	}
+
+	/* All entries of the oldest sector were replayed */
+	if (read_loc.fe_sector != NULL && loc.fe_sector != read_loc.fe_sector &&
+	    read_loc.fe_sector == spool_fcb.f_oldest) {
+		fcb_rotate(&spool_fcb);
+	}
+
+	read_loc = loc;
+	read_block_len = 0;
+	read_offset = 0;
+
+	if (loc.fe_data_len > sizeof(read_block)) {
+		LOG_DBG("Skipping log spool entry of %u bytes", loc.fe_data_len);
+		return 0;
+	}
+
+	rc = flash_area_read(spool_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), read_block,
+			     loc.fe_data_len);
+	if (rc < 0) {
+		LOG_DBG("Failed to read log spool entry: %d", rc);
+		return 0;
+	}
+
+	read_block_len = loc.fe_data_len;
+	return 0;
+}
+
+static const struct spotflow_log_record* get_next_record(void)
+{
+	while (true) {
+		size_t remaining = read_block_len - read_offset;
+
+		if (read_offset < read_block_len &&
+		    remaining >= sizeof(struct spotflow_log_record_hdr)) {
+			const struct spotflow_log_record* record =
+				(const struct spotflow_log_record*)((uint8_t*)read_block + read_offset);
+
+			if (record->hdr.len > 0 && SPOOL_RECORD_SIZE(record->hdr.len) <= remaining) {
+				return record;
+			}
+		}
+
+		/* End of the entry, its padding or a corrupted record */
+		if (read_next_entry() < 0) {
+			return NULL;
+		}
+	}
+}
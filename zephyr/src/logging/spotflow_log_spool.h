@@ -0,0 +1,48 @@
+#ifndef SPOTFLOW_LOG_SPOOL_H
+#define SPOTFLOW_LOG_SPOOL_H
+
+#include "spotflow_log_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Store a record evicted from the log buffer in the flash spool
+ *
+ * Records are collected in RAM and appended to flash in blocks of
+ * CONFIG_SPOTFLOW_LOG_SPOOL_BLOCK_SIZE bytes. When the spool is full, its oldest sector is erased.
+ * Only the record is copied, full blocks are written to flash by a work item on the system
+ * work queue. The flash is initialized on first use.
+ *
+ * @param record Record to store
+ *
+ * @return 0 on success, negative errno on failure
+ *         -ENOMEM: Record does not fit into a spool block
+ *         -EBUSY: Previous full block is not written yet
+ *         -EIO: Flash spool is not available
+ */
+int spotflow_log_spool_store(const struct spotflow_log_record* record);
+
+/**
+ * @brief Get the oldest spooled record without removing it from the spool
+ *
+ * At most CONFIG_SPOTFLOW_LOG_SPOOL_REPLAY_RATE records per second are returned, so that the
+ * replay does not delay the newer logs. The same record is returned by subsequent calls until
+ * spotflow_log_spool_release() is called. Must be called only from the Spotflow processing
+ * thread.
+ *
+ * @return Oldest spooled record, NULL if the spool is empty or the replay rate is exceeded
+ */
+const struct spotflow_log_record* spotflow_log_spool_claim(void);
+
+/**
+ * @brief Remove the record returned by spotflow_log_spool_claim() from the spool
+ */
+void spotflow_log_spool_release(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPOTFLOW_LOG_SPOOL_H */
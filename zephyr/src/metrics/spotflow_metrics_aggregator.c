@@ -1,5 +1,6 @@
 #include "spotflow_metrics_aggregator.h"
 #include "spotflow_metrics_cbor.h"
+#include "spotflow_metrics_isr.h"
 
 #include <inttypes.h>
 #include <zephyr/kernel.h>
@@ -11,23 +12,86 @@
 
 LOG_MODULE_DECLARE(spotflow_metrics, CONFIG_SPOTFLOW_METRICS_PROCESSING_LOG_LEVEL);
 
-static bool labels_equal(const struct metric_timeseries_state* ts,
+/* FNV-1a */
+#define LABELS_HASH_OFFSET_BASIS 2166136261U
+#define LABELS_HASH_PRIME 16777619U
+
+#define TIMESERIES_INDEX_EMPTY 0
+
+/* Window ends are shifted by up to 10% of the shortest aggregation interval */
+#define WINDOW_PHASE_MAX_MS 6000
+
+static uint32_t hash_label_string(uint32_t hash, const char* str, size_t max_len);
+static bool labels_equal(const struct metric_timeseries_labels* stored,
 			 const struct spotflow_label* labels, uint8_t label_count);
+static const struct metric_timeseries_labels*
+get_timeseries_labels(const struct metric_aggregator_context* ctx, uint16_t slot);
+static int report_value_lockless(struct metric_aggregator_context* ctx, int64_t value);
+static void start_aggregation_timer(struct metric_aggregator_context* ctx);
+static void schedule_metric(struct metric_aggregator_context* ctx, int64_t window_end_ms);
+static void insert_scheduled(struct metric_aggregator_context* ctx);
+static void reschedule_aggregation_work(void);
+static void close_aggregation_window(struct metric_aggregator_context* ctx, int64_t timestamp_ms);
+static int update_timeseries(struct metric_aggregator_context* ctx,
+			     struct metric_timeseries_state* ts, int64_t value_int,
+			     float value_float);
+static void init_timeseries_aggregation_state(struct metric_timeseries_state* ts,
+					      enum spotflow_metric_type type);
 static void update_aggregation_int(struct metric_timeseries_state* ts, int64_t value);
 static void update_aggregation_float(struct metric_timeseries_state* ts, float value);
 static uint32_t get_interval_ms(enum spotflow_agg_interval interval);
 static int enqueue_metric_message(uint8_t* payload, size_t len);
 static struct metric_timeseries_state*
 find_or_create_timeseries(struct metric_aggregator_context* ctx,
-			  const struct spotflow_label* labels, uint8_t label_count);
-static int flush_timeseries(struct spotflow_metric_base* metric, struct metric_timeseries_state* ts,
-			    int64_t timestamp_ms);
+			  const struct spotflow_label* labels, uint8_t label_count,
+			  uint32_t labels_hash);
+static struct metric_timeseries_state* find_timeseries(struct metric_aggregator_context* ctx,
+						       const struct spotflow_label* labels,
+						       uint8_t label_count, uint32_t labels_hash,
+						       uint16_t* empty_pos);
+static uint16_t find_empty_index_pos(const struct metric_aggregator_context* ctx,
+				     uint32_t labels_hash);
+static void remove_from_index(struct metric_aggregator_context* ctx, uint16_t slot);
+static int flush_timeseries(struct spotflow_metric_base* metric,
+			    const struct metric_timeseries_labels* labels,
+			    const struct metric_retired_timeseries* retired, int64_t timestamp_ms);
+#ifdef CONFIG_SPOTFLOW_METRICS_BATCHED_MESSAGES
+static int flush_timeseries_batch(struct spotflow_metric_base* metric,
+				  const struct metric_timeseries_labels* labels,
+				  const struct metric_retired_timeseries* retired,
+				  uint16_t retired_count, int64_t timestamp_ms);
+#endif
 static void reset_timeseries_state(struct spotflow_metric_base* metric,
 				   struct metric_timeseries_state* ts);
+static uint16_t retire_window(struct metric_aggregator_context* ctx);
+static uint16_t retire_timeseries(struct metric_aggregator_context* ctx, uint16_t slot,
+				  uint16_t retired_count);
+static void release_retired_timeseries(struct metric_aggregator_context* ctx,
+				       uint16_t retired_count);
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+static int buffer_sample(struct metric_aggregator_context* ctx,
+			 struct metric_timeseries_state* ts, int64_t value_int, float value_float);
+static int flush_sample_buffer(struct metric_aggregator_context* ctx, uint16_t slot);
+static void flush_sample_buffers(struct metric_aggregator_context* ctx);
+#else
 static int flush_no_aggregation_metric(struct spotflow_metric_base* metric,
 				       const struct spotflow_label* labels, uint8_t label_count,
 				       int64_t value_int, float value_float);
-static void aggregation_timer_handler(struct k_work* work);
+#endif
+static void aggregation_work_handler(struct k_work* work);
+static void free_aggregator_context(struct metric_aggregator_context* ctx);
+static void init_aggregator_context(struct metric_aggregator_context* ctx,
+				    struct spotflow_metric_base* metric);
+static void update_histogram(uint32_t* buckets, float value);
+
+/* Aggregated metrics with a started window, sorted by the window end */
+static struct metric_aggregator_context* g_scheduled_head;
+static struct k_spinlock g_schedule_lock;
+static K_WORK_DELAYABLE_DEFINE(g_aggregation_work, aggregation_work_handler);
+
+/* Device-wide offset of the window ends, spreads the windows of devices booted together */
+static uint32_t g_window_phase_ms;
+static bool g_window_phase_drawn;
 
 /* Public API Implementation */
 
@@ -37,8 +101,8 @@ int aggregator_register_metric(struct spotflow_metric_base* metric)
 	/* or full failure (returns -ENOMEM with no side effects). Caller relies on */
 	/* this to safely rollback metric registration on failure. */
 
-	/* Allocate aggregator context */
-	struct metric_aggregator_context* ctx = k_malloc(sizeof(*ctx));
+	/* Allocate aggregator context, zeroed so that it can be freed at any point */
+	struct metric_aggregator_context* ctx = k_calloc(1, sizeof(*ctx));
 	if (!ctx) {
 		return -ENOMEM;
 	}
@@ -46,30 +110,115 @@ int aggregator_register_metric(struct spotflow_metric_base* metric)
 	/* Allocate time series array */
 	ctx->timeseries = k_calloc(metric->max_timeseries, sizeof(struct metric_timeseries_state));
 	if (!ctx->timeseries) {
-		k_free(ctx); /* Clean up - maintain atomic semantics */
+		free_aggregator_context(ctx); /* Clean up - maintain atomic semantics */
 		return -ENOMEM;
 	}
 
-	ctx->metric = metric;
-	ctx->timeseries_count = 0;
-	ctx->timeseries_capacity = metric->max_timeseries;
-	ctx->timer_started = false;
+	/* Label sets are read only on hash matches and encoding, they are kept apart from the
+	 * aggregation state
+	 */
+	if (metric->max_labels > 0) {
+		ctx->labels =
+			k_calloc(metric->max_timeseries, sizeof(struct metric_timeseries_labels));
+		if (!ctx->labels) {
+			free_aggregator_context(ctx);
+			return -ENOMEM;
+		}
+	}
 
+	/* Closed aggregation windows are encoded from their own copy, see retire_window() */
 	if (metric->agg_interval != SPOTFLOW_AGG_INTERVAL_NONE) {
-		k_work_init_delayable(&ctx->aggregation_work, aggregation_timer_handler);
+		ctx->retired =
+			k_calloc(metric->max_timeseries, sizeof(struct metric_retired_timeseries));
+		if (!ctx->retired) {
+			free_aggregator_context(ctx);
+			return -ENOMEM;
+		}
 	}
 
-	metric->aggregator_context = ctx;
+	/* Histogram metrics are always aggregated, their buckets are double-buffered as well */
+	if (metric->type == SPOTFLOW_METRIC_TYPE_HISTOGRAM) {
+		size_t bucket_count = (size_t)metric->max_timeseries * SPOTFLOW_HISTOGRAM_BUCKETS;
+		ctx->histograms = k_calloc(bucket_count, sizeof(uint32_t));
+		ctx->retired_histograms = k_calloc(bucket_count, sizeof(uint32_t));
+		if (!ctx->histograms || !ctx->retired_histograms) {
+			free_aggregator_context(ctx);
+			return -ENOMEM;
+		}
+	}
 
-	LOG_DBG("Registered aggregator for metric '%s' (max_ts=%u)", metric->name,
-		metric->max_timeseries);
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+	/* Values of non-aggregated metrics are buffered and sent together */
+	if (metric->agg_interval == SPOTFLOW_AGG_INTERVAL_NONE) {
+		ctx->sample_buffers =
+			k_calloc(metric->max_timeseries, sizeof(struct metric_sample_buffer));
+		if (!ctx->sample_buffers) {
+			free_aggregator_context(ctx);
+			return -ENOMEM;
+		}
+	}
+#endif
+
+	/* Label-less metrics have a single time series, they do not need the index */
+	if (metric->max_labels > 0) {
+		/* Load factor at most 1/2 keeps the expected probe count low */
+		size_t index_capacity = 1U << (LOG2CEIL(metric->max_timeseries) + 1);
+		ctx->index = k_calloc(index_capacity, sizeof(uint16_t));
+		if (!ctx->index) {
+			free_aggregator_context(ctx);
+			return -ENOMEM;
+		}
+		ctx->index_mask = index_capacity - 1;
+	}
+
+	init_aggregator_context(ctx, metric);
 
 	return 0;
 }
 
+void aggregator_register_static_metric(const struct spotflow_metric_descriptor* descriptor)
+{
+	struct spotflow_metric_base* metric = descriptor->metric;
+	struct metric_aggregator_context* ctx = descriptor->context;
+
+	/* Same buffers as aggregator_register_metric() allocates, the unused ones are empty */
+	ctx->timeseries = descriptor->timeseries;
+	if (metric->agg_interval != SPOTFLOW_AGG_INTERVAL_NONE) {
+		ctx->retired = descriptor->retired;
+	}
+	if (metric->type == SPOTFLOW_METRIC_TYPE_HISTOGRAM) {
+		ctx->histograms = descriptor->histograms;
+		ctx->retired_histograms = descriptor->retired_histograms;
+	}
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+	if (metric->agg_interval == SPOTFLOW_AGG_INTERVAL_NONE) {
+		ctx->sample_buffers = descriptor->sample_buffers;
+	}
+#endif
+	if (metric->max_labels > 0) {
+		ctx->labels = descriptor->labels;
+		ctx->index = descriptor->index;
+		ctx->index_mask = (1U << (LOG2CEIL(metric->max_timeseries) + 1)) - 1;
+	}
+
+	init_aggregator_context(ctx, metric);
+}
+
+uint32_t aggregator_hash_labels(const struct spotflow_label* labels, uint8_t label_count)
+{
+	uint32_t hash = LABELS_HASH_OFFSET_BASIS;
+
+	for (uint8_t i = 0; i < label_count; i++) {
+		hash = hash_label_string(hash, labels[i].key, SPOTFLOW_MAX_LABEL_KEY_LEN - 1);
+		hash = hash_label_string(hash, labels[i].value, SPOTFLOW_MAX_LABEL_VALUE_LEN - 1);
+	}
+
+	return hash;
+}
+
 int aggregator_report_value(struct spotflow_metric_base* metric,
 			    const struct spotflow_label* labels, uint8_t label_count,
-			    int64_t value_int, float value_float)
+			    uint32_t labels_hash, int64_t value_int, float value_float)
 {
 	if (metric == NULL || metric->aggregator_context == NULL) {
 		return -EINVAL;
@@ -77,16 +226,23 @@ int aggregator_report_value(struct spotflow_metric_base* metric,
 
 	struct metric_aggregator_context* ctx = metric->aggregator_context;
 
+	if (ctx->lockless) {
+		return report_value_lockless(ctx, value_int);
+	}
+
 	k_mutex_lock(&metric->lock, K_FOREVER);
 
+#ifndef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
 	if (metric->agg_interval == SPOTFLOW_AGG_INTERVAL_NONE) {
 		int rc = flush_no_aggregation_metric(metric, labels, label_count, value_int,
 						     value_float);
 		k_mutex_unlock(&metric->lock);
 		return rc;
 	}
+#endif
 
-	struct metric_timeseries_state* ts = find_or_create_timeseries(ctx, labels, label_count);
+	struct metric_timeseries_state* ts =
+		find_or_create_timeseries(ctx, labels, label_count, labels_hash);
 
 	if (ts == NULL) {
 		k_mutex_unlock(&metric->lock);
@@ -95,13 +251,252 @@ int aggregator_report_value(struct spotflow_metric_base* metric,
 		return -ENOSPC;
 	}
 
+	int rc = update_timeseries(ctx, ts, value_int, value_float);
+	k_mutex_unlock(&metric->lock);
+	return rc;
+}
+
+int aggregator_bind_timeseries(struct spotflow_metric_base* metric,
+			       const struct spotflow_label* labels, uint8_t label_count,
+			       uint32_t labels_hash, struct metric_timeseries_state** ts_out)
+{
+	if (metric == NULL || metric->aggregator_context == NULL || metric->max_labels == 0) {
+		return -EINVAL;
+	}
+
+	struct metric_aggregator_context* ctx = metric->aggregator_context;
+
+	k_mutex_lock(&metric->lock, K_FOREVER);
+
+	/* Non-aggregated metrics use the time series only to keep the bound labels */
+	struct metric_timeseries_state* ts =
+		find_or_create_timeseries(ctx, labels, label_count, labels_hash);
+	if (ts != NULL) {
+		ts->bound = true;
+	}
+
+	k_mutex_unlock(&metric->lock);
+
+	if (ts == NULL) {
+		LOG_WRN("Time series pool full for metric '%s', cannot bind labels", metric->name);
+		return -ENOSPC;
+	}
+
+	*ts_out = ts;
+	return 0;
+}
+
+int aggregator_report_bound_value(struct spotflow_metric_base* metric,
+				  struct metric_timeseries_state* ts, int64_t value_int,
+				  float value_float)
+{
+	struct metric_aggregator_context* ctx = metric->aggregator_context;
+	int rc;
+
+	k_mutex_lock(&metric->lock, K_FOREVER);
+
+#ifndef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+	if (metric->agg_interval == SPOTFLOW_AGG_INTERVAL_NONE) {
+		/* Bound time series are always labeled */
+		const struct metric_timeseries_labels* stored = &ctx->labels[ts - ctx->timeseries];
+		struct spotflow_label labels[CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC];
+		for (uint8_t i = 0; i < stored->label_count; i++) {
+			labels[i].key = stored->labels[i].key;
+			labels[i].value = stored->labels[i].value;
+		}
+		rc = flush_no_aggregation_metric(metric, labels, stored->label_count, value_int,
+						 value_float);
+		k_mutex_unlock(&metric->lock);
+		return rc;
+	}
+#endif
+
+	rc = update_timeseries(ctx, ts, value_int, value_float);
+
+	k_mutex_unlock(&metric->lock);
+	return rc;
+}
+
+/**
+ * @brief Initialize the aggregator context with its buffers set and attach it to the metric
+ */
+static void init_aggregator_context(struct metric_aggregator_context* ctx,
+				    struct spotflow_metric_base* metric)
+{
+	ctx->metric = metric;
+	ctx->lockless = metric->max_labels == 0 && metric->type == SPOTFLOW_METRIC_TYPE_INT &&
+			metric->agg_interval != SPOTFLOW_AGG_INTERVAL_NONE;
+	ctx->timeseries_count = 0;
+	ctx->timeseries_capacity = metric->max_timeseries;
+	ctx->timer_started = false;
+	ctx->next_scheduled = NULL;
+	ctx->window_end_ms = 0;
+	ctx->timeseries_lock = (struct k_spinlock){};
+
+	/* Drawn here under the registry lock, because the random source cannot be used from ISRs
+	 * reporting lockless metrics.
+	 */
+	if (!g_window_phase_drawn) {
+		g_window_phase_ms = sys_rand32_get() % WINDOW_PHASE_MAX_MS;
+		g_window_phase_drawn = true;
+	}
+
+	if (ctx->lockless) {
+		/* The only time series is always active, reports do not have to create it */
+		ctx->timeseries[0].active = true;
+		ctx->timeseries_count = 1;
+		init_timeseries_aggregation_state(&ctx->timeseries[0], metric->type);
+	}
+
+	metric->aggregator_context = ctx;
+
+	LOG_DBG("Registered aggregator for metric '%s' (max_ts=%u)", metric->name,
+		metric->max_timeseries);
+}
+
+/**
+ * @brief Free the aggregator context with all its buffers, NULL buffers are skipped
+ */
+static void free_aggregator_context(struct metric_aggregator_context* ctx)
+{
+	k_free(ctx->index);
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+	k_free(ctx->sample_buffers);
+#endif
+	k_free(ctx->retired_histograms);
+	k_free(ctx->histograms);
+	k_free(ctx->retired);
+	k_free(ctx->labels);
+	k_free(ctx->timeseries);
+	k_free(ctx);
+}
+
+/**
+ * @brief Aggregate a value of a lockless metric
+ *
+ * The metric mutex is not taken, the time series is guarded by a spinlock instead. The value can
+ * thus be reported from ISRs and the report never waits for a preempted thread holding the mutex.
+ */
+static int report_value_lockless(struct metric_aggregator_context* ctx, int64_t value)
+{
+	k_spinlock_key_t key = k_spin_lock(&ctx->timeseries_lock);
+
+	update_aggregation_int(&ctx->timeseries[0], value);
+
+	bool start_timer = !ctx->timer_started;
+	ctx->timer_started = true;
+
+	k_spin_unlock(&ctx->timeseries_lock, key);
+
+	/* Scheduling the work item is ISR-safe */
+	if (start_timer) {
+		start_aggregation_timer(ctx);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Schedule the end of the first aggregation window
+ *
+ * Windows end at multiples of the interval (shifted by the device-wide phase), so the windows of
+ * metrics with the same interval are closed together and the first window is shorter. The
+ * windows of longer intervals end together with the shorter ones, because the intervals are
+ * multiples of each other. Can be called from ISRs.
+ */
+static void start_aggregation_timer(struct metric_aggregator_context* ctx)
+{
+	uint32_t interval_ms = get_interval_ms(ctx->metric->agg_interval);
+	int64_t now_ms = k_uptime_get();
+
+	/* The phase is shorter than any interval, so the dividend is never negative */
+	int64_t window_index = (now_ms + interval_ms - g_window_phase_ms) / interval_ms;
+	int64_t window_end_ms = window_index * interval_ms + g_window_phase_ms;
+
+	schedule_metric(ctx, window_end_ms);
+
+	LOG_DBG("Started aggregation timer for metric '%s' (interval=%u ms, first window=%" PRId64
+		" ms)",
+		ctx->metric->name, interval_ms, window_end_ms - now_ms);
+}
+
+/**
+ * @brief Schedule the window end of a metric that is not scheduled, can be called from ISRs
+ */
+static void schedule_metric(struct metric_aggregator_context* ctx, int64_t window_end_ms)
+{
+	k_spinlock_key_t key = k_spin_lock(&g_schedule_lock);
+
+	ctx->window_end_ms = window_end_ms;
+	insert_scheduled(ctx);
+	if (g_scheduled_head == ctx) {
+		reschedule_aggregation_work();
+	}
+
+	k_spin_unlock(&g_schedule_lock, key);
+}
+
+/**
+ * @brief Insert the metric into the scheduler list by its window end
+ *
+ * MUST be called with g_schedule_lock held.
+ */
+static void insert_scheduled(struct metric_aggregator_context* ctx)
+{
+	struct metric_aggregator_context** link = &g_scheduled_head;
+
+	/* Metrics with the same window end stay in the order they were scheduled */
+	while (*link != NULL && (*link)->window_end_ms <= ctx->window_end_ms) {
+		link = &(*link)->next_scheduled;
+	}
+
+	ctx->next_scheduled = *link;
+	*link = ctx;
+}
+
+/**
+ * @brief Schedule the aggregation work to the earliest window end
+ *
+ * MUST be called with g_schedule_lock held.
+ */
+static void reschedule_aggregation_work(void)
+{
+	if (g_scheduled_head == NULL) {
+		return;
+	}
+
+	int64_t delay_ms = g_scheduled_head->window_end_ms - k_uptime_get();
+	k_work_reschedule(&g_aggregation_work, K_MSEC(MAX(delay_ms, 0)));
+}
+
+/**
+ * @brief Aggregate the value into the time series and start the aggregation timer if needed
+ *
+ * MUST be called with metric->lock held.
+ */
+static int update_timeseries(struct metric_aggregator_context* ctx,
+			     struct metric_timeseries_state* ts, int64_t value_int,
+			     float value_float)
+{
+	struct spotflow_metric_base* metric = ctx->metric;
+
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+	if (metric->agg_interval == SPOTFLOW_AGG_INTERVAL_NONE) {
+		return buffer_sample(ctx, ts, value_int, value_float);
+	}
+#endif
+
 	/* Update aggregation state */
 	if (metric->type == SPOTFLOW_METRIC_TYPE_INT) {
 		update_aggregation_int(ts, value_int);
 	} else if (metric->type == SPOTFLOW_METRIC_TYPE_FLOAT) {
 		update_aggregation_float(ts, value_float);
+	} else if (metric->type == SPOTFLOW_METRIC_TYPE_HISTOGRAM) {
+		size_t slot = ts - ctx->timeseries;
+
+		update_aggregation_float(ts, value_float);
+		update_histogram(&ctx->histograms[slot * SPOTFLOW_HISTOGRAM_BUCKETS], value_float);
 	} else {
-		k_mutex_unlock(&metric->lock);
 		LOG_ERR("Invalid metric type: %d", metric->type);
 		return -EINVAL;
 	}
@@ -109,38 +504,44 @@ int aggregator_report_value(struct spotflow_metric_base* metric,
 	/* Start aggregation timer on first report (sliding window) */
 	/* Use per-metric flag to prevent race condition with labeled metrics */
 	if (!ctx->timer_started) {
-		uint32_t interval_ms = get_interval_ms(metric->agg_interval);
-		if (interval_ms > 0) {
-			/* Add 0-10% jitter to first flush to spread out across metrics */
-			int32_t jitter_ms = sys_rand32_get() % (interval_ms / 10);
-			k_work_schedule(&ctx->aggregation_work, K_MSEC(interval_ms - jitter_ms));
-			ctx->timer_started = true;
-			LOG_DBG("Started aggregation timer for metric '%s' (interval=%u ms, "
-				"jitter=-%d ms)",
-				metric->name, interval_ms, jitter_ms);
-		}
+		ctx->timer_started = true;
+		start_aggregation_timer(ctx);
 	}
 
-	k_mutex_unlock(&metric->lock);
 	return 0;
 }
 
+/**
+ * @brief Hash a label string up to its stored length, including its terminator
+ */
+static uint32_t hash_label_string(uint32_t hash, const char* str, size_t max_len)
+{
+	for (size_t i = 0; i < max_len && str[i] != '\0'; i++) {
+		hash = (hash ^ (uint8_t)str[i]) * LABELS_HASH_PRIME;
+	}
+
+	/* Separates the strings, so "ab" + "c" differs from "a" + "bc" */
+	return hash * LABELS_HASH_PRIME;
+}
+
 /**
  * @brief Compare label arrays for equality
  *
- * Direct string comparison is used instead of hashing since labels are
- * sufficiently small (max 8 labels, key max 16 chars, value max 32 chars).
+ * Called only for time series with a matching hash, so it usually runs once per report.
+ * Reported labels are compared as they are stored, i.e. truncated.
  */
-static bool labels_equal(const struct metric_timeseries_state* ts,
+static bool labels_equal(const struct metric_timeseries_labels* stored,
 			 const struct spotflow_label* labels, uint8_t label_count)
 {
-	if (ts->label_count != label_count) {
+	if (stored->label_count != label_count) {
 		return false;
 	}
 
 	for (uint8_t i = 0; i < label_count; i++) {
-		if (strcmp(ts->labels[i].key, labels[i].key) != 0 ||
-		    strcmp(ts->labels[i].value, labels[i].value) != 0) {
+		if (strncmp(stored->labels[i].key, labels[i].key,
+			    SPOTFLOW_MAX_LABEL_KEY_LEN - 1) != 0 ||
+		    strncmp(stored->labels[i].value, labels[i].value,
+			    SPOTFLOW_MAX_LABEL_VALUE_LEN - 1) != 0) {
 			return false;
 		}
 	}
@@ -148,6 +549,125 @@ static bool labels_equal(const struct metric_timeseries_state* ts,
 	return true;
 }
 
+/**
+ * @brief Get the label set of the time series slot, NULL for label-less metrics
+ */
+static const struct metric_timeseries_labels*
+get_timeseries_labels(const struct metric_aggregator_context* ctx, uint16_t slot)
+{
+	return ctx->labels != NULL ? &ctx->labels[slot] : NULL;
+}
+
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+/**
+ * @brief Append the value to the sample buffer of the time series
+ *
+ * Flushes the buffer when it is full. The first sample buffered after the deadline flush
+ * schedules the next flush deadline of all the buffers of the metric.
+ *
+ * MUST be called with metric->lock held.
+ */
+static int buffer_sample(struct metric_aggregator_context* ctx,
+			 struct metric_timeseries_state* ts, int64_t value_int, float value_float)
+{
+	uint16_t slot = ts - ctx->timeseries;
+	struct metric_sample_buffer* buffer = &ctx->sample_buffers[slot];
+
+	/* The buffer is still full when it failed to be sent, it gets one more try */
+	if (ts->agg.count == CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFER_SIZE &&
+	    flush_sample_buffer(ctx, slot) < 0) {
+		LOG_ERR("Dropping %u unsent samples of metric '%s'", (uint32_t)ts->agg.count,
+			ctx->metric->name);
+		ts->agg.count = 0;
+	}
+
+	struct metric_sample* sample = &buffer->samples[ts->agg.count];
+	int64_t now_ms = k_uptime_get();
+
+	if (ts->agg.count == 0) {
+		buffer->first_sample_ms = now_ms;
+		sample->delta_ms = 0;
+	} else {
+		sample->delta_ms = (uint32_t)(now_ms - buffer->last_sample_ms);
+	}
+	buffer->last_sample_ms = now_ms;
+
+	if (ctx->metric->type == SPOTFLOW_METRIC_TYPE_FLOAT) {
+		sample->value_float = value_float;
+	} else {
+		sample->value_int = value_int;
+	}
+
+	if (++ts->agg.count == CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFER_SIZE) {
+		return flush_sample_buffer(ctx, slot);
+	}
+
+	if (!ctx->timer_started) {
+		ctx->timer_started = true;
+		schedule_metric(ctx, now_ms + CONFIG_SPOTFLOW_METRICS_SAMPLE_MAX_LATENCY_MS);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Encode and enqueue the buffered samples of a time series
+ *
+ * The samples stay in the buffer if they cannot be encoded or enqueued, so they are sent with the
+ * next flush.
+ *
+ * MUST be called with metric->lock held.
+ */
+static int flush_sample_buffer(struct metric_aggregator_context* ctx, uint16_t slot)
+{
+	struct spotflow_metric_base* metric = ctx->metric;
+	struct metric_timeseries_state* ts = &ctx->timeseries[slot];
+	uint16_t sample_count = ts->agg.count;
+	uint8_t* cbor_data = NULL;
+	size_t cbor_len = 0;
+
+	int rc = spotflow_metrics_cbor_encode_samples(
+	    metric, get_timeseries_labels(ctx, slot), &ctx->sample_buffers[slot], sample_count,
+	    metric->sequence_number, &cbor_data, &cbor_len);
+	if (rc < 0) {
+		LOG_ERR("Failed to encode %u samples of metric '%s': %d", sample_count,
+			metric->name, rc);
+		return rc;
+	}
+
+	rc = enqueue_metric_message(cbor_data, cbor_len);
+	if (rc < 0) {
+		/* enqueue_metric_message does NOT free payload on failure */
+		k_free(cbor_data);
+		LOG_WRN("Failed to enqueue %u samples of metric '%s': %d", sample_count,
+			metric->name, rc);
+		return rc;
+	}
+
+	ts->agg.count = 0;
+	metric->sequence_number++;
+	return 0;
+}
+
+/**
+ * @brief Flush the sample buffers of all time series at the flush deadline
+ */
+static void flush_sample_buffers(struct metric_aggregator_context* ctx)
+{
+	k_mutex_lock(&ctx->metric->lock, K_FOREVER);
+
+	for (uint16_t slot = 0; slot < ctx->timeseries_count; slot++) {
+		if (ctx->timeseries[slot].agg.count > 0) {
+			flush_sample_buffer(ctx, slot);
+		}
+	}
+
+	/* The metric was removed from the scheduler list, the next sample schedules it again */
+	ctx->timer_started = false;
+
+	k_mutex_unlock(&ctx->metric->lock);
+}
+#else
 static int flush_no_aggregation_metric(struct spotflow_metric_base* metric,
 				       const struct spotflow_label* labels, uint8_t label_count,
 				       int64_t value_int, float value_float)
@@ -180,6 +700,7 @@ static int flush_no_aggregation_metric(struct spotflow_metric_base* metric,
 	/* Ownership transferred to queue - processor will free */
 	return 0;
 }
+#endif /* CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING */
 
 /**
  * @brief Reset time series state for next aggregation window
@@ -190,17 +711,18 @@ static int flush_no_aggregation_metric(struct spotflow_metric_base* metric,
 static void reset_timeseries_state(struct spotflow_metric_base* metric,
 				   struct metric_timeseries_state* ts)
 {
-	ts->count = 0;
-	ts->sum_truncated = false;
+	ts->agg.count = 0;
+	ts->agg.sum_truncated = false;
 
 	if (metric->type == SPOTFLOW_METRIC_TYPE_INT) {
-		ts->sum_int = 0;
-		ts->min_int = INT64_MAX;
-		ts->max_int = INT64_MIN;
-	} else if (metric->type == SPOTFLOW_METRIC_TYPE_FLOAT) {
-		ts->sum_float = 0.0f;
-		ts->min_float = FLT_MAX;
-		ts->max_float = -FLT_MAX;
+		ts->agg.sum_int = 0;
+		ts->agg.min_int = INT64_MAX;
+		ts->agg.max_int = INT64_MIN;
+	} else if (metric->type == SPOTFLOW_METRIC_TYPE_FLOAT ||
+		   metric->type == SPOTFLOW_METRIC_TYPE_HISTOGRAM) {
+		ts->agg.sum_float = 0.0f;
+		ts->agg.min_float = FLT_MAX;
+		ts->agg.max_float = -FLT_MAX;
 	} else {
 		LOG_ERR("Invalid metric type: %d", metric->type);
 	}
@@ -209,30 +731,28 @@ static void reset_timeseries_state(struct spotflow_metric_base* metric,
 /**
  * @brief Flush time series (encode and enqueue message)
  *
- * MUST be called with metric->lock held.
- *
- * Always resets timeseries state regardless of success/failure to maintain
- * correct aggregation window semantics.
+ * Called without holding the metric lock. The labels of retired time series do not change and
+ * the sequence number of aggregated metrics is used only by their aggregation handler.
  *
  * @param metric Metric base handle
- * @param ts Time series state to flush
+ * @param labels Label set of the retired time series, NULL for label-less metrics
+ * @param retired Values of the closed window
  * @param timestamp_ms Device uptime when aggregation window closed
  */
-static int flush_timeseries(struct spotflow_metric_base* metric, struct metric_timeseries_state* ts,
-			    int64_t timestamp_ms)
+static int flush_timeseries(struct spotflow_metric_base* metric,
+			    const struct metric_timeseries_labels* labels,
+			    const struct metric_retired_timeseries* retired, int64_t timestamp_ms)
 {
 	uint8_t* cbor_data = NULL;
 	size_t cbor_len = 0;
 
-	/* Get and increment sequence number while holding mutex */
 	uint64_t seq_num = metric->sequence_number++;
 
 	/* Encode to CBOR */
-	int rc = spotflow_metrics_cbor_encode_aggregated(metric, ts, timestamp_ms, seq_num,
-							 &cbor_data, &cbor_len);
+	int rc = spotflow_metrics_cbor_encode_aggregated(metric, labels, retired, timestamp_ms,
+							 seq_num, &cbor_data, &cbor_len);
 	if (rc < 0) {
 		LOG_ERR("Failed to encode metric '%s': %d", metric->name, rc);
-		reset_timeseries_state(metric, ts);
 		return rc;
 	}
 
@@ -243,86 +763,258 @@ static int flush_timeseries(struct spotflow_metric_base* metric, struct metric_t
 		/* We must free it here */
 		k_free(cbor_data);
 		LOG_WRN("Failed to enqueue metric '%s': %d", metric->name, rc);
-		reset_timeseries_state(metric, ts);
 		return rc;
 	}
 
 	/* Ownership transferred to queue - processor will free */
-
-	reset_timeseries_state(metric, ts);
 	return 0;
 }
 
+#ifdef CONFIG_SPOTFLOW_METRICS_BATCHED_MESSAGES
 /**
- * @brief Aggregation timer expiration handler
+ * @brief Flush closed windows of multiple time series in one message
  *
- * Called when aggregation window closes. Flushes all active time series.
+ * @param metric Metric base handle
+ * @param labels Label sets of the metric by time series slot, NULL for label-less metrics
+ * @param retired Retired time series to flush
+ * @param retired_count Number of retired time series
+ * @param timestamp_ms Device uptime when aggregation window closed
  */
-static void aggregation_timer_handler(struct k_work* work)
+static int flush_timeseries_batch(struct spotflow_metric_base* metric,
+				  const struct metric_timeseries_labels* labels,
+				  const struct metric_retired_timeseries* retired,
+				  uint16_t retired_count, int64_t timestamp_ms)
 {
-	struct k_work_delayable* dwork = k_work_delayable_from_work(work);
-	struct metric_aggregator_context* ctx =
-	    CONTAINER_OF(dwork, struct metric_aggregator_context, aggregation_work);
+	uint8_t* cbor_data = NULL;
+	size_t cbor_len = 0;
+
+	uint64_t seq_num = metric->sequence_number++;
+
+	int rc = spotflow_metrics_cbor_encode_aggregated_batch(metric, labels, retired,
+							       retired_count, timestamp_ms,
+							       seq_num, &cbor_data, &cbor_len);
+	if (rc < 0) {
+		LOG_ERR("Failed to encode metric '%s': %d", metric->name, rc);
+		return rc;
+	}
+
+	rc = enqueue_metric_message(cbor_data, cbor_len);
+	if (rc < 0) {
+		/* enqueue_metric_message does NOT free payload on failure */
+		k_free(cbor_data);
+		LOG_WRN("Failed to enqueue metric '%s': %d", metric->name, rc);
+		return rc;
+	}
 
+	return 0;
+}
+#endif /* CONFIG_SPOTFLOW_METRICS_BATCHED_MESSAGES */
+
+/**
+ * @brief Swap the values of the closed window out of the time series
+ *
+ * Only a copy of the values is made under the lock, so reporters do not wait for the encoding
+ * of the closed window. The retired time series are not evicted until they are encoded.
+ *
+ * @return Number of retired time series
+ */
+static uint16_t retire_window(struct metric_aggregator_context* ctx)
+{
 	struct spotflow_metric_base* metric = ctx->metric;
+	uint16_t retired_count = 0;
 
-	/* Capture timestamp when aggregation window closes */
-	int64_t timestamp_ms = k_uptime_get();
+	if (ctx->lockless) {
+		k_spinlock_key_t key = k_spin_lock(&ctx->timeseries_lock);
+		retired_count = retire_timeseries(ctx, 0, retired_count);
+		k_spin_unlock(&ctx->timeseries_lock, key);
+		return retired_count;
+	}
 
 	k_mutex_lock(&metric->lock, K_FOREVER);
 
+	for (uint16_t slot = 0; slot < ctx->timeseries_capacity; slot++) {
+		retired_count = retire_timeseries(ctx, slot, retired_count);
+	}
+
+	k_mutex_unlock(&metric->lock);
+
+	return retired_count;
+}
+
+static uint16_t retire_timeseries(struct metric_aggregator_context* ctx, uint16_t slot,
+				  uint16_t retired_count)
+{
+	struct metric_timeseries_state* ts = &ctx->timeseries[slot];
+
+	if (!ts->active || ts->agg.count == 0) {
+		return retired_count;
+	}
+
+	struct metric_retired_timeseries* retired = &ctx->retired[retired_count];
+	retired->agg = ts->agg;
+	retired->slot = slot;
+	retired->histogram = NULL;
+
+	if (ctx->histograms != NULL) {
+		uint32_t* buckets = &ctx->histograms[slot * SPOTFLOW_HISTOGRAM_BUCKETS];
+		uint32_t* retired_buckets =
+		    &ctx->retired_histograms[retired_count * SPOTFLOW_HISTOGRAM_BUCKETS];
+
+		memcpy(retired_buckets, buckets, SPOTFLOW_HISTOGRAM_BUCKETS * sizeof(uint32_t));
+		memset(buckets, 0, SPOTFLOW_HISTOGRAM_BUCKETS * sizeof(uint32_t));
+		retired->histogram = retired_buckets;
+	}
+
+	ts->retired = true;
+	reset_timeseries_state(ctx->metric, ts);
+	return retired_count + 1;
+}
+
+/**
+ * @brief Allow eviction of the time series encoded by the aggregation handler
+ */
+static void release_retired_timeseries(struct metric_aggregator_context* ctx,
+				       uint16_t retired_count)
+{
+	/* Label-less time series are never evicted */
+	if (ctx->lockless || retired_count == 0) {
+		return;
+	}
+
+	k_mutex_lock(&ctx->metric->lock, K_FOREVER);
+
+	for (uint16_t i = 0; i < retired_count; i++) {
+		ctx->timeseries[ctx->retired[i].slot].retired = false;
+	}
+
+	k_mutex_unlock(&ctx->metric->lock);
+}
+
+/**
+ * @brief Close the aggregation window of a metric
+ *
+ * Flushes all time series with values in the window.
+ */
+static void close_aggregation_window(struct metric_aggregator_context* ctx, int64_t timestamp_ms)
+{
+	struct spotflow_metric_base* metric = ctx->metric;
+
+	uint16_t retired_count = retire_window(ctx);
+
 	LOG_DBG("Aggregation window closed for metric '%s' at %" PRId64
-		" ms (%u active time series)",
-		metric->name, timestamp_ms, ctx->timeseries_count);
-
-	/* Flush all active time series with the same timestamp */
-	for (uint16_t i = 0; i < ctx->timeseries_capacity; i++) {
-		struct metric_timeseries_state* ts = &ctx->timeseries[i];
-
-		if (ts->active && ts->count > 0) {
-			int rc = flush_timeseries(metric, ts, timestamp_ms);
-			if (rc < 0) {
-				LOG_ERR("Failed to flush time series for metric '%s': %d",
-					metric->name, rc);
-			}
+		" ms (%u time series with values)",
+		metric->name, timestamp_ms, retired_count);
+
+	/* Flush all retired time series with the same timestamp */
+#ifdef CONFIG_SPOTFLOW_METRICS_BATCHED_MESSAGES
+	uint16_t batch_count;
+	for (uint16_t i = 0; i < retired_count; i += batch_count) {
+		batch_count = spotflow_metrics_cbor_batch_fit(metric, ctx->labels, &ctx->retired[i],
+							      retired_count - i);
+		/* A single time series, e.g. of a label-less metric, keeps the plain message */
+		int rc = batch_count == 1
+			     ? flush_timeseries(metric,
+						get_timeseries_labels(ctx, ctx->retired[i].slot),
+						&ctx->retired[i], timestamp_ms)
+			     : flush_timeseries_batch(metric, ctx->labels, &ctx->retired[i],
+						      batch_count, timestamp_ms);
+		if (rc < 0) {
+			LOG_ERR("Failed to flush %u time series for metric '%s': %d", batch_count,
+				metric->name, rc);
 		}
 	}
+#else
+	for (uint16_t i = 0; i < retired_count; i++) {
+		struct metric_retired_timeseries* retired = &ctx->retired[i];
+		int rc = flush_timeseries(metric, get_timeseries_labels(ctx, retired->slot), retired,
+					  timestamp_ms);
+		if (rc < 0) {
+			LOG_ERR("Failed to flush time series for metric '%s': %d", metric->name,
+				rc);
+		}
+	}
+#endif
+
+	release_retired_timeseries(ctx, retired_count);
+}
+
+/**
+ * @brief Aggregation scheduler handler
+ *
+ * Closes the windows of all metrics that ended, in one pass with one timestamp, and schedules
+ * itself to the next window end.
+ */
+static void aggregation_work_handler(struct k_work* work)
+{
+	ARG_UNUSED(work);
 
-	/* Reschedule timer for next aggregation window */
-	uint32_t interval_ms = get_interval_ms(metric->agg_interval);
-	if (interval_ms > 0) {
-		k_work_schedule(dwork, K_MSEC(interval_ms));
+#ifdef CONFIG_SPOTFLOW_METRICS_ISR_REPORTING
+	/* Samples reported from ISRs before the windows closed belong to them */
+	spotflow_metrics_isr_drain();
+#endif
+
+	/* Capture timestamp when aggregation windows close */
+	int64_t timestamp_ms = k_uptime_get();
+
+	for (;;) {
+		k_spinlock_key_t key = k_spin_lock(&g_schedule_lock);
+
+		struct metric_aggregator_context* ctx = g_scheduled_head;
+		if (ctx == NULL || ctx->window_end_ms > timestamp_ms) {
+			k_spin_unlock(&g_schedule_lock, key);
+			break;
+		}
+
+		g_scheduled_head = ctx->next_scheduled;
+
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+		/* Flush deadline of a non-aggregated metric, it is not rescheduled periodically */
+		if (ctx->metric->agg_interval == SPOTFLOW_AGG_INTERVAL_NONE) {
+			k_spin_unlock(&g_schedule_lock, key);
+			flush_sample_buffers(ctx);
+			continue;
+		}
+#endif
+
+		/* Move to the next window, skipping the windows missed by a busy work queue */
+		uint32_t interval_ms = get_interval_ms(ctx->metric->agg_interval);
+		ctx->window_end_ms +=
+		    ((timestamp_ms - ctx->window_end_ms) / interval_ms + 1) * interval_ms;
+		insert_scheduled(ctx);
+
+		k_spin_unlock(&g_schedule_lock, key);
+
+		close_aggregation_window(ctx, timestamp_ms);
 	}
 
-	k_mutex_unlock(&metric->lock);
+	k_spinlock_key_t key = k_spin_lock(&g_schedule_lock);
+	reschedule_aggregation_work();
+	k_spin_unlock(&g_schedule_lock, key);
 }
 
 /**
  * @brief Copy labels to time series with bounds checking
  *
- * @param ts Time series state to copy labels into
+ * Labels were validated by the caller of aggregator_report_value(), keys and values are not NULL.
+ *
+ * @param stored Label set of the time series slot to copy labels into
  * @param labels Source labels array
  * @param label_count Number of labels to copy
- * @return 0 on success, -1 if any label key/value is NULL
  */
-static int copy_labels_to_timeseries(struct metric_timeseries_state* ts,
-				     const struct spotflow_label* labels, uint8_t label_count)
+static void copy_labels_to_timeseries(struct metric_timeseries_labels* stored,
+				      const struct spotflow_label* labels, uint8_t label_count)
 {
+	stored->label_count = label_count;
+
 	for (uint8_t i = 0; i < label_count; i++) {
-		if (!labels[i].key || !labels[i].value) {
-			LOG_ERR("Label key or value is NULL at index %u", i);
-			return -1;
-		}
 		/* No need to present warning - user was already informed about truncation
 		 * in the validation phase of report metric function in metrics backend */
-		strncpy(ts->labels[i].key, labels[i].key, SPOTFLOW_MAX_LABEL_KEY_LEN - 1);
-		ts->labels[i].key[SPOTFLOW_MAX_LABEL_KEY_LEN - 1] = '\0';
+		strncpy(stored->labels[i].key, labels[i].key, SPOTFLOW_MAX_LABEL_KEY_LEN - 1);
+		stored->labels[i].key[SPOTFLOW_MAX_LABEL_KEY_LEN - 1] = '\0';
 
-		strncpy(ts->labels[i].value, labels[i].value, SPOTFLOW_MAX_LABEL_VALUE_LEN - 1);
-		ts->labels[i].value[SPOTFLOW_MAX_LABEL_VALUE_LEN - 1] = '\0';
+		strncpy(stored->labels[i].value, labels[i].value, SPOTFLOW_MAX_LABEL_VALUE_LEN - 1);
+		stored->labels[i].value[SPOTFLOW_MAX_LABEL_VALUE_LEN - 1] = '\0';
 	}
-
-	return 0;
 }
 
 /**
@@ -337,11 +1029,11 @@ static void init_timeseries_aggregation_state(struct metric_timeseries_state* ts
 					      enum spotflow_metric_type type)
 {
 	if (type == SPOTFLOW_METRIC_TYPE_INT) {
-		ts->min_int = INT64_MAX;
-		ts->max_int = INT64_MIN;
-	} else if (type == SPOTFLOW_METRIC_TYPE_FLOAT) {
-		ts->min_float = FLT_MAX;
-		ts->max_float = -FLT_MAX;
+		ts->agg.min_int = INT64_MAX;
+		ts->agg.max_int = INT64_MIN;
+	} else if (type == SPOTFLOW_METRIC_TYPE_FLOAT || type == SPOTFLOW_METRIC_TYPE_HISTOGRAM) {
+		ts->agg.min_float = FLT_MAX;
+		ts->agg.max_float = -FLT_MAX;
 	} else {
 		LOG_ERR("Invalid metric type: %d", type);
 	}
@@ -350,62 +1042,68 @@ static void init_timeseries_aggregation_state(struct metric_timeseries_state* ts
 /**
  * @brief Find or create time series slot
  *
- * Uses direct string comparison for label matching. O(n) linear search
- * is acceptable since max_timeseries <= 256 and labels are small.
+ * Time series are looked up in the hash index by the hash of their label set, so the expected
+ * lookup cost does not depend on the number of time series. Slots are taken in order and they
+ * are never released, so the first free slot is the one after the active ones.
  *
  * When pool is full, attempts to evict a timeseries with count == 0
- * (no values reported in current aggregation window).
+ * (no values reported in current aggregation window) that is not bound to a handle or being
+ * encoded. Only this rare case scans all slots.
  */
 static struct metric_timeseries_state*
 find_or_create_timeseries(struct metric_aggregator_context* ctx,
-			  const struct spotflow_label* labels, uint8_t label_count)
+			  const struct spotflow_label* labels, uint8_t label_count,
+			  uint32_t labels_hash)
 {
-	struct metric_timeseries_state* inactive_slot = NULL;
-	struct metric_timeseries_state* evictable_slot = NULL;
-
-	/* Scan all slots: find matching, inactive, or evictable (count == 0) */
-	for (uint16_t i = 0; i < ctx->timeseries_capacity; i++) {
-		struct metric_timeseries_state* ts = &ctx->timeseries[i];
+	struct metric_timeseries_state* ts;
 
+	if (ctx->index == NULL) {
+		/* Label-less metric, its only time series is created on the first report */
+		ts = &ctx->timeseries[0];
 		if (ts->active) {
-			if (labels_equal(ts, labels, label_count)) {
-				return ts; /* Found existing match */
+			return ts;
+		}
+		ctx->timeseries_count = 1;
+	} else {
+		uint16_t index_pos;
+		ts = find_timeseries(ctx, labels, label_count, labels_hash, &index_pos);
+		if (ts != NULL) {
+			return ts; /* Found existing match */
+		}
+
+		uint16_t slot;
+		if (ctx->timeseries_count < ctx->timeseries_capacity) {
+			slot = ctx->timeseries_count++;
+		} else {
+			/* Fall back to evicting the first idle timeseries */
+			for (slot = 0; slot < ctx->timeseries_capacity; slot++) {
+				struct metric_timeseries_state* idle = &ctx->timeseries[slot];
+				if (idle->agg.count == 0 && !idle->bound && !idle->retired) {
+					break;
+				}
 			}
-			if (ts->count == 0 && evictable_slot == NULL) {
-				evictable_slot = ts; /* Candidate for eviction */
+
+			if (slot == ctx->timeseries_capacity) {
+				return NULL; /* Pool full, no evictable slots */
 			}
-		} else if (inactive_slot == NULL) {
-			inactive_slot = ts; /* First inactive slot */
-		}
-	}
 
-	/* Prefer inactive slot, fall back to evicting idle timeseries */
-	struct metric_timeseries_state* ts = inactive_slot;
-	if (ts == NULL) {
-		ts = evictable_slot;
-		if (ts != NULL) {
 			LOG_DBG("Evicting idle timeseries for metric '%s'", ctx->metric->name);
+			/* Note: timeseries_count is NOT incremented for evicted slots
+			 * since the slot was already counted as active. */
+			remove_from_index(ctx, slot);
+			/* Removal can move other entries into the probe sequence of the new one */
+			index_pos = find_empty_index_pos(ctx, labels_hash);
 		}
-		/* Note: timeseries_count is NOT incremented for evicted slots
-		 * since the slot was already counted as active. We only increment
-		 * when using a previously inactive slot. */
-	} else {
-		ctx->timeseries_count++;
-	}
 
-	if (ts == NULL) {
-		return NULL; /* Pool full, no evictable slots */
+		ctx->index[index_pos] = slot + 1;
+		ts = &ctx->timeseries[slot];
+		copy_labels_to_timeseries(&ctx->labels[slot], labels, label_count);
 	}
 
 	/* Initialize time series */
 	memset(ts, 0, sizeof(*ts));
 	ts->active = true;
-	ts->label_count = label_count;
-
-	if (copy_labels_to_timeseries(ts, labels, label_count) < 0) {
-		ts->active = false;
-		return NULL;
-	}
+	ts->labels_hash = labels_hash;
 
 	init_timeseries_aggregation_state(ts, ctx->metric->type);
 
@@ -415,28 +1113,95 @@ find_or_create_timeseries(struct metric_aggregator_context* ctx,
 	return ts;
 }
 
+/**
+ * @brief Look up the time series with the given labels in the index
+ *
+ * @param empty_pos Index position where the time series is to be inserted if it is not found
+ *
+ * @return Time series, NULL if not found
+ */
+static struct metric_timeseries_state* find_timeseries(struct metric_aggregator_context* ctx,
+						       const struct spotflow_label* labels,
+						       uint8_t label_count, uint32_t labels_hash,
+						       uint16_t* empty_pos)
+{
+	/* Index is never full, so the probe sequence always ends with an empty entry */
+	for (uint16_t pos = labels_hash & ctx->index_mask;; pos = (pos + 1) & ctx->index_mask) {
+		uint16_t entry = ctx->index[pos];
+		if (entry == TIMESERIES_INDEX_EMPTY) {
+			*empty_pos = pos;
+			return NULL;
+		}
+
+		/* Label set is read only when the hash of the hot state matches */
+		struct metric_timeseries_state* ts = &ctx->timeseries[entry - 1];
+		if (ts->labels_hash == labels_hash &&
+		    labels_equal(&ctx->labels[entry - 1], labels, label_count)) {
+			return ts;
+		}
+	}
+}
+
+static uint16_t find_empty_index_pos(const struct metric_aggregator_context* ctx,
+				     uint32_t labels_hash)
+{
+	uint16_t pos = labels_hash & ctx->index_mask;
+	while (ctx->index[pos] != TIMESERIES_INDEX_EMPTY) {
+		pos = (pos + 1) & ctx->index_mask;
+	}
+
+	return pos;
+}
+
+/**
+ * @brief Remove the index entry of a time series slot
+ *
+ * Following entries of the probe sequence are shifted back to fill the gap, so lookups do not
+ * need tombstones.
+ */
+static void remove_from_index(struct metric_aggregator_context* ctx, uint16_t slot)
+{
+	uint16_t mask = ctx->index_mask;
+	uint16_t hole = ctx->timeseries[slot].labels_hash & mask;
+	while (ctx->index[hole] != slot + 1) {
+		hole = (hole + 1) & mask;
+	}
+
+	for (uint16_t pos = (hole + 1) & mask; ctx->index[pos] != TIMESERIES_INDEX_EMPTY;
+	     pos = (pos + 1) & mask) {
+		uint16_t home = ctx->timeseries[ctx->index[pos] - 1].labels_hash & mask;
+		/* Entry can move to the hole only if the hole is not before its home position */
+		if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+			ctx->index[hole] = ctx->index[pos];
+			hole = pos;
+		}
+	}
+
+	ctx->index[hole] = TIMESERIES_INDEX_EMPTY;
+}
+
 /**
  * @brief Update integer aggregation state
  */
 static void update_aggregation_int(struct metric_timeseries_state* ts, int64_t value)
 {
-	ts->count++;
+	ts->agg.count++;
 
 	/* Sum with overflow detection */
-	int64_t old_sum = ts->sum_int;
-	ts->sum_int += value;
+	int64_t old_sum = ts->agg.sum_int;
+	ts->agg.sum_int += value;
 
 	/* Check for overflow */
-	if ((value > 0 && ts->sum_int < old_sum) || (value < 0 && ts->sum_int > old_sum)) {
-		ts->sum_truncated = true;
+	if ((value > 0 && ts->agg.sum_int < old_sum) || (value < 0 && ts->agg.sum_int > old_sum)) {
+		ts->agg.sum_truncated = true;
 	}
 
 	/* Min/Max */
-	if (value < ts->min_int) {
-		ts->min_int = value;
+	if (value < ts->agg.min_int) {
+		ts->agg.min_int = value;
 	}
-	if (value > ts->max_int) {
-		ts->max_int = value;
+	if (value > ts->agg.max_int) {
+		ts->agg.max_int = value;
 	}
 }
 
@@ -445,20 +1210,46 @@ static void update_aggregation_int(struct metric_timeseries_state* ts, int64_t v
  */
 static void update_aggregation_float(struct metric_timeseries_state* ts, float value)
 {
-	ts->count++;
+	ts->agg.count++;
 
 	/* Sum */
-	ts->sum_float += value;
+	ts->agg.sum_float += value;
 
 	/* Min/Max */
-	if (value < ts->min_float) {
-		ts->min_float = value;
+	if (value < ts->agg.min_float) {
+		ts->agg.min_float = value;
 	}
-	if (value > ts->max_float) {
-		ts->max_float = value;
+	if (value > ts->agg.max_float) {
+		ts->agg.max_float = value;
 	}
 }
 
+/**
+ * @brief Count the value in its histogram bucket
+ *
+ * The bucket is given by the exponent and the top mantissa bits of the value, so no logarithm is
+ * computed. See SPOTFLOW_HISTOGRAM_BUCKETS for the bucket layout.
+ */
+static void update_histogram(uint32_t* buckets, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127;
+	if ((bits >> 31) != 0 || exponent < CONFIG_SPOTFLOW_METRICS_HISTOGRAM_MIN_EXPONENT) {
+		buckets[0]++; /* Negative, zero or below the range */
+		return;
+	}
+
+	uint32_t bucket = 1 + (exponent - CONFIG_SPOTFLOW_METRICS_HISTOGRAM_MIN_EXPONENT) *
+				  SPOTFLOW_HISTOGRAM_SUB_BUCKETS +
+			  ((bits >> (23 - CONFIG_SPOTFLOW_METRICS_HISTOGRAM_SUB_BUCKET_BITS)) &
+			   (SPOTFLOW_HISTOGRAM_SUB_BUCKETS - 1));
+
+	/* Above the range, including infinity and NaN */
+	buckets[MIN(bucket, SPOTFLOW_HISTOGRAM_BUCKETS - 1)]++;
+}
+
 /**
  * @brief Get aggregation interval in milliseconds
  */
@@ -481,7 +1272,7 @@ static uint32_t get_interval_ms(enum spotflow_agg_interval interval)
 /**
  * @brief Enqueue message to transmission queue
  *
- * Called by flush_timeseries() to enqueue encoded messages.
+ * Called by flush_timeseries() and flush_timeseries_batch() to enqueue encoded messages.
  *
  * Memory ownership:
  * - On success: ownership of payload transfers to queue (processor will free)
@@ -23,6 +23,28 @@ extern struct k_msgq g_spotflow_metrics_msgq;
  */
 int aggregator_register_metric(struct spotflow_metric_base* metric);
 
+/**
+ * @brief Register statically defined metric with aggregator
+ *
+ * Uses the storage of the descriptor, nothing is allocated.
+ *
+ * @param descriptor Descriptor of the metric from SPOTFLOW_METRIC_DEFINE_INT() and friends
+ */
+void aggregator_register_static_metric(const struct spotflow_metric_descriptor* descriptor);
+
+/**
+ * @brief Compute the hash of a label set
+ *
+ * Labels are hashed as they are stored in a time series, i.e. truncated to
+ * SPOTFLOW_MAX_LABEL_KEY_LEN - 1 and SPOTFLOW_MAX_LABEL_VALUE_LEN - 1 characters.
+ *
+ * @param labels Label array with non-NULL keys and values
+ * @param label_count Number of labels
+ *
+ * @return Hash of the label set
+ */
+uint32_t aggregator_hash_labels(const struct spotflow_label* labels, uint8_t label_count);
+
 /**
  * @brief Report value to aggregator
  *
@@ -30,8 +52,9 @@ int aggregator_register_metric(struct spotflow_metric_base* metric);
  * label combination. Creates new time series if needed.
  *
  * @param metric Metric base handle
- * @param labels Label array (NULL for label-less)
+ * @param labels Label array (NULL for label-less), validated by the caller
  * @param label_count Number of labels (0 for label-less)
+ * @param labels_hash Hash of the labels from aggregator_hash_labels() (ignored for label-less)
  * @param value_int Integer value (if metric type is INT)
  * @param value_float Float value (if metric type is FLOAT)
  *
@@ -43,7 +66,45 @@ int aggregator_register_metric(struct spotflow_metric_base* metric);
  */
 int aggregator_report_value(struct spotflow_metric_base* metric,
 			    const struct spotflow_label* labels, uint8_t label_count,
-			    int64_t value_int, float value_float);
+			    uint32_t labels_hash, int64_t value_int, float value_float);
+
+/**
+ * @brief Find or create the time series of a label set and bind it
+ *
+ * Bound time series are never evicted, so the returned pointer stays valid.
+ *
+ * @param metric Labeled metric base handle
+ * @param labels Label array, validated by the caller
+ * @param label_count Number of labels
+ * @param labels_hash Hash of the labels from aggregator_hash_labels()
+ * @param ts_out Output parameter for the bound time series
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Invalid metric
+ *         -ENOSPC: Time series pool full
+ */
+int aggregator_bind_timeseries(struct spotflow_metric_base* metric,
+			       const struct spotflow_label* labels, uint8_t label_count,
+			       uint32_t labels_hash, struct metric_timeseries_state** ts_out);
+
+/**
+ * @brief Report value to a time series bound by aggregator_bind_timeseries()
+ *
+ * Same as aggregator_report_value(), without looking up the time series.
+ *
+ * @param metric Metric base handle
+ * @param ts Bound time series of the metric
+ * @param value_int Integer value (if metric type is INT)
+ * @param value_float Float value (if metric type is FLOAT)
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Invalid metric type
+ *         -ENOBUFS: Metric queue full (non-aggregated metrics)
+ *         -ENOMEM: Memory allocation failed (non-aggregated metrics)
+ */
+int aggregator_report_bound_value(struct spotflow_metric_base* metric,
+				  struct metric_timeseries_state* ts, int64_t value_int,
+				  float value_float);
 
 #ifdef __cplusplus
 }
@@ -8,7 +8,11 @@
 LOG_MODULE_REGISTER(spotflow_metrics, CONFIG_SPOTFLOW_METRICS_PROCESSING_LOG_LEVEL);
 
 static int validate_labels(const struct spotflow_metric_base* base,
-			   const struct spotflow_label* labels, uint8_t label_count);
+			   const struct spotflow_label* labels, uint8_t label_count,
+			   uint32_t* labels_hash);
+static int bind_labels(struct spotflow_metric_base* base, const struct spotflow_label* labels,
+		       uint8_t label_count, struct spotflow_metric_base** metric_out,
+		       struct metric_timeseries_state** ts_out);
 
 /* Public API Implementation */
 
@@ -27,7 +31,7 @@ int spotflow_report_metric_int(struct spotflow_metric_int* metric, int64_t value
 	}
 
 	/* Type-safe: int metrics always store int values */
-	return aggregator_report_value(base, NULL, 0, value, 0.0);
+	return aggregator_report_value(base, NULL, 0, 0, value, 0.0);
 }
 
 int spotflow_report_metric_float(struct spotflow_metric_float* metric, float value)
@@ -45,7 +49,7 @@ int spotflow_report_metric_float(struct spotflow_metric_float* metric, float val
 	}
 
 	/* Type-safe: float metrics always store float values */
-	return aggregator_report_value(base, NULL, 0, 0, value);
+	return aggregator_report_value(base, NULL, 0, 0, 0, value);
 }
 
 int spotflow_report_metric_int_with_labels(struct spotflow_metric_int* metric, int64_t value,
@@ -63,13 +67,14 @@ int spotflow_report_metric_int_with_labels(struct spotflow_metric_int* metric, i
 		return -EINVAL;
 	}
 
-	int err = validate_labels(base, labels, label_count);
+	uint32_t labels_hash;
+	int err = validate_labels(base, labels, label_count, &labels_hash);
 	if (err) {
 		return err;
 	}
 
 	/* Type-safe: int metrics always store int values */
-	return aggregator_report_value(base, labels, label_count, value, 0.0);
+	return aggregator_report_value(base, labels, label_count, labels_hash, value, 0.0);
 }
 
 int spotflow_report_metric_float_with_labels(struct spotflow_metric_float* metric, float value,
@@ -88,13 +93,54 @@ int spotflow_report_metric_float_with_labels(struct spotflow_metric_float* metri
 		return -EINVAL;
 	}
 
-	int err = validate_labels(base, labels, label_count);
+	uint32_t labels_hash;
+	int err = validate_labels(base, labels, label_count, &labels_hash);
 	if (err) {
 		return err;
 	}
 
 	/* Type-safe: float metrics always store float values */
-	return aggregator_report_value(base, labels, label_count, 0, value);
+	return aggregator_report_value(base, labels, label_count, labels_hash, 0, value);
+}
+
+int spotflow_report_metric_histogram(struct spotflow_metric_histogram* metric, float value)
+{
+	if (metric == NULL) {
+		return -EINVAL;
+	}
+
+	struct spotflow_metric_base* base = &metric->base;
+
+	if (base->max_labels > 0) {
+		LOG_ERR("Use spotflow_report_metric_histogram_with_labels for labeled metrics");
+		return -EINVAL;
+	}
+
+	return aggregator_report_value(base, NULL, 0, 0, 0, value);
+}
+
+int spotflow_report_metric_histogram_with_labels(struct spotflow_metric_histogram* metric,
+						 float value, const struct spotflow_label* labels,
+						 uint8_t label_count)
+{
+	if (metric == NULL || labels == NULL) {
+		return -EINVAL;
+	}
+
+	struct spotflow_metric_base* base = &metric->base;
+
+	if (base->max_labels == 0) {
+		LOG_ERR("Use spotflow_report_metric_histogram for label-less metrics");
+		return -EINVAL;
+	}
+
+	uint32_t labels_hash;
+	int err = validate_labels(base, labels, label_count, &labels_hash);
+	if (err) {
+		return err;
+	}
+
+	return aggregator_report_value(base, labels, label_count, labels_hash, 0, value);
 }
 
 int spotflow_report_event(struct spotflow_metric_int* metric)
@@ -112,7 +158,7 @@ int spotflow_report_event(struct spotflow_metric_int* metric)
 	}
 
 	/* Events report value of 1 (event occurred) */
-	return aggregator_report_value(base, NULL, 0, 1, 0.0);
+	return aggregator_report_value(base, NULL, 0, 0, 1, 0.0);
 }
 
 int spotflow_report_event_with_labels(struct spotflow_metric_int* metric,
@@ -130,19 +176,76 @@ int spotflow_report_event_with_labels(struct spotflow_metric_int* metric,
 		return -EINVAL;
 	}
 
-	int err = validate_labels(base, labels, label_count);
+	uint32_t labels_hash;
+	int err = validate_labels(base, labels, label_count, &labels_hash);
 	if (err) {
 		return err;
 	}
 
 	/* Events report value of 1 (event occurred) */
-	return aggregator_report_value(base, labels, label_count, 1, 0.0);
+	return aggregator_report_value(base, labels, label_count, labels_hash, 1, 0.0);
+}
+
+int spotflow_metric_bind_labels_int(struct spotflow_metric_int* metric,
+				    const struct spotflow_label* labels, uint8_t label_count,
+				    struct spotflow_bound_metric_int* bound_out)
+{
+	if (metric == NULL || labels == NULL || bound_out == NULL) {
+		return -EINVAL;
+	}
+
+	return bind_labels(&metric->base, labels, label_count, &bound_out->metric,
+			   &bound_out->timeseries);
+}
+
+int spotflow_metric_bind_labels_float(struct spotflow_metric_float* metric,
+				      const struct spotflow_label* labels, uint8_t label_count,
+				      struct spotflow_bound_metric_float* bound_out)
+{
+	if (metric == NULL || labels == NULL || bound_out == NULL) {
+		return -EINVAL;
+	}
+
+	return bind_labels(&metric->base, labels, label_count, &bound_out->metric,
+			   &bound_out->timeseries);
+}
+
+int spotflow_report_bound_int(struct spotflow_bound_metric_int* bound, int64_t value)
+{
+	if (bound == NULL || bound->timeseries == NULL) {
+		return -EINVAL;
+	}
+
+	return aggregator_report_bound_value(bound->metric, bound->timeseries, value, 0.0);
+}
+
+int spotflow_report_bound_float(struct spotflow_bound_metric_float* bound, float value)
+{
+	if (bound == NULL || bound->timeseries == NULL) {
+		return -EINVAL;
+	}
+
+	return aggregator_report_bound_value(bound->metric, bound->timeseries, 0, value);
+}
+
+int spotflow_report_bound_event(struct spotflow_bound_metric_int* bound)
+{
+	if (bound == NULL || bound->timeseries == NULL) {
+		return -EINVAL;
+	}
+
+	/* Events report value of 1 (event occurred) */
+	return aggregator_report_bound_value(bound->metric, bound->timeseries, 1, 0.0);
 }
 
 /* Static function implementations */
 
+/**
+ * @brief Validate the labels and compute their hash, used to look up their time series
+ */
 static int validate_labels(const struct spotflow_metric_base* base,
-			   const struct spotflow_label* labels, uint8_t label_count)
+			   const struct spotflow_label* labels, uint8_t label_count,
+			   uint32_t* labels_hash)
 {
 	if (label_count == 0 || label_count > base->max_labels) {
 		LOG_ERR("Invalid label_count: %u (max %u)", label_count, base->max_labels);
@@ -162,5 +265,35 @@ static int validate_labels(const struct spotflow_metric_base* base,
 		}
 	}
 
+	*labels_hash = aggregator_hash_labels(labels, label_count);
+	return 0;
+}
+
+/**
+ * @brief Bind the labels of a labeled metric, the outputs are set only on success
+ */
+static int bind_labels(struct spotflow_metric_base* base, const struct spotflow_label* labels,
+		       uint8_t label_count, struct spotflow_metric_base** metric_out,
+		       struct metric_timeseries_state** ts_out)
+{
+	if (base->max_labels == 0) {
+		LOG_ERR("Labels can be bound only for labeled metrics");
+		return -EINVAL;
+	}
+
+	uint32_t labels_hash;
+	int err = validate_labels(base, labels, label_count, &labels_hash);
+	if (err) {
+		return err;
+	}
+
+	struct metric_timeseries_state* ts;
+	err = aggregator_bind_timeseries(base, labels, label_count, labels_hash, &ts);
+	if (err) {
+		return err;
+	}
+
+	*metric_out = base;
+	*ts_out = ts;
 	return 0;
 }
@@ -20,28 +20,63 @@ LOG_MODULE_DECLARE(spotflow_metrics, CONFIG_SPOTFLOW_METRICS_PROCESSING_LOG_LEVE
 #define KEY_COUNT 0x1A /* 26 */
 #define KEY_MIN 0x1B /* 27 */
 #define KEY_MAX 0x1C /* 28 */
-#define KEY_SAMPLES 0x1D /* 29 - reserved for future */
+#define KEY_SAMPLES 0x1D /* 29 - histogram buckets or raw samples */
+#define KEY_TIME_SERIES 0x1E /* 30 - batched aggregated time series */
 
 /* Message Type */
 #define METRIC_MESSAGE_TYPE 0x05
+
+/* Histogram buckets: key, array header and end, sub-bucket bits and zero count (uint32) */
+#define HISTOGRAM_FIXED_MAX_LEN (1 + 3 + 1 + 1 + 5)
+/* Histogram bucket: key (within the float exponent range) and count (uint32) */
+#define HISTOGRAM_BUCKET_MAX_LEN (3 + 5)
+/* Label-less message without the metric name: map header and end, messageType, name key and
+ * string header, aggregationInterval, deviceUptimeMs, sequenceNumber, sum, sumTruncated, count,
+ * min and max
+ */
+#define AGGREGATED_FIXED_MAX_LEN                                                                   \
+	(3 + 1 + 2 + (1 + 3) + (1 + 5) + (1 + 9) + (1 + 9) + (1 + 9) + 2 + (1 + 9) + (1 + 9) +   \
+	 (1 + 9))
+
+/* Histograms that do not fit are sent with fewer sub-buckets, down to one bucket per power of
+ * two, which has to fit besides the fixed part of the message
+ */
+BUILD_ASSERT(AGGREGATED_FIXED_MAX_LEN + HISTOGRAM_FIXED_MAX_LEN +
+			 CONFIG_SPOTFLOW_METRICS_HISTOGRAM_OCTAVES * HISTOGRAM_BUCKET_MAX_LEN <=
+		     CONFIG_SPOTFLOW_METRICS_CBOR_BUFFER_SIZE,
+	     "SPOTFLOW_METRICS_CBOR_BUFFER_SIZE too small for SPOTFLOW_METRICS_HISTOGRAM_OCTAVES");
+
 static bool encode_labels(zcbor_state_t* state, const struct metric_label_storage* labels,
 			  uint8_t label_count);
 static void encode_metric_header(struct spotflow_metric_base* metric, int64_t timestamp_ms,
 				 uint64_t sequence_number, zcbor_state_t state[3], bool* succ);
 static bool encode_aggregation_stats(zcbor_state_t* state, struct spotflow_metric_base* metric,
-				     struct metric_timeseries_state* ts);
+				     const struct metric_aggregate* agg);
+static bool encode_histogram(zcbor_state_t* state, const uint32_t* buckets, size_t trailing_len);
+static size_t histogram_max_len(const uint32_t* buckets, uint8_t shift);
 static int finalize_cbor_output(uint8_t* buffer, zcbor_state_t* state, uint8_t** cbor_data,
 				size_t* cbor_len);
+static size_t uint_len(uint64_t value);
+#ifdef CONFIG_SPOTFLOW_METRICS_BATCHED_MESSAGES
+static size_t tstr_max_len(size_t len);
+static size_t number_len(struct spotflow_metric_base* metric, int64_t value_int);
+static size_t batch_entry_max_len(struct spotflow_metric_base* metric,
+				  const struct metric_timeseries_labels* labels,
+				  const struct metric_retired_timeseries* retired);
+#endif
 
 int spotflow_metrics_cbor_encode_aggregated(struct spotflow_metric_base* metric,
-					    struct metric_timeseries_state* ts,
+					    const struct metric_timeseries_labels* labels,
+					    const struct metric_retired_timeseries* retired,
 					    int64_t timestamp_ms, uint64_t sequence_number,
 					    uint8_t** cbor_data, size_t* cbor_len)
 {
-	if (metric == NULL || ts == NULL || cbor_data == NULL || cbor_len == NULL) {
+	if (metric == NULL || retired == NULL || cbor_data == NULL || cbor_len == NULL) {
 		return -EINVAL;
 	}
 
+	const struct metric_aggregate* agg = &retired->agg;
+
 	if (metric->agg_interval == SPOTFLOW_AGG_INTERVAL_NONE) {
 		LOG_ERR("This function should not be used for non-aggregated metrics");
 		return -EINVAL;
@@ -60,12 +95,15 @@ int spotflow_metrics_cbor_encode_aggregated(struct spotflow_metric_base* metric,
 	/* Base entries: messageType, metricName, aggregationInterval, deviceUptimeMs,
 	 *               sequenceNumber, sum, count, min, max = 9 */
 	uint32_t map_entries = 9;
-	if (ts->label_count > 0) {
+	if (labels != NULL) {
 		map_entries++; /* labels */
 	}
-	if (ts->sum_truncated) {
+	if (agg->sum_truncated) {
 		map_entries++; /* sumTruncated */
 	}
+	if (retired->histogram != NULL) {
+		map_entries++; /* samples */
+	}
 
 	/* Start CBOR map with exact entry count */
 	succ = succ && zcbor_map_start_encode(state, map_entries);
@@ -73,12 +111,18 @@ int spotflow_metrics_cbor_encode_aggregated(struct spotflow_metric_base* metric,
 	encode_metric_header(metric, timestamp_ms, sequence_number, state, &succ);
 
 	/* labels (if labeled metric) */
-	if (ts->label_count > 0) {
-		succ = succ && encode_labels(state, ts->labels, ts->label_count);
+	if (labels != NULL) {
+		succ = succ && encode_labels(state, labels->labels, labels->label_count);
 	}
 
 	/* Encode aggregation stats: sum, sumTruncated, count, min, max */
-	succ = succ && encode_aggregation_stats(state, metric, ts);
+	succ = succ && encode_aggregation_stats(state, metric, agg);
+
+	/* samples (histogram metrics only) */
+	if (retired->histogram != NULL) {
+		/* Only the map end follows */
+		succ = succ && encode_histogram(state, retired->histogram, 1);
+	}
 
 	/* End CBOR map */
 	succ = succ && zcbor_map_end_encode(state, map_entries);
@@ -100,6 +144,125 @@ int spotflow_metrics_cbor_encode_aggregated(struct spotflow_metric_base* metric,
 	return 0;
 }
 
+#ifdef CONFIG_SPOTFLOW_METRICS_BATCHED_MESSAGES
+uint16_t spotflow_metrics_cbor_batch_fit(struct spotflow_metric_base* metric,
+					 const struct metric_timeseries_labels* labels,
+					 const struct metric_retired_timeseries* retired,
+					 uint16_t retired_count)
+{
+	/* Outer map and header: messageType, metricName, aggregationInterval, deviceUptimeMs,
+	 * sequenceNumber and the time series array header */
+	size_t name_len = strnlen(metric->name, SPOTFLOW_METRIC_NAME_SIZE);
+	size_t len = 2 + (1 + 1) + (1 + tstr_max_len(name_len)) + (1 + 5) + (1 + 9) + (1 + 9) +
+		     (1 + 3);
+	uint16_t count = 0;
+
+	while (count < retired_count) {
+		len += batch_entry_max_len(
+		    metric, labels != NULL ? &labels[retired[count].slot] : NULL, &retired[count]);
+		if (len > CONFIG_SPOTFLOW_METRICS_CBOR_BUFFER_SIZE) {
+			break;
+		}
+		count++;
+	}
+
+	/* A single time series always gets a try, like in the non-batched message */
+	return MAX(count, MIN(retired_count, 1));
+}
+
+int spotflow_metrics_cbor_encode_aggregated_batch(struct spotflow_metric_base* metric,
+						  const struct metric_timeseries_labels* labels,
+						  const struct metric_retired_timeseries* retired,
+						  uint16_t retired_count, int64_t timestamp_ms,
+						  uint64_t sequence_number, uint8_t** cbor_data,
+						  size_t* cbor_len)
+{
+	if (metric == NULL || retired == NULL || retired_count == 0 || cbor_data == NULL ||
+	    cbor_len == NULL) {
+		return -EINVAL;
+	}
+
+	if (metric->agg_interval == SPOTFLOW_AGG_INTERVAL_NONE) {
+		LOG_ERR("This function should not be used for non-aggregated metrics");
+		return -EINVAL;
+	}
+
+	uint8_t* buffer = k_malloc(CONFIG_SPOTFLOW_METRICS_CBOR_BUFFER_SIZE);
+	if (!buffer) {
+		LOG_ERR("Failed to allocate CBOR encoding buffer");
+		return -ENOMEM;
+	}
+	/* Nested containers: message map, time series array, time series map, labels map */
+	ZCBOR_STATE_E(state, 4, buffer, CONFIG_SPOTFLOW_METRICS_CBOR_BUFFER_SIZE, 1);
+
+	bool succ = true;
+
+	/* Entries shared by all time series: messageType, metricName, aggregationInterval,
+	 *                                    deviceUptimeMs, sequenceNumber, timeSeries = 6 */
+	succ = succ && zcbor_map_start_encode(state, 6);
+
+	encode_metric_header(metric, timestamp_ms, sequence_number, state, &succ);
+
+	succ = succ && zcbor_uint32_put(state, KEY_TIME_SERIES);
+	succ = succ && zcbor_list_start_encode(state, retired_count);
+
+	for (uint16_t i = 0; i < retired_count && succ; i++) {
+		const struct metric_timeseries_labels* ts_labels =
+			labels != NULL ? &labels[retired[i].slot] : NULL;
+		const struct metric_aggregate* agg = &retired[i].agg;
+
+		/* sum, count, min, max = 4, labels, sumTruncated and samples are optional */
+		uint32_t map_entries = 4;
+		if (ts_labels != NULL) {
+			map_entries++; /* labels */
+		}
+		if (agg->sum_truncated) {
+			map_entries++; /* sumTruncated */
+		}
+		if (retired[i].histogram != NULL) {
+			map_entries++; /* samples */
+		}
+
+		succ = succ && zcbor_map_start_encode(state, map_entries);
+
+		if (ts_labels != NULL) {
+			succ = succ &&
+			       encode_labels(state, ts_labels->labels, ts_labels->label_count);
+		}
+
+		succ = succ && encode_aggregation_stats(state, metric, agg);
+
+		if (retired[i].histogram != NULL) {
+			/* Ends of the time series map, the array and the message map follow, the
+			 * fit check leaves room for the remaining time series
+			 */
+			succ = succ && encode_histogram(state, retired[i].histogram, 3);
+		}
+
+		succ = succ && zcbor_map_end_encode(state, map_entries);
+	}
+
+	succ = succ && zcbor_list_end_encode(state, retired_count);
+	succ = succ && zcbor_map_end_encode(state, 6);
+
+	if (!succ) {
+		LOG_ERR("CBOR encoding failed for batched metric: %d", zcbor_peek_error(state));
+		k_free(buffer);
+		return -EINVAL;
+	}
+
+	int ret = finalize_cbor_output(buffer, state, cbor_data, cbor_len);
+	if (ret != 0) {
+		return ret;
+	}
+
+	LOG_DBG("Encoded batched metric '%s' message (%u time series, %zu bytes, seq=%" PRIu64 ")",
+		metric->name, retired_count, *cbor_len, sequence_number);
+
+	return 0;
+}
+#endif /* CONFIG_SPOTFLOW_METRICS_BATCHED_MESSAGES */
+
 int spotflow_metrics_cbor_encode_no_aggregation(struct spotflow_metric_base* metric,
 						const struct spotflow_label* labels,
 						uint8_t label_count, int64_t value_int,
@@ -186,6 +349,95 @@ int spotflow_metrics_cbor_encode_no_aggregation(struct spotflow_metric_base* met
 	return 0;
 }
 
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+/* Label-less samples message without the metric name and the samples: map header and end,
+ * messageType, name key and string header, aggregationInterval, deviceUptimeMs, sequenceNumber,
+ * samples key, array header and end
+ */
+#define SAMPLES_FIXED_MAX_LEN (3 + 1 + 2 + (1 + 3) + (1 + 5) + (1 + 9) + (1 + 9) + 1 + 3 + 1)
+/* Sample: time delta (uint32) and value (int64 or float64) */
+#define SAMPLE_MAX_LEN (5 + 9)
+
+BUILD_ASSERT(SAMPLES_FIXED_MAX_LEN + CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFER_SIZE * SAMPLE_MAX_LEN <=
+		     CONFIG_SPOTFLOW_METRICS_CBOR_BUFFER_SIZE,
+	     "SPOTFLOW_METRICS_CBOR_BUFFER_SIZE too small for SPOTFLOW_METRICS_SAMPLE_BUFFER_SIZE");
+
+int spotflow_metrics_cbor_encode_samples(struct spotflow_metric_base* metric,
+					 const struct metric_timeseries_labels* labels,
+					 const struct metric_sample_buffer* buffer,
+					 uint16_t sample_count, uint64_t sequence_number,
+					 uint8_t** cbor_data, size_t* cbor_len)
+{
+	if (metric == NULL || buffer == NULL || cbor_data == NULL || cbor_len == NULL) {
+		return -EINVAL;
+	}
+
+	if (metric->agg_interval != SPOTFLOW_AGG_INTERVAL_NONE) {
+		LOG_ERR("This function should not be used for aggregated metrics");
+		return -EINVAL;
+	}
+
+	uint8_t* buffer_out = k_malloc(CONFIG_SPOTFLOW_METRICS_CBOR_BUFFER_SIZE);
+	if (!buffer_out) {
+		LOG_ERR("Failed to allocate CBOR encoding buffer");
+		return -ENOMEM;
+	}
+	ZCBOR_STATE_E(state, 1, buffer_out, CONFIG_SPOTFLOW_METRICS_CBOR_BUFFER_SIZE, 1);
+
+	bool succ = true;
+
+	/* Base: messageType, metricName, aggregationInterval, deviceUptimeMs,
+	 *       sequenceNumber, samples = 6 */
+	uint32_t map_entries = 6;
+	if (labels != NULL) {
+		map_entries++; /* labels */
+	}
+
+	succ = succ && zcbor_map_start_encode(state, map_entries);
+
+	encode_metric_header(metric, buffer->first_sample_ms, sequence_number, state, &succ);
+
+	if (labels != NULL) {
+		succ = succ && encode_labels(state, labels->labels, labels->label_count);
+	}
+
+	/* samples: time delta and value pairs */
+	succ = succ && zcbor_uint32_put(state, KEY_SAMPLES);
+	succ = succ && zcbor_list_start_encode(state, 2 * sample_count);
+
+	for (uint16_t i = 0; i < sample_count && succ; i++) {
+		const struct metric_sample* sample = &buffer->samples[i];
+
+		succ = succ && zcbor_uint32_put(state, sample->delta_ms);
+		if (metric->type == SPOTFLOW_METRIC_TYPE_FLOAT) {
+			succ = succ && zcbor_float64_put(state, sample->value_float);
+		} else {
+			succ = succ && zcbor_int64_put(state, sample->value_int);
+		}
+	}
+
+	succ = succ && zcbor_list_end_encode(state, 2 * sample_count);
+
+	succ = succ && zcbor_map_end_encode(state, map_entries);
+
+	if (!succ) {
+		LOG_ERR("CBOR encoding failed for metric samples: %d", zcbor_peek_error(state));
+		k_free(buffer_out);
+		return -EINVAL;
+	}
+
+	int ret = finalize_cbor_output(buffer_out, state, cbor_data, cbor_len);
+	if (ret != 0) {
+		return ret;
+	}
+
+	LOG_DBG("Encoded metric '%s' samples message (%u samples, %zu bytes, seq=%" PRIu64 ")",
+		metric->name, sample_count, *cbor_len, sequence_number);
+
+	return 0;
+}
+#endif /* CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING */
+
 int spotflow_metrics_cbor_encode_heartbeat(int64_t uptime_ms, uint8_t* buffer, size_t buffer_size,
 					   size_t* len)
 {
@@ -260,7 +512,7 @@ static void encode_metric_header(struct spotflow_metric_base* metric, int64_t ti
 
 	/* metricName */
 	*succ = *succ && zcbor_uint32_put(state, KEY_METRIC_NAME);
-	*succ = *succ && zcbor_tstr_put_term(state, metric->name, sizeof(metric->name));
+	*succ = *succ && zcbor_tstr_put_term(state, metric->name, SPOTFLOW_METRIC_NAME_SIZE);
 
 	/* aggregationInterval */
 	*succ = *succ && zcbor_uint32_put(state, KEY_AGGREGATION_INTERVAL);
@@ -277,37 +529,39 @@ static void encode_metric_header(struct spotflow_metric_base* metric, int64_t ti
 }
 
 static bool encode_aggregation_stats(zcbor_state_t* state, struct spotflow_metric_base* metric,
-				     struct metric_timeseries_state* ts)
+				     const struct metric_aggregate* agg)
 {
 	bool succ = true;
 
 	/* sum */
 	succ = succ && zcbor_uint32_put(state, KEY_SUM);
-	if (metric->type == SPOTFLOW_METRIC_TYPE_FLOAT) {
-		succ = succ && zcbor_float64_put(state, ts->sum_float);
+	if (metric->type == SPOTFLOW_METRIC_TYPE_FLOAT ||
+	    metric->type == SPOTFLOW_METRIC_TYPE_HISTOGRAM) {
+		succ = succ && zcbor_float64_put(state, agg->sum_float);
 	} else if (metric->type == SPOTFLOW_METRIC_TYPE_INT) {
-		succ = succ && zcbor_int64_put(state, ts->sum_int);
+		succ = succ && zcbor_int64_put(state, agg->sum_int);
 	} else {
 		LOG_ERR("Invalid metric type: %d", metric->type);
 		return false;
 	}
 
 	/* sumTruncated (only if true) */
-	if (ts->sum_truncated) {
+	if (agg->sum_truncated) {
 		succ = succ && zcbor_uint32_put(state, KEY_SUM_TRUNCATED);
 		succ = succ && zcbor_bool_put(state, true);
 	}
 
 	/* count */
 	succ = succ && zcbor_uint32_put(state, KEY_COUNT);
-	succ = succ && zcbor_uint64_put(state, ts->count);
+	succ = succ && zcbor_uint64_put(state, agg->count);
 
 	/* min */
 	succ = succ && zcbor_uint32_put(state, KEY_MIN);
-	if (metric->type == SPOTFLOW_METRIC_TYPE_FLOAT) {
-		succ = succ && zcbor_float64_put(state, ts->min_float);
+	if (metric->type == SPOTFLOW_METRIC_TYPE_FLOAT ||
+	    metric->type == SPOTFLOW_METRIC_TYPE_HISTOGRAM) {
+		succ = succ && zcbor_float64_put(state, agg->min_float);
 	} else if (metric->type == SPOTFLOW_METRIC_TYPE_INT) {
-		succ = succ && zcbor_int64_put(state, ts->min_int);
+		succ = succ && zcbor_int64_put(state, agg->min_int);
 	} else {
 		LOG_ERR("Invalid metric type: %d", metric->type);
 		return false;
@@ -315,10 +569,11 @@ static bool encode_aggregation_stats(zcbor_state_t* state, struct spotflow_metri
 
 	/* max */
 	succ = succ && zcbor_uint32_put(state, KEY_MAX);
-	if (metric->type == SPOTFLOW_METRIC_TYPE_FLOAT) {
-		succ = succ && zcbor_float64_put(state, ts->max_float);
+	if (metric->type == SPOTFLOW_METRIC_TYPE_FLOAT ||
+	    metric->type == SPOTFLOW_METRIC_TYPE_HISTOGRAM) {
+		succ = succ && zcbor_float64_put(state, agg->max_float);
 	} else if (metric->type == SPOTFLOW_METRIC_TYPE_INT) {
-		succ = succ && zcbor_int64_put(state, ts->max_int);
+		succ = succ && zcbor_int64_put(state, agg->max_int);
 	} else {
 		LOG_ERR("Invalid metric type: %d", metric->type);
 		return false;
@@ -327,6 +582,83 @@ static bool encode_aggregation_stats(zcbor_state_t* state, struct spotflow_metri
 	return succ;
 }
 
+/**
+ * @brief Encode the non-empty histogram buckets as CBOR array
+ *
+ * [subBucketBits, zeroCount, bucketKey, count, bucketKey, count, ...], bucket with the key
+ * exponent * 2^subBucketBits + subBucket counts the values from 2^exponent * (1 + subBucket /
+ * 2^subBucketBits) up to the start of the next bucket.
+ *
+ * When the buckets do not fit into the rest of the buffer before the trailing_len bytes that
+ * follow them, neighbouring sub-buckets are merged and sent with fewer subBucketBits, so the
+ * window is sent with a coarser resolution instead of being dropped.
+ */
+static bool encode_histogram(zcbor_state_t* state, const uint32_t* buckets, size_t trailing_len)
+{
+	size_t available = state->payload_end - state->payload;
+	available = available > trailing_len ? available - trailing_len : 0;
+
+	uint8_t shift = 0;
+	while (shift < CONFIG_SPOTFLOW_METRICS_HISTOGRAM_SUB_BUCKET_BITS &&
+	       histogram_max_len(buckets, shift) > available) {
+		shift++;
+	}
+	if (shift > 0) {
+		LOG_WRN("Histogram buckets do not fit into the message, sending %d sub-bucket bits",
+			CONFIG_SPOTFLOW_METRICS_HISTOGRAM_SUB_BUCKET_BITS - shift);
+	}
+
+	uint8_t sub_bucket_bits = CONFIG_SPOTFLOW_METRICS_HISTOGRAM_SUB_BUCKET_BITS - shift;
+	uint32_t group_size = 1U << shift;
+	bool succ = true;
+
+	succ = succ && zcbor_uint32_put(state, KEY_SAMPLES);
+	succ = succ && zcbor_list_start_encode(state, 2 + 2 * (SPOTFLOW_HISTOGRAM_BUCKETS - 1));
+
+	succ = succ && zcbor_uint32_put(state, sub_bucket_bits);
+	succ = succ && zcbor_uint32_put(state, buckets[0]);
+
+	for (int32_t i = 1; i < SPOTFLOW_HISTOGRAM_BUCKETS && succ; i += group_size) {
+		uint64_t count = 0;
+		for (uint32_t j = 0; j < group_size; j++) {
+			count += buckets[i + j];
+		}
+		if (count == 0) {
+			continue;
+		}
+
+		int32_t key = CONFIG_SPOTFLOW_METRICS_HISTOGRAM_MIN_EXPONENT * (1 << sub_bucket_bits) +
+			      ((i - 1) >> shift);
+		succ = succ && zcbor_int32_put(state, key);
+		succ = succ && zcbor_uint64_put(state, count);
+	}
+
+	succ = succ && zcbor_list_end_encode(state, 2 + 2 * (SPOTFLOW_HISTOGRAM_BUCKETS - 1));
+
+	return succ;
+}
+
+/**
+ * @brief Maximum encoded length of the histogram with 2^shift sub-buckets merged into one
+ */
+static size_t histogram_max_len(const uint32_t* buckets, uint8_t shift)
+{
+	uint32_t group_size = 1U << shift;
+	size_t len = HISTOGRAM_FIXED_MAX_LEN;
+
+	for (int32_t i = 1; i < SPOTFLOW_HISTOGRAM_BUCKETS; i += group_size) {
+		uint64_t count = 0;
+		for (uint32_t j = 0; j < group_size; j++) {
+			count += buckets[i + j];
+		}
+		if (count > 0) {
+			len += 3 + uint_len(count);
+		}
+	}
+
+	return len;
+}
+
 static int finalize_cbor_output(uint8_t* buffer, zcbor_state_t* state, uint8_t** cbor_data,
 				size_t* cbor_len)
 {
@@ -344,3 +676,89 @@ static int finalize_cbor_output(uint8_t* buffer, zcbor_state_t* state, uint8_t**
 
 	return 0;
 }
+
+/**
+ * @brief Encoded length of an unsigned integer or of the argument of a negative integer
+ */
+static size_t uint_len(uint64_t value)
+{
+	if (value < 24) {
+		return 1;
+	}
+	if (value <= UINT8_MAX) {
+		return 2;
+	}
+	if (value <= UINT16_MAX) {
+		return 3;
+	}
+	return value <= UINT32_MAX ? 5 : 9;
+}
+
+#ifdef CONFIG_SPOTFLOW_METRICS_BATCHED_MESSAGES
+/**
+ * @brief Maximum encoded length of a text string with the given length
+ */
+static size_t tstr_max_len(size_t len)
+{
+	if (len < 24) {
+		return 1 + len;
+	}
+	return (len < 256 ? 2 : 3) + len;
+}
+
+/**
+ * @brief Encoded length of a sum, min or max value
+ */
+static size_t number_len(struct spotflow_metric_base* metric, int64_t value_int)
+{
+	if (metric->type != SPOTFLOW_METRIC_TYPE_INT) {
+		return 9; /* Encoded as float64 */
+	}
+	return uint_len(value_int >= 0 ? (uint64_t)value_int : (uint64_t)(-1 - value_int));
+}
+
+/**
+ * @brief Maximum encoded length of a time series in the batched message
+ *
+ * Containers are counted with the longer of the definite and indefinite length encoding.
+ */
+static size_t batch_entry_max_len(struct spotflow_metric_base* metric,
+				  const struct metric_timeseries_labels* labels,
+				  const struct metric_retired_timeseries* retired)
+{
+	const struct metric_aggregate* agg = &retired->agg;
+
+	/* Map, keys of sum, count, min and max */
+	size_t len = 2 + 4;
+
+	len += number_len(metric, agg->sum_int) + uint_len(agg->count) +
+	       number_len(metric, agg->min_int) + number_len(metric, agg->max_int);
+
+	if (agg->sum_truncated) {
+		len += 1 + 1;
+	}
+
+	if (labels != NULL) {
+		len += 1 + 2;
+		for (uint8_t i = 0; i < labels->label_count; i++) {
+			len += tstr_max_len(
+			    strnlen(labels->labels[i].key, SPOTFLOW_MAX_LABEL_KEY_LEN));
+			len += tstr_max_len(
+			    strnlen(labels->labels[i].value, SPOTFLOW_MAX_LABEL_VALUE_LEN));
+		}
+	}
+
+	if (retired->histogram != NULL) {
+		/* Key, array, sub-bucket bits and zero count */
+		len += 1 + 3 + 1 + uint_len(retired->histogram[0]);
+		for (uint16_t i = 1; i < SPOTFLOW_HISTOGRAM_BUCKETS; i++) {
+			if (retired->histogram[i] > 0) {
+				/* Keys are within the float exponent range, at most 3 bytes */
+				len += 3 + uint_len(retired->histogram[i]);
+			}
+		}
+	}
+
+	return len;
+}
+#endif /* CONFIG_SPOTFLOW_METRICS_BATCHED_MESSAGES */
@@ -16,8 +16,15 @@ extern "C" {
  * Allocates and returns a CBOR-encoded buffer. Caller owns the buffer
  * and is responsible for freeing it with k_free().
  *
+ * Histogram metrics also encode their bucket counts under the samples key (0x1D):
+ * [subBucketBits, zeroCount, bucketKey, count, ...] with the non-empty buckets only. The bucket
+ * with the key exponent * 2^subBucketBits + subBucket starts at
+ * 2^exponent * (1 + subBucket / 2^subBucketBits). The zero count includes the values below the
+ * lowest bucket, the highest bucket includes the values above it.
+ *
  * @param metric Metric base handle
- * @param ts Time series state to encode
+ * @param labels Label set of the time series, NULL for label-less metrics
+ * @param retired Aggregated values (and histogram buckets) to encode
  * @param timestamp_ms Device uptime in milliseconds when aggregation window closed
  * @param sequence_number Sequence number for this message
  * @param cbor_data Output: allocated CBOR buffer
@@ -28,10 +35,78 @@ extern "C" {
  *         -ENOMEM: Memory allocation failed
  */
 int spotflow_metrics_cbor_encode_aggregated(struct spotflow_metric_base* metric,
-					    struct metric_timeseries_state* ts,
+					    const struct metric_timeseries_labels* labels,
+					    const struct metric_retired_timeseries* retired,
 					    int64_t timestamp_ms, uint64_t sequence_number,
 					    uint8_t** cbor_data, size_t* cbor_len);
 
+#ifdef CONFIG_SPOTFLOW_METRICS_BATCHED_MESSAGES
+/**
+ * @brief Get the number of retired time series that fit into one batched message
+ *
+ * Counts the encoded length of each time series with its containers at their longest encoding,
+ * so the batch always fits into CONFIG_SPOTFLOW_METRICS_CBOR_BUFFER_SIZE. Returns at least 1 if
+ * retired_count is not 0.
+ *
+ * @param metric Metric base handle
+ * @param labels Label sets of the metric by time series slot, NULL for label-less metrics
+ * @param retired Retired time series to encode from the beginning
+ * @param retired_count Number of retired time series
+ *
+ * @return Number of retired time series for the next batched message
+ */
+uint16_t spotflow_metrics_cbor_batch_fit(struct spotflow_metric_base* metric,
+					 const struct metric_timeseries_labels* labels,
+					 const struct metric_retired_timeseries* retired,
+					 uint16_t retired_count);
+
+/**
+ * @brief Encode closed windows of multiple time series to one CBOR message
+ *
+ * Allocates and returns a CBOR-encoded buffer. Caller owns the buffer
+ * and is responsible for freeing it with k_free().
+ *
+ * Output format:
+ * {
+ *   0x00: 0x05,                    // messageType = 5 (METRIC)
+ *   0x15: <tstr>,                  // metricName
+ *   0x16: <uint>,                  // aggregationInterval
+ *   0x06: <int64>,                 // deviceUptimeMs
+ *   0x0D: <uint64>,                // sequenceNumber
+ *   0x1E: [                        // timeSeries
+ *     {
+ *       0x05: { <tstr>: <tstr> },  // labels (labeled metrics only)
+ *       0x18: <number>,            // sum
+ *       0x19: true,                // sumTruncated (only if truncated)
+ *       0x1A: <uint64>,            // count
+ *       0x1B: <number>,            // min
+ *       0x1C: <number>,            // max
+ *       0x1D: [ <uint>, ... ]      // samples (histogram metrics only)
+ *     }, ...
+ *   ]
+ * }
+ *
+ * @param metric Metric base handle
+ * @param labels Label sets of the metric by time series slot, NULL for label-less metrics
+ * @param retired Retired time series to encode
+ * @param retired_count Number of retired time series, see spotflow_metrics_cbor_batch_fit()
+ * @param timestamp_ms Device uptime in milliseconds when aggregation window closed
+ * @param sequence_number Sequence number for this message
+ * @param cbor_data Output: allocated CBOR buffer
+ * @param cbor_len Output: CBOR buffer length
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: CBOR encoding failed
+ *         -ENOMEM: Memory allocation failed
+ */
+int spotflow_metrics_cbor_encode_aggregated_batch(struct spotflow_metric_base* metric,
+						  const struct metric_timeseries_labels* labels,
+						  const struct metric_retired_timeseries* retired,
+						  uint16_t retired_count, int64_t timestamp_ms,
+						  uint64_t sequence_number, uint8_t** cbor_data,
+						  size_t* cbor_len);
+#endif /* CONFIG_SPOTFLOW_METRICS_BATCHED_MESSAGES */
+
 int spotflow_metrics_cbor_encode_no_aggregation(struct spotflow_metric_base* metric,
 						const struct spotflow_label* labels,
 						uint8_t label_count, int64_t value_int,
@@ -39,6 +114,44 @@ int spotflow_metrics_cbor_encode_no_aggregation(struct spotflow_metric_base* met
 						uint64_t sequence_number, uint8_t** cbor_data,
 						size_t* cbor_len);
 
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+/**
+ * @brief Encode the buffered samples of a non-aggregated time series to one CBOR message
+ *
+ * Allocates and returns a CBOR-encoded buffer. Caller owns the buffer
+ * and is responsible for freeing it with k_free().
+ *
+ * Output format:
+ * {
+ *   0x00: 0x05,                    // messageType = 5 (METRIC)
+ *   0x15: <tstr>,                  // metricName
+ *   0x16: 0,                       // aggregationInterval = PT0S
+ *   0x06: <int64>,                 // deviceUptimeMs of the first sample
+ *   0x0D: <uint64>,                // sequenceNumber
+ *   0x05: { <tstr>: <tstr> },      // labels (labeled metrics only)
+ *   0x1D: [ <uint>, <number>, ... ] // samples: milliseconds since the previous sample (0 for
+ *                                  // the first one) and value of each sample
+ * }
+ *
+ * @param metric Metric base handle
+ * @param labels Label set of the time series, NULL for label-less metrics
+ * @param buffer Sample buffer of the time series
+ * @param sample_count Number of buffered samples
+ * @param sequence_number Sequence number for this message
+ * @param cbor_data Output: allocated CBOR buffer
+ * @param cbor_len Output: CBOR buffer length
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: CBOR encoding failed
+ *         -ENOMEM: Memory allocation failed
+ */
+int spotflow_metrics_cbor_encode_samples(struct spotflow_metric_base* metric,
+					 const struct metric_timeseries_labels* labels,
+					 const struct metric_sample_buffer* buffer,
+					 uint16_t sample_count, uint64_t sequence_number,
+					 uint8_t** cbor_data, size_t* cbor_len);
+#endif /* CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING */
+
 /**
  * @brief Encode a minimal heartbeat CBOR message
  *
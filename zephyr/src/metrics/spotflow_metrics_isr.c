@@ -0,0 +1,161 @@
+#include "spotflow_metrics_isr.h"
+#include "spotflow_metrics_aggregator.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_DECLARE(spotflow_metrics, CONFIG_SPOTFLOW_METRICS_PROCESSING_LOG_LEVEL);
+
+#define ISR_QUEUE_SIZE CONFIG_SPOTFLOW_METRICS_ISR_QUEUE_SIZE
+#define ISR_QUEUE_MASK (ISR_QUEUE_SIZE - 1)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(ISR_QUEUE_SIZE),
+	     "CONFIG_SPOTFLOW_METRICS_ISR_QUEUE_SIZE must be a power of two");
+
+/*
+ * Bounded lock-free queue with a sequence number per cell (Vyukov). Producers reserve a cell by
+ * advancing the enqueue position with CAS, fill it and publish it by setting its sequence. The
+ * single consumer is the system work queue.
+ *
+ * Sequences are stored relative to the cell index, so the zero-initialized queue is empty:
+ * - stored + index == position: the cell is free for the producer of that position
+ * - stored + index == position + 1: the cell holds the sample of that position
+ */
+struct isr_sample {
+	atomic_t sequence;
+	struct spotflow_metric_base* metric;
+	struct metric_timeseries_state* timeseries; /* NULL for label-less metrics */
+	int64_t value;
+};
+
+static struct isr_sample g_samples[ISR_QUEUE_SIZE];
+static atomic_t g_enqueue_pos;
+static uint32_t g_dequeue_pos;
+static atomic_t g_dropped_count;
+static uint32_t g_dropped_count_logged;
+
+static int push_sample(struct spotflow_metric_base* metric, struct metric_timeseries_state* ts,
+		       int64_t value);
+static void drain_work_handler(struct k_work* work);
+
+static K_WORK_DEFINE(g_drain_work, drain_work_handler);
+
+int spotflow_report_metric_int_from_isr(struct spotflow_metric_int* metric, int64_t value)
+{
+	if (metric == NULL || metric->base.max_labels > 0 ||
+	    metric->base.aggregator_context == NULL) {
+		return -EINVAL;
+	}
+
+	struct metric_aggregator_context* ctx = metric->base.aggregator_context;
+
+	/* Aggregated label-less integer metrics do not take the mutex, no need to queue them */
+	if (ctx->lockless) {
+		return aggregator_report_value(&metric->base, NULL, 0, 0, value, 0.0);
+	}
+
+	return push_sample(&metric->base, NULL, value);
+}
+
+int spotflow_report_event_from_isr(struct spotflow_metric_int* metric)
+{
+	/* Events report value of 1 (event occurred) */
+	return spotflow_report_metric_int_from_isr(metric, 1);
+}
+
+int spotflow_report_bound_int_from_isr(struct spotflow_bound_metric_int* bound, int64_t value)
+{
+	if (bound == NULL || bound->timeseries == NULL) {
+		return -EINVAL;
+	}
+
+	return push_sample(bound->metric, bound->timeseries, value);
+}
+
+uint32_t spotflow_metrics_get_isr_dropped_count(void)
+{
+	return (uint32_t)atomic_get(&g_dropped_count);
+}
+
+void spotflow_metrics_isr_drain(void)
+{
+	for (;;) {
+		uint32_t index = g_dequeue_pos & ISR_QUEUE_MASK;
+		struct isr_sample* cell = &g_samples[index];
+
+		if ((uint32_t)atomic_get(&cell->sequence) + index != g_dequeue_pos + 1) {
+			break; /* Empty, or the producer of the next sample has not published it yet */
+		}
+
+		struct spotflow_metric_base* metric = cell->metric;
+		struct metric_timeseries_state* ts = cell->timeseries;
+		int64_t value = cell->value;
+
+		/* Free the cell for the producer of the position one lap ahead */
+		atomic_set(&cell->sequence, g_dequeue_pos + ISR_QUEUE_SIZE - index);
+		g_dequeue_pos++;
+
+		int rc = ts != NULL ? aggregator_report_bound_value(metric, ts, value, 0.0)
+				    : aggregator_report_value(metric, NULL, 0, 0, value, 0.0);
+		if (rc < 0) {
+			LOG_WRN("Failed to report metric '%s' from ISR: %d", metric->name, rc);
+		}
+	}
+
+	uint32_t dropped = spotflow_metrics_get_isr_dropped_count();
+	if (dropped != g_dropped_count_logged) {
+		LOG_WRN("Dropped %u metric samples reported from ISRs, queue full",
+			dropped - g_dropped_count_logged);
+		g_dropped_count_logged = dropped;
+	}
+}
+
+/**
+ * @brief Push a sample into the queue and schedule its aggregation, never blocks
+ */
+static int push_sample(struct spotflow_metric_base* metric, struct metric_timeseries_state* ts,
+		       int64_t value)
+{
+	atomic_val_t pos = atomic_get(&g_enqueue_pos);
+	struct isr_sample* cell;
+
+	for (;;) {
+		uint32_t index = (uint32_t)pos & ISR_QUEUE_MASK;
+		cell = &g_samples[index];
+		int32_t diff = (int32_t)((uint32_t)atomic_get(&cell->sequence) + index - (uint32_t)pos);
+
+		if (diff == 0) {
+			/* Cell is free, reserve it unless another producer was faster */
+			if (atomic_cas(&g_enqueue_pos, pos, pos + 1)) {
+				break;
+			}
+			pos = atomic_get(&g_enqueue_pos);
+		} else if (diff < 0) {
+			/* Cell still holds the sample of the previous lap, queue is full */
+			atomic_inc(&g_dropped_count);
+			return -ENOBUFS;
+		} else {
+			/* Another producer reserved the cell meanwhile */
+			pos = atomic_get(&g_enqueue_pos);
+		}
+	}
+
+	cell->metric = metric;
+	cell->timeseries = ts;
+	cell->value = value;
+	atomic_set(&cell->sequence, (uint32_t)pos + 1 - ((uint32_t)pos & ISR_QUEUE_MASK));
+
+	/* Submitting an already queued work item does nothing, it is ISR-safe */
+	k_work_submit(&g_drain_work);
+
+	return 0;
+}
+
+static void drain_work_handler(struct k_work* work)
+{
+	ARG_UNUSED(work);
+
+	spotflow_metrics_isr_drain();
+}
@@ -0,0 +1,72 @@
+#ifndef SPOTFLOW_METRICS_ISR_H_
+#define SPOTFLOW_METRICS_ISR_H_
+
+#include "spotflow_metrics_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Report a label-less integer metric value from an interrupt handler
+ *
+ * Never blocks. Values of aggregated metrics are aggregated right away under a spinlock (see
+ * spotflow_report_metric_int()), values of non-aggregated (PT0S) metrics are queued and encoded
+ * later in the system work queue. Can be called from threads as well.
+ *
+ * @param metric Metric handle from registration (must be label-less)
+ * @param value Integer value to report
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Invalid metric handle or metric is labeled
+ *         -ENOBUFS: Sample queue full, the sample was dropped and counted
+ */
+int spotflow_report_metric_int_from_isr(struct spotflow_metric_int* metric, int64_t value);
+
+/**
+ * @brief Report an event for a label-less metric from an interrupt handler
+ *
+ * Equivalent to calling spotflow_report_metric_int_from_isr(metric, 1).
+ *
+ * @param metric Metric handle from registration (must be label-less)
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Invalid metric handle or metric is labeled
+ *         -ENOBUFS: Sample queue full, the sample was dropped and counted
+ */
+int spotflow_report_event_from_isr(struct spotflow_metric_int* metric);
+
+/**
+ * @brief Report an integer metric value with the bound labels from an interrupt handler
+ *
+ * Never blocks. The value is queued and aggregated later in the system work queue. Can be called
+ * from threads as well.
+ *
+ * @param bound Bound metric handle from spotflow_metric_bind_labels_int()
+ * @param value Integer value to report
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Handle was not bound
+ *         -ENOBUFS: Sample queue full, the sample was dropped and counted
+ */
+int spotflow_report_bound_int_from_isr(struct spotflow_bound_metric_int* bound, int64_t value);
+
+/**
+ * @brief Get the number of samples reported from interrupt handlers dropped on full queue
+ *
+ * @return Number of dropped samples since boot
+ */
+uint32_t spotflow_metrics_get_isr_dropped_count(void);
+
+/**
+ * @brief Aggregate all the queued samples reported from interrupt handlers
+ *
+ * Called from the system work queue only, which makes it the single consumer of the queue.
+ */
+void spotflow_metrics_isr_drain(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPOTFLOW_METRICS_ISR_H_ */
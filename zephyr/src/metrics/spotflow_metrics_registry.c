@@ -1,14 +1,17 @@
 #include "spotflow_metrics_registry.h"
 #include "spotflow_metrics_aggregator.h"
 
+#include <zephyr/init.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/iterable_sections.h>
 #include <string.h>
 #include <ctype.h>
 
 LOG_MODULE_DECLARE(spotflow_metrics, CONFIG_SPOTFLOW_METRICS_PROCESSING_LOG_LEVEL);
 
 static struct spotflow_metric_base g_metric_registry[CONFIG_SPOTFLOW_METRICS_MAX_REGISTERED];
+static char g_metric_names[CONFIG_SPOTFLOW_METRICS_MAX_REGISTERED][SPOTFLOW_METRIC_NAME_SIZE];
 static K_MUTEX_DEFINE(g_registry_lock);
 
 /* Forward declarations of static functions */
@@ -18,13 +21,20 @@ static struct spotflow_metric_base* find_metric_by_name(const char* normalized_n
 static int validate_metric_params(const char* name, uint16_t max_timeseries, uint8_t max_labels);
 static int normalize_and_validate_metric_name(const char* name, char* out_normalized,
 					      size_t out_size);
-static void init_metric_struct(struct spotflow_metric_base* metric, const char* normalized_name,
+static void init_metric_struct(int slot, const char* normalized_name,
 			       enum spotflow_metric_type type,
 			       enum spotflow_agg_interval agg_interval, uint16_t max_timeseries,
 			       uint8_t max_labels);
 static int register_metric_common(const char* name, enum spotflow_metric_type type,
 				  enum spotflow_agg_interval agg_interval, uint16_t max_timeseries,
 				  uint8_t max_labels, struct spotflow_metric_base** metric_out);
+static const char* get_type_name(enum spotflow_metric_type type);
+static int register_static_metrics(void);
+
+/* Metrics defined by SPOTFLOW_METRIC_DEFINE_*() are usable from any APPLICATION init hook.
+ * Registration draws the window phase from the random source, so it runs after the drivers.
+ */
+SYS_INIT(register_static_metrics, POST_KERNEL, CONFIG_APPLICATION_INIT_PRIORITY);
 
 /* Public API Implementation */
 
@@ -141,6 +151,45 @@ int spotflow_register_metric_float_with_labels(const char* name,
 	return 0;
 }
 
+int spotflow_register_metric_histogram(const char* name, enum spotflow_agg_interval agg_interval,
+				       struct spotflow_metric_histogram** metric_out)
+{
+	return spotflow_register_metric_histogram_with_labels(name, agg_interval, 1, 0, metric_out);
+}
+
+int spotflow_register_metric_histogram_with_labels(const char* name,
+						   enum spotflow_agg_interval agg_interval,
+						   uint16_t max_timeseries, uint8_t max_labels,
+						   struct spotflow_metric_histogram** metric_out)
+{
+	struct spotflow_metric_base* base;
+	int rc;
+
+	if (metric_out == NULL) {
+		LOG_ERR("metric_out cannot be NULL");
+		return -EINVAL;
+	}
+
+	/* Buckets are only sent with the aggregated values of a window */
+	if (agg_interval == SPOTFLOW_AGG_INTERVAL_NONE) {
+		LOG_ERR("Histogram metric requires an aggregation interval");
+		return -EINVAL;
+	}
+
+	rc = register_metric_common(name, SPOTFLOW_METRIC_TYPE_HISTOGRAM, agg_interval,
+				    max_timeseries, max_labels, &base);
+	if (rc < 0) {
+		return rc;
+	}
+	/* Validate type matches before cast */
+	if (base->type != SPOTFLOW_METRIC_TYPE_HISTOGRAM) {
+		LOG_ERR("Type mismatch: expected HISTOGRAM, got %d", base->type);
+		return -EINVAL;
+	}
+	*metric_out = (struct spotflow_metric_histogram*)base;
+	return 0;
+}
+
 /* Static function implementations */
 
 /**
@@ -195,6 +244,14 @@ static struct spotflow_metric_base* find_metric_by_name(const char* normalized_n
 			return base;
 		}
 	}
+
+	STRUCT_SECTION_FOREACH(spotflow_metric_descriptor, descriptor) {
+		struct spotflow_metric_base* base = descriptor->metric;
+		if (base->aggregator_context != NULL && strcmp(base->name, normalized_name) == 0) {
+			return base;
+		}
+	}
+
 	return NULL;
 }
 
@@ -249,13 +306,16 @@ static int normalize_and_validate_metric_name(const char* name, char* out_normal
 /**
  * @brief Initialize metric structure fields
  */
-static void init_metric_struct(struct spotflow_metric_base* metric, const char* normalized_name,
+static void init_metric_struct(int slot, const char* normalized_name,
 			       enum spotflow_metric_type type,
 			       enum spotflow_agg_interval agg_interval, uint16_t max_timeseries,
 			       uint8_t max_labels)
 {
-	strncpy(metric->name, normalized_name, sizeof(metric->name) - 1);
-	metric->name[sizeof(metric->name) - 1] = '\0';
+	struct spotflow_metric_base* metric = &g_metric_registry[slot];
+
+	strncpy(g_metric_names[slot], normalized_name, SPOTFLOW_METRIC_NAME_SIZE - 1);
+	g_metric_names[slot][SPOTFLOW_METRIC_NAME_SIZE - 1] = '\0';
+	metric->name = g_metric_names[slot];
 
 	metric->type = type;
 	metric->agg_interval = agg_interval;
@@ -278,7 +338,7 @@ static int register_metric_common(const char* name, enum spotflow_metric_type ty
 		return rc;
 	}
 
-	char normalized_name[256];
+	char normalized_name[SPOTFLOW_METRIC_NAME_SIZE];
 	rc = normalize_and_validate_metric_name(name, normalized_name, sizeof(normalized_name));
 	if (rc < 0) {
 		return rc;
@@ -303,7 +363,7 @@ static int register_metric_common(const char* name, enum spotflow_metric_type ty
 	}
 
 	struct spotflow_metric_base* metric = &g_metric_registry[slot];
-	init_metric_struct(metric, normalized_name, type, agg_interval, max_timeseries, max_labels);
+	init_metric_struct(slot, normalized_name, type, agg_interval, max_timeseries, max_labels);
 
 	/* Initialize aggregator context */
 	rc = aggregator_register_metric(metric);
@@ -318,12 +378,65 @@ static int register_metric_common(const char* name, enum spotflow_metric_type ty
 	k_mutex_unlock(&g_registry_lock);
 
 	LOG_INF("Registered metric '%s' (type=%s, agg=%d, max_ts=%u, max_labels=%u)",
-		normalized_name,
-		(type == SPOTFLOW_METRIC_TYPE_INT)	   ? "int"
-		    : (type == SPOTFLOW_METRIC_TYPE_FLOAT) ? "float"
-							   : "unknown",
-		metric->agg_interval, max_timeseries, max_labels);
+		normalized_name, get_type_name(type), metric->agg_interval, max_timeseries,
+		max_labels);
 
 	*metric_out = metric;
 	return 0;
 }
+
+static const char* get_type_name(enum spotflow_metric_type type)
+{
+	switch (type) {
+	case SPOTFLOW_METRIC_TYPE_INT:
+		return "int";
+	case SPOTFLOW_METRIC_TYPE_FLOAT:
+		return "float";
+	case SPOTFLOW_METRIC_TYPE_HISTOGRAM:
+		return "histogram";
+	default:
+		return "unknown";
+	}
+}
+
+/**
+ * @brief Register the metrics defined by SPOTFLOW_METRIC_DEFINE_*()
+ *
+ * Their parameters were checked at build time and their names are C identifiers, which are unique
+ * (duplicates fail to link). Only the names with uppercase letters, which are not normalized, are
+ * checked here. Their storage is static, so nothing is allocated.
+ */
+static int register_static_metrics(void)
+{
+	STRUCT_SECTION_FOREACH(spotflow_metric_descriptor, descriptor) {
+		struct spotflow_metric_base* metric = descriptor->metric;
+		char normalized_name[SPOTFLOW_METRIC_NAME_SIZE];
+
+		normalize_metric_name(metric->name, normalized_name, sizeof(normalized_name));
+		if (strcmp(metric->name, normalized_name) != 0) {
+			LOG_ERR("Metric name '%s' is not normalized, use '%s'", metric->name,
+				normalized_name);
+			continue;
+		}
+
+		k_mutex_lock(&g_registry_lock, K_FOREVER);
+
+		/* Only a metric registered at runtime from an earlier init level can collide */
+		if (find_metric_by_name(metric->name) != NULL) {
+			LOG_ERR("Metric '%s' already registered", metric->name);
+			k_mutex_unlock(&g_registry_lock);
+			continue;
+		}
+
+		k_mutex_init(&metric->lock);
+		aggregator_register_static_metric(descriptor);
+
+		k_mutex_unlock(&g_registry_lock);
+
+		LOG_INF("Registered static metric '%s' (type=%s, agg=%d, max_ts=%u, max_labels=%u)",
+			metric->name, get_type_name(metric->type), metric->agg_interval,
+			metric->max_timeseries, metric->max_labels);
+	}
+
+	return 0;
+}
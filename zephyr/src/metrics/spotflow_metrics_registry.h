@@ -3,6 +3,9 @@
 
 #include "spotflow_metrics_types.h"
 
+#include <zephyr/sys/iterable_sections.h>
+#include <zephyr/sys/util.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -101,6 +104,232 @@ int spotflow_register_metric_float_with_labels(const char* name,
 					       uint16_t max_timeseries, uint8_t max_labels,
 					       struct spotflow_metric_float** metric_out);
 
+/**
+ * @brief Register a histogram metric
+ *
+ * Histogram metrics report float values. Besides the sum, count, min and max, every window
+ * sends the counts of values in log-linear buckets, so percentiles can be estimated. Each time
+ * series keeps CONFIG_SPOTFLOW_METRICS_HISTOGRAM_OCTAVES buckets for every power of two (split
+ * into 2^CONFIG_SPOTFLOW_METRICS_HISTOGRAM_SUB_BUCKET_BITS sub-buckets) starting at
+ * 2^CONFIG_SPOTFLOW_METRICS_HISTOGRAM_MIN_EXPONENT.
+ *
+ * Pass max_labels = 0 and max_timeseries = 1 to register a label-less metric.
+ *
+ * @param name Metric name (max 255 chars), normalized as in spotflow_register_metric_int()
+ * @param agg_interval Aggregation interval (SPOTFLOW_AGG_INTERVAL_1MIN,
+ *                     SPOTFLOW_AGG_INTERVAL_1HOUR, SPOTFLOW_AGG_INTERVAL_1DAY)
+ * @param max_timeseries Maximum number of unique label combinations (1-256)
+ * @param max_labels Maximum labels per report (0-CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC)
+ * @param metric_out Output parameter for the registered metric handle
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Invalid parameters (NULL name/metric_out, empty normalized name,
+ *                  invalid max_timeseries/max_labels, SPOTFLOW_AGG_INTERVAL_NONE)
+ *         -EEXIST: Metric with same name already registered
+ *         -ENOSPC: Metric registry full
+ *         -ENOMEM: Aggregator allocation failed
+ */
+int spotflow_register_metric_histogram_with_labels(const char* name,
+						   enum spotflow_agg_interval agg_interval,
+						   uint16_t max_timeseries, uint8_t max_labels,
+						   struct spotflow_metric_histogram** metric_out);
+
+/**
+ * @brief Register a label-less histogram metric
+ *
+ * Equivalent to calling spotflow_register_metric_histogram_with_labels(name, agg_interval, 1, 0,
+ * metric_out).
+ *
+ * @param name Metric name (max 255 chars), normalized as in spotflow_register_metric_int()
+ * @param agg_interval Aggregation interval (SPOTFLOW_AGG_INTERVAL_1MIN,
+ *                     SPOTFLOW_AGG_INTERVAL_1HOUR, SPOTFLOW_AGG_INTERVAL_1DAY)
+ * @param metric_out Output parameter for the registered metric handle
+ *
+ * @return 0 on success, negative errno on failure
+ *         -EINVAL: Invalid parameters (NULL name or metric_out, empty normalized name,
+ *                  SPOTFLOW_AGG_INTERVAL_NONE)
+ *         -EEXIST: Metric with same name already registered
+ *         -ENOSPC: Metric registry full
+ *         -ENOMEM: Aggregator allocation failed
+ */
+int spotflow_register_metric_histogram(const char* name, enum spotflow_agg_interval agg_interval,
+				       struct spotflow_metric_histogram** metric_out);
+
+/**
+ * @brief Define a label-less integer metric at build time
+ *
+ * Statically defined metrics are registered at boot (late in the POST_KERNEL init level) without
+ * any heap allocation, so they can be used from APPLICATION init hooks and main(). Their time
+ * series storage is reserved at build time. Their parameters are checked at build time. The
+ * metric name is the identifier, so it is unique - a second definition with the same name fails
+ * to link. The name must be lowercase, otherwise the metric is not registered and reporting fails
+ * with -EINVAL.
+ *
+ * Use the metric with SPOTFLOW_METRIC(name) as a struct spotflow_metric_int pointer and declare
+ * it in other files with SPOTFLOW_METRIC_DECLARE_INT(name).
+ *
+ * Example:
+ *   SPOTFLOW_METRIC_DEFINE_INT(app_counter, SPOTFLOW_AGG_INTERVAL_1MIN);
+ *   spotflow_report_metric_int(SPOTFLOW_METRIC(app_counter), 1);
+ *
+ * @param name Metric name, a lowercase C identifier
+ * @param agg_interval Aggregation interval (SPOTFLOW_AGG_INTERVAL_NONE, SPOTFLOW_AGG_INTERVAL_1MIN,
+ *                     SPOTFLOW_AGG_INTERVAL_1HOUR, SPOTFLOW_AGG_INTERVAL_1DAY)
+ */
+#define SPOTFLOW_METRIC_DEFINE_INT(name, agg_interval)                                             \
+	SPOTFLOW_METRIC_DEFINE_INTERNAL(name, struct spotflow_metric_int,                          \
+					SPOTFLOW_METRIC_TYPE_INT, agg_interval, 1, 0)
+
+/**
+ * @brief Define a labeled integer metric at build time
+ *
+ * See SPOTFLOW_METRIC_DEFINE_INT().
+ *
+ * @param name Metric name, a lowercase C identifier
+ * @param agg_interval Aggregation interval
+ * @param max_timeseries Maximum number of unique label combinations (1-256)
+ * @param max_labels Maximum labels per report (1-CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC)
+ */
+#define SPOTFLOW_METRIC_DEFINE_INT_WITH_LABELS(name, agg_interval, max_timeseries, max_labels)     \
+	BUILD_ASSERT((max_labels) > 0, "Labeled metric requires max_labels > 0");                  \
+	SPOTFLOW_METRIC_DEFINE_INTERNAL(name, struct spotflow_metric_int,                          \
+					SPOTFLOW_METRIC_TYPE_INT, agg_interval, max_timeseries,    \
+					max_labels)
+
+/**
+ * @brief Define a label-less float metric at build time
+ *
+ * See SPOTFLOW_METRIC_DEFINE_INT().
+ *
+ * @param name Metric name, a lowercase C identifier
+ * @param agg_interval Aggregation interval
+ */
+#define SPOTFLOW_METRIC_DEFINE_FLOAT(name, agg_interval)                                           \
+	SPOTFLOW_METRIC_DEFINE_INTERNAL(name, struct spotflow_metric_float,                        \
+					SPOTFLOW_METRIC_TYPE_FLOAT, agg_interval, 1, 0)
+
+/**
+ * @brief Define a labeled float metric at build time
+ *
+ * See SPOTFLOW_METRIC_DEFINE_INT().
+ *
+ * @param name Metric name, a lowercase C identifier
+ * @param agg_interval Aggregation interval
+ * @param max_timeseries Maximum number of unique label combinations (1-256)
+ * @param max_labels Maximum labels per report (1-CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC)
+ */
+#define SPOTFLOW_METRIC_DEFINE_FLOAT_WITH_LABELS(name, agg_interval, max_timeseries, max_labels)   \
+	BUILD_ASSERT((max_labels) > 0, "Labeled metric requires max_labels > 0");                  \
+	SPOTFLOW_METRIC_DEFINE_INTERNAL(name, struct spotflow_metric_float,                        \
+					SPOTFLOW_METRIC_TYPE_FLOAT, agg_interval, max_timeseries,  \
+					max_labels)
+
+/**
+ * @brief Define a histogram metric at build time
+ *
+ * See SPOTFLOW_METRIC_DEFINE_INT() and spotflow_register_metric_histogram_with_labels(). Pass
+ * max_labels = 0 and max_timeseries = 1 to define a label-less metric.
+ *
+ * @param name Metric name, a lowercase C identifier
+ * @param agg_interval Aggregation interval (SPOTFLOW_AGG_INTERVAL_NONE is not allowed)
+ * @param max_timeseries Maximum number of unique label combinations (1-256)
+ * @param max_labels Maximum labels per report (0-CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC)
+ */
+#define SPOTFLOW_METRIC_DEFINE_HISTOGRAM(name, agg_interval, max_timeseries, max_labels)           \
+	BUILD_ASSERT((agg_interval) != SPOTFLOW_AGG_INTERVAL_NONE,                                 \
+		     "Histogram metric requires an aggregation interval");                         \
+	SPOTFLOW_METRIC_DEFINE_INTERNAL(name, struct spotflow_metric_histogram,                    \
+					SPOTFLOW_METRIC_TYPE_HISTOGRAM, agg_interval,              \
+					max_timeseries, max_labels)
+
+/** @brief Declare an integer metric defined in another file */
+#define SPOTFLOW_METRIC_DECLARE_INT(name) extern struct spotflow_metric_int spotflow_metric_##name
+
+/** @brief Declare a float metric defined in another file */
+#define SPOTFLOW_METRIC_DECLARE_FLOAT(name)                                                        \
+	extern struct spotflow_metric_float spotflow_metric_##name
+
+/** @brief Declare a histogram metric defined in another file */
+#define SPOTFLOW_METRIC_DECLARE_HISTOGRAM(name)                                                    \
+	extern struct spotflow_metric_histogram spotflow_metric_##name
+
+/** @brief Get the handle of a statically defined metric */
+#define SPOTFLOW_METRIC(name) (&spotflow_metric_##name)
+
+/* Storage of a statically defined metric, buffers that the metric does not use have no elements.
+ * Sizes match the allocations of a registered metric.
+ */
+#define SPOTFLOW_METRIC_RETIRED_LEN_INTERNAL(agg_interval, max_timeseries)                         \
+	((agg_interval) == SPOTFLOW_AGG_INTERVAL_NONE ? 0 : (max_timeseries))
+#define SPOTFLOW_METRIC_LABELS_LEN_INTERNAL(max_timeseries, max_labels)                            \
+	((max_labels) == 0 ? 0 : (max_timeseries))
+#define SPOTFLOW_METRIC_INDEX_LEN_INTERNAL(max_timeseries, max_labels)                             \
+	((max_labels) == 0 ? 0 : 1U << (LOG2CEIL(max_timeseries) + 1))
+#define SPOTFLOW_METRIC_HISTOGRAMS_LEN_INTERNAL(type, max_timeseries)                              \
+	((type) == SPOTFLOW_METRIC_TYPE_HISTOGRAM                                                  \
+		 ? (max_timeseries) * SPOTFLOW_HISTOGRAM_BUCKETS                                   \
+		 : 0)
+
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+#define SPOTFLOW_METRIC_SAMPLE_BUFFERS_INTERNAL(name, agg_interval, max_timeseries)                \
+	static struct metric_sample_buffer spotflow_metric_sample_buffers_##name                   \
+		[(agg_interval) == SPOTFLOW_AGG_INTERVAL_NONE ? (max_timeseries) : 0];
+#define SPOTFLOW_METRIC_SAMPLE_BUFFERS_INIT_INTERNAL(name)                                         \
+	.sample_buffers = spotflow_metric_sample_buffers_##name,
+#else
+#define SPOTFLOW_METRIC_SAMPLE_BUFFERS_INTERNAL(name, agg_interval, max_timeseries)
+#define SPOTFLOW_METRIC_SAMPLE_BUFFERS_INIT_INTERNAL(name)
+#endif
+
+#define SPOTFLOW_METRIC_DEFINE_INTERNAL(id, handle_type, metric_type, interval, timeseries_max,    \
+					labels_max)                                                \
+	BUILD_ASSERT(sizeof(#id) <= SPOTFLOW_METRIC_NAME_SIZE, "Metric name too long");            \
+	BUILD_ASSERT((interval) == SPOTFLOW_AGG_INTERVAL_NONE ||                                   \
+			     (interval) == SPOTFLOW_AGG_INTERVAL_1MIN ||                           \
+			     (interval) == SPOTFLOW_AGG_INTERVAL_1HOUR ||                          \
+			     (interval) == SPOTFLOW_AGG_INTERVAL_1DAY,                             \
+		     "Invalid aggregation interval");                                              \
+	BUILD_ASSERT((timeseries_max) >= 1 && (timeseries_max) <= 256,                             \
+		     "max_timeseries must be 1-256");                                              \
+	BUILD_ASSERT((labels_max) <= CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC,                \
+		     "max_labels exceeds CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC");          \
+	BUILD_ASSERT((labels_max) > 0 || (timeseries_max) == 1,                                    \
+		     "Label-less metric has a single time series");                                \
+	static struct metric_aggregator_context spotflow_metric_context_##id;                      \
+	static struct metric_timeseries_state spotflow_metric_timeseries_##id[timeseries_max];     \
+	static struct metric_timeseries_labels spotflow_metric_labels_##id                         \
+		[SPOTFLOW_METRIC_LABELS_LEN_INTERNAL(timeseries_max, labels_max)];                 \
+	static struct metric_retired_timeseries spotflow_metric_retired_##id                       \
+		[SPOTFLOW_METRIC_RETIRED_LEN_INTERNAL(interval, timeseries_max)];                  \
+	static uint16_t spotflow_metric_index_##id                                                 \
+		[SPOTFLOW_METRIC_INDEX_LEN_INTERNAL(timeseries_max, labels_max)];                  \
+	static uint32_t spotflow_metric_histograms_##id                                            \
+		[SPOTFLOW_METRIC_HISTOGRAMS_LEN_INTERNAL(metric_type, timeseries_max)];            \
+	static uint32_t spotflow_metric_retired_histograms_##id                                    \
+		[SPOTFLOW_METRIC_HISTOGRAMS_LEN_INTERNAL(metric_type, timeseries_max)];            \
+	SPOTFLOW_METRIC_SAMPLE_BUFFERS_INTERNAL(id, interval, timeseries_max)                      \
+	handle_type spotflow_metric_##id = {                                                       \
+		.base =                                                                            \
+			{                                                                          \
+				.name = #id,                                                       \
+				.type = (metric_type),                                             \
+				.agg_interval = (interval),                                        \
+				.max_timeseries = (timeseries_max),                                \
+				.max_labels = (labels_max),                                        \
+			},                                                                         \
+	};                                                                                         \
+	static const STRUCT_SECTION_ITERABLE(spotflow_metric_descriptor,                           \
+					     spotflow_metric_descriptor_##id) = {                  \
+		.metric = &spotflow_metric_##id.base,                                              \
+		.context = &spotflow_metric_context_##id,                                          \
+		.timeseries = spotflow_metric_timeseries_##id,                                     \
+		.labels = spotflow_metric_labels_##id,                                             \
+		.retired = spotflow_metric_retired_##id,                                           \
+		.index = spotflow_metric_index_##id,                                               \
+		.histograms = spotflow_metric_histograms_##id,                                     \
+		.retired_histograms = spotflow_metric_retired_histograms_##id,                     \
+		SPOTFLOW_METRIC_SAMPLE_BUFFERS_INIT_INTERNAL(id)}
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,7 +23,11 @@ enum spotflow_agg_interval {
 /**
  * @brief Metric value type enumeration
  */
-enum spotflow_metric_type { SPOTFLOW_METRIC_TYPE_INT = 0, SPOTFLOW_METRIC_TYPE_FLOAT = 1 };
+enum spotflow_metric_type {
+	SPOTFLOW_METRIC_TYPE_INT = 0,
+	SPOTFLOW_METRIC_TYPE_FLOAT = 1,
+	SPOTFLOW_METRIC_TYPE_HISTOGRAM = 2 /* Float values, aggregated also into buckets */
+};
 
 /**
  * @brief Label key-value pair
@@ -48,16 +52,20 @@ struct metric_label_storage {
 };
 
 /**
- * @brief Time series state (internal use)
+ * @brief Histogram bucket layout (internal use)
  *
- * Tracks aggregation state for one unique label combination.
+ * Bucket 0 counts the values below 2^CONFIG_SPOTFLOW_METRICS_HISTOGRAM_MIN_EXPONENT (including
+ * zero and negative values). Each of the following powers of two is split into
+ * SPOTFLOW_HISTOGRAM_SUB_BUCKETS linear buckets, the last bucket also counts the larger values.
  */
-struct metric_timeseries_state {
-	/* Label identification */
-	uint8_t label_count; /* Number of labels (0 for label-less) */
-	struct metric_label_storage labels[CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC];
+#define SPOTFLOW_HISTOGRAM_SUB_BUCKETS (1 << CONFIG_SPOTFLOW_METRICS_HISTOGRAM_SUB_BUCKET_BITS)
+#define SPOTFLOW_HISTOGRAM_BUCKETS                                                                 \
+	(1 + CONFIG_SPOTFLOW_METRICS_HISTOGRAM_OCTAVES * SPOTFLOW_HISTOGRAM_SUB_BUCKETS)
 
-	/* Aggregation state */
+/**
+ * @brief Aggregated values of one aggregation window (internal use)
+ */
+struct metric_aggregate {
 	union {
 		int64_t sum_int;
 		float sum_float;
@@ -72,18 +80,82 @@ struct metric_timeseries_state {
 	};
 	uint64_t count; /* Number of values aggregated */
 	bool sum_truncated; /* Sum overflow flag */
+};
+
+/**
+ * @brief Time series state (internal use)
+ *
+ * Tracks aggregation state for one unique label combination. Only the fields touched by reports
+ * and window closing are kept here, the label set is in struct metric_timeseries_labels of the
+ * same slot, so scanning and updating the time series does not pull label strings into the cache.
+ */
+struct metric_timeseries_state {
+	/* Aggregation state of the current window */
+	struct metric_aggregate agg;
 
+	uint32_t labels_hash; /* Hash of the label set, key of the time series index */
 	bool active; /* Slot in use */
+	bool bound; /* Referenced by a bound label set handle, never evicted */
+	bool retired; /* Closed window being encoded, labels must not change, never evicted */
+};
+
+/**
+ * @brief Label set of a time series (internal use)
+ *
+ * Read only to compare the label sets with equal hashes and to encode the time series.
+ */
+struct metric_timeseries_labels {
+	uint8_t label_count; /* Number of labels */
+	struct metric_label_storage labels[CONFIG_SPOTFLOW_METRICS_MAX_LABELS_PER_METRIC];
+};
+
+/**
+ * @brief Closed aggregation window of a time series (internal use)
+ *
+ * Encoded without holding the metric lock, together with the labels of the time series.
+ */
+struct metric_retired_timeseries {
+	struct metric_aggregate agg;
+	const uint32_t* histogram; /* Bucket counts of histogram metrics, NULL otherwise */
+	uint16_t slot; /* Time series slot */
+};
+
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+/**
+ * @brief Raw value of a non-aggregated metric waiting in a sample buffer (internal use)
+ */
+struct metric_sample {
+	union {
+		int64_t value_int;
+		float value_float;
+	};
+	uint32_t delta_ms; /* Since the previous sample of the buffer */
 };
 
+/**
+ * @brief Samples of one time series of a non-aggregated metric (internal use)
+ *
+ * The number of buffered samples is kept in agg.count of the time series, so time series with
+ * buffered samples are not evicted.
+ */
+struct metric_sample_buffer {
+	int64_t first_sample_ms; /* Uptime of the first sample */
+	int64_t last_sample_ms; /* Uptime of the last sample */
+	struct metric_sample samples[CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFER_SIZE];
+};
+#endif /* CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING */
+
+/* Maximum size of a normalized metric name, including the terminator */
+#define SPOTFLOW_METRIC_NAME_SIZE 256
+
 /**
  * @brief Base metric structure (internal use)
  *
- * Common fields shared by int and float metrics.
+ * Common fields shared by int, float and histogram metrics.
  */
 struct spotflow_metric_base {
 	/* Metric identification */
-	char name[256]; /* Normalized metric name */
+	const char* name; /* Normalized metric name */
 	enum spotflow_metric_type type; /* INT or FLOAT */
 	enum spotflow_agg_interval agg_interval;
 
@@ -119,20 +191,102 @@ struct spotflow_metric_float {
 	struct spotflow_metric_base base;
 };
 
+/**
+ * @brief Histogram metric structure (internal use)
+ *
+ * Type-specific wrapper ensuring only float values can be reported.
+ */
+struct spotflow_metric_histogram {
+	struct spotflow_metric_base base;
+};
+
+/**
+ * @brief Integer metric with a bound label set
+ *
+ * Filled by spotflow_metric_bind_labels_int(), fields are internal.
+ */
+struct spotflow_bound_metric_int {
+	struct spotflow_metric_base* metric;
+	struct metric_timeseries_state* timeseries;
+};
+
+/**
+ * @brief Float metric with a bound label set
+ *
+ * Filled by spotflow_metric_bind_labels_float(), fields are internal.
+ */
+struct spotflow_bound_metric_float {
+	struct spotflow_metric_base* metric;
+	struct metric_timeseries_state* timeseries;
+};
+
 /**
  * @brief Aggregator context per metric (internal use)
  */
 struct metric_aggregator_context {
 	struct spotflow_metric_base* metric;
 	struct metric_timeseries_state* timeseries;
+	/* Closed window being encoded, see retire_window() (NULL for PT0S metrics) */
+	struct metric_retired_timeseries* retired;
 	uint16_t timeseries_count; /* Current number of active time series */
 	uint16_t timeseries_capacity; /* Max (from metric->max_timeseries) */
 
-	/* Timer scope: ONE timer per metric (not per time series) */
-	/* All time series of this metric share the same aggregation window */
-	/* When timer expires, all active time series generate messages with their counts */
-	struct k_work_delayable aggregation_work;
-	bool timer_started; /* Flag to prevent timer restart race */
+	/* Label set per time series slot (NULL for label-less metrics) */
+	struct metric_timeseries_labels* labels;
+
+	/* Bucket counts of histogram metrics, SPOTFLOW_HISTOGRAM_BUCKETS per time series slot and
+	 * per retired time series (NULL for other metrics)
+	 */
+	uint32_t* histograms;
+	uint32_t* retired_histograms;
+
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+	/* Sample buffer per time series slot of non-aggregated metrics (NULL for other metrics) */
+	struct metric_sample_buffer* sample_buffers;
+#endif
+
+	/* Open addressing hash index of time series by their label set hash (NULL for
+	 * label-less metrics). Entries are time series slot numbers + 1, 0 marks an empty entry.
+	 * Linear probing, the capacity is a power of two at least twice the time series capacity.
+	 */
+	uint16_t* index;
+	uint16_t index_mask; /* Index capacity - 1 */
+
+	/* Label-less aggregated integer metrics are reported without the metric mutex. Their time
+	 * series is guarded by the spinlock instead.
+	 */
+	bool lockless;
+	struct k_spinlock timeseries_lock;
+
+	/* All time series of this metric share the same aggregation window. Windows of all metrics
+	 * are closed by one scheduler, metrics wait for it in a list sorted by their window end.
+	 * Non-aggregated metrics with sample buffers wait there for the flush deadline of their
+	 * oldest sample instead.
+	 */
+	struct metric_aggregator_context* next_scheduled; /* Next metric in the scheduler list */
+	int64_t window_end_ms; /* Uptime when the current window closes */
+	bool timer_started; /* Scheduled since the first report, flag to prevent restart race */
+};
+
+/**
+ * @brief Statically defined metric with its storage (internal use)
+ *
+ * Placed in an iterable section by SPOTFLOW_METRIC_DEFINE_INT() and friends, so the metrics are
+ * registered at boot without heap allocations. Buffers that the metric does not use have no
+ * elements.
+ */
+struct spotflow_metric_descriptor {
+	struct spotflow_metric_base* metric;
+	struct metric_aggregator_context* context;
+	struct metric_timeseries_state* timeseries;
+	struct metric_timeseries_labels* labels;
+	struct metric_retired_timeseries* retired;
+	uint16_t* index;
+	uint32_t* histograms;
+	uint32_t* retired_histograms;
+#ifdef CONFIG_SPOTFLOW_METRICS_SAMPLE_BUFFERING
+	struct metric_sample_buffer* sample_buffers;
+#endif
 };
 
 /**
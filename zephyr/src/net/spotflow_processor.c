@@ -17,6 +17,9 @@
 
 #ifdef CONFIG_SPOTFLOW_LOG_BACKEND
 #include "logging/spotflow_log_net.h"
+#ifdef CONFIG_SPOTFLOW_LOG_DICTIONARY
+#include "logging/spotflow_log_dictionary.h"
+#endif /* CONFIG_SPOTFLOW_LOG_DICTIONARY */
 #endif /* CONFIG_SPOTFLOW_LOG_BACKEND */
 
 #ifdef CONFIG_SPOTFLOW_METRICS
@@ -133,6 +136,11 @@ static void process_mqtt()
 		return;
 	}
 
+#ifdef CONFIG_SPOTFLOW_LOG_DICTIONARY
+	/* Dictionary is scoped to the session, its entries are sent again before first use */
+	spotflow_log_dictionary_reset_session();
+#endif /* CONFIG_SPOTFLOW_LOG_DICTIONARY */
+
 	rc = spotflow_config_init_session();
 	if (rc < 0) {
 		LOG_WRN("Failed to initialize configuration updating: %d", rc);
@@ -62,6 +62,11 @@ int spotflow_session_metadata_send(void)
 	return spotflow_mqtt_publish_ingest_cbor_msg(buffer, cbor_data_len);
 }
 
+uint64_t spotflow_session_metadata_get_device_run_id(void)
+{
+	return device_run_id;
+}
+
 static int cbor_encode_session_metadata(const uint8_t* build_id_data, size_t build_id_data_len,
 					uint64_t run_id, uint8_t* buffer, size_t buffer_len,
 					size_t* cbor_data_len)
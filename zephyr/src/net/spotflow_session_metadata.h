@@ -5,8 +5,17 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 int spotflow_session_metadata_send(void);
 
+/**
+ * @brief Get the device run ID sent in the session metadata
+ *
+ * @return Device run ID, 0 if it was not generated yet (no session was started since boot)
+ */
+uint64_t spotflow_session_metadata_get_device_run_id(void);
+
 #ifdef __cplusplus
 }
 #endif